@@ -0,0 +1,162 @@
+#!/bin/sh
+# bench-accuracy.sh: Accuracy-versus-speed benchmark for trackcutter's
+# detector settings; run by `make bench-accuracy'.
+# Copyright (C) 2026 agent <agent@local>
+#
+# Usage: bench-accuracy.sh [TRACKCUTTER [GENCAPTURE]]
+#
+# Generates synthetic recordings with gencapture, each with the exact
+# track boundaries written alongside (--truth), covering the cases that
+# trip up silence detection: plain tracks and gaps, tracks that fade out
+# quietly, clicks in the gaps, loud mains hum, and pauses part way
+# through tracks. Each detector configuration in ACC_CONFIGS is then run
+# over all of them with -P, and its cut points are scored against the
+# ground truth.
+#
+# Track starts and ends are scored separately as boundaries: a detected
+# boundary is a hit if it lies within ACC_TOLERANCE seconds of a true
+# boundary of the same kind not already matched. Precision is the
+# proportion of detected boundaries that are hits, recall the proportion
+# of true boundaries found, and F1 their harmonic mean. The boundary
+# errors are the mean distance of the hits from the truth, in ms ("-" if
+# there were none); note that trackcutter ends each track once the
+# minimum silence period has passed, so end errors include that period.
+# Throughput is frames of input processed per second over all the
+# recordings, which are 44.1kHz 16-bit stereo.
+#
+# A configuration is marked on the Pareto front if no other is both at
+# least as accurate (by F1) and at least as fast, and better at one.
+#
+# The following environment variables may be set to alter the workload:
+#
+#   ACC_DIR        Scratch directory for recordings and results
+#                  (default: bench.tmp; removed afterwards unless ACC_KEEP
+#                  is set to 1)
+#   ACC_DURATION   Length of each recording, in seconds or [HH:]MM:SS
+#                  (default: 20:00)
+#   ACC_CASES      Space-separated list of recordings to generate, from:
+#                  plain fades gap-clicks hum pauses (default: all of them)
+#   ACC_CONFIGS    Semicolon-separated list of NAME=OPTIONS detector
+#                  configurations, OPTIONS being given to trackcutter
+#                  (default: a selection varying each detector setting)
+#   ACC_TOLERANCE  Distance from a true boundary within which a detected
+#                  one counts as a hit, in seconds (default: 3)
+#   ACC_SEED       Random number seed given to gencapture (default: 1)
+
+TRACKCUTTER=${1:-./trackcutter}
+GENCAPTURE=${2:-./gencapture}
+ACC_DIR=${ACC_DIR:-bench.tmp}
+ACC_DURATION=${ACC_DURATION:-20:00}
+ACC_CASES=${ACC_CASES:-"plain fades gap-clicks hum pauses"}
+ACC_CONFIGS=${ACC_CONFIGS:-"default=;high-pass=-H;floor-54=-S -54;floor-42=-S -42;silence-1s=-s 1000;silence-3s=-s 3000;signal-20ms=-n 20;signal-500ms=-n 500"}
+ACC_TOLERANCE=${ACC_TOLERANCE:-3}
+ACC_SEED=${ACC_SEED:-1}
+
+set -e
+
+# Prints the current time in seconds, with nanosecond resolution
+now()
+{
+    date +%s.%N
+}
+
+# Prints the gencapture options that produce the named case
+case_options()
+{
+    case $1 in
+        plain)      echo "" ;;
+        fades)      echo "--fade-out=5-15" ;;
+        gap-clicks) echo "--clicks=60" ;;
+        hum)        echo "--hum=-50" ;;
+        pauses)     echo "--pauses=0.5 --pause-length=0.5-3" ;;
+        *)          echo "bench-accuracy.sh: unknown case \`$1'" >&2; exit 1 ;;
+    esac
+}
+
+# Scores cut points (file $2) against the ground truth (file $1),
+# printing: start hits, end hits, true boundaries, detected boundaries,
+# and the sums of the start and end errors in frames.
+score()
+{
+    awk -v tol="$ACC_TOLERANCE" -v rate=44100 '
+        $1 !~ /^[0-9]+$/ { next }
+        FNR == NR { ts[++nt] = $2; te[nt] = $3; next }
+        { ds[++nd] = $2; de[nd] = $3 }
+        function match_bounds(t, n, d, m, kind,    i, j, best, bestdist, dist, used) {
+            for(i = 1; i <= n; i++) {
+                best = 0
+                for(j = 1; j <= m; j++) {
+                    dist = d[j] - t[i]; if(dist < 0) dist = -dist
+                    if(!((kind, j) in used) && dist <= tol * rate && (!best || dist < bestdist)) {
+                        best = j; bestdist = dist
+                    }
+                }
+                if(best) { used[kind, best] = 1; hits[kind]++; err[kind] += bestdist }
+            }
+        }
+        END {
+            match_bounds(ts, nt, ds, nd, "s")
+            match_bounds(te, nt, de, nd, "e")
+            printf "%d %d %d %d %.0f %.0f\n", hits["s"], hits["e"], 2 * nt, 2 * nd, err["s"], err["e"]
+        }' "$1" "$2"
+}
+
+rm -rf "$ACC_DIR"
+mkdir -p "$ACC_DIR"
+
+frames=0
+for c in $ACC_CASES; do
+    "$GENCAPTURE" -d "$ACC_DURATION" -s "$ACC_SEED" $(case_options "$c") \
+        --truth="$ACC_DIR/$c.truth" "$ACC_DIR/$c.wav"
+    # Taken from the header, which may be longer than the canonical 44 bytes
+    n=$("$TRACKCUTTER" -v -a -I 0-1 "$ACC_DIR/$c.wav" 2>&1 >/dev/null \
+        | sed -n 's/.*Length: \([0-9]*\) frames.*/\1/p')
+    frames=$((frames + n))
+done
+
+echo "$ACC_CONFIGS" | tr ';' '\n' | while IFS= read -r config; do
+    [ -n "$config" ] || continue
+    name=${config%%=*}
+    opts=${config#*=}
+    secs=0
+    totals="0 0 0 0 0 0"
+    for c in $ACC_CASES; do
+        t0=$(now)
+        "$TRACKCUTTER" -P $opts "$ACC_DIR/$c.wav" > "$ACC_DIR/$c.$name.cuts"
+        t1=$(now)
+        secs=$(awk -v s="$secs" -v a="$t0" -v b="$t1" 'BEGIN { print s + b - a }')
+        totals=$(echo "$totals $(score "$ACC_DIR/$c.truth" "$ACC_DIR/$c.$name.cuts")" |
+            awk '{ for(i = 1; i <= 6; i++) printf "%s%.0f", (i > 1) ? " " : "", $i + $(i + 6); print "" }')
+    done
+    echo "$name $secs $totals"
+done > "$ACC_DIR/results"
+
+# Columns of the results file: name, seconds, start hits, end hits,
+# true boundaries, detected boundaries, start error sum, end error sum
+awk -v frames="$frames" '
+    {
+        n++
+        name[n] = $1
+        fps[n] = ($2 > 0) ? frames / $2 : 0
+        p[n] = ($6 > 0) ? ($3 + $4) / $6 : 0
+        r[n] = ($5 > 0) ? ($3 + $4) / $5 : 0
+        f1[n] = (p[n] + r[n] > 0) ? 2 * p[n] * r[n] / (p[n] + r[n]) : 0
+        se[n] = ($3 > 0) ? sprintf("%.1f", $7 / $3 / 44.1) : "-"
+        ee[n] = ($4 > 0) ? sprintf("%.1f", $8 / $4 / 44.1) : "-"
+    }
+    END {
+        printf "%-16s  %9s  %6s  %6s  %12s  %10s  %14s  %s\n",
+            "config", "precision", "recall", "f1", "start_err_ms", "end_err_ms", "frames/s", "pareto"
+        for(i = 1; i <= n; i++) {
+            front = 1
+            for(j = 1; j <= n; j++)
+                if(j != i && f1[j] >= f1[i] && fps[j] >= fps[i] && (f1[j] > f1[i] || fps[j] > fps[i]))
+                    front = 0
+            printf "%-16s  %9.3f  %6.3f  %6.3f  %12s  %10s  %14.0f  %s\n",
+                name[i], p[i], r[i], f1[i], se[i], ee[i], fps[i], front ? "*" : ""
+        }
+    }' "$ACC_DIR/results"
+
+if [ "${ACC_KEEP:-0}" != 1 ]; then
+    rm -rf "$ACC_DIR"
+fi
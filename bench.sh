@@ -0,0 +1,93 @@
+#!/bin/sh
+# bench.sh: End-to-end throughput benchmark for trackcutter; run by
+# `make bench'.
+# Copyright (C) 2026 agent <agent@local>
+#
+# Usage: bench.sh [TRACKCUTTER [GENCAPTURE]]
+#
+# Generates synthetic recordings with gencapture (one per entry of
+# BENCH_CONFIGS), then times trackcutter over each of them in three
+# modes: analysis (-a), printing cuts (-P) and extracting tracks (-d).
+# Each run is repeated BENCH_REPEAT times and the fastest wall-clock
+# time is reported, along with throughput in frames/s and MB/s of input.
+#
+# The following environment variables may be set to alter the workload:
+#
+#   BENCH_DIR       Scratch directory for recordings and extracted tracks
+#                   (default: bench.tmp; removed afterwards unless
+#                   BENCH_KEEP is set to 1)
+#   BENCH_DURATION  Length of each recording, in seconds or [HH:]MM:SS
+#                   (default: 30:00)
+#   BENCH_CONFIGS   Space-separated list of RATE:CHANNELS:BITS recordings
+#                   to generate (default: 44100:2:16 48000:2:24 96000:2:24)
+#   BENCH_REPEAT    Number of runs per mode (default: 3)
+#   BENCH_SEED      Random number seed given to gencapture (default: 1)
+
+TRACKCUTTER=${1:-./trackcutter}
+GENCAPTURE=${2:-./gencapture}
+BENCH_DIR=${BENCH_DIR:-bench.tmp}
+BENCH_DURATION=${BENCH_DURATION:-30:00}
+BENCH_CONFIGS=${BENCH_CONFIGS:-"44100:2:16 48000:2:24 96000:2:24"}
+BENCH_REPEAT=${BENCH_REPEAT:-3}
+BENCH_SEED=${BENCH_SEED:-1}
+
+set -e
+
+# Prints the current time in seconds, with nanosecond resolution
+now()
+{
+    date +%s.%N
+}
+
+# Runs the given command BENCH_REPEAT times, printing the fastest
+# wall-clock time in seconds. The command's output is discarded.
+time_best()
+{
+    best=
+    i=0
+    while [ $i -lt "$BENCH_REPEAT" ]; do
+        rm -rf "$BENCH_DIR/out"
+        mkdir "$BENCH_DIR/out"
+        t0=$(now)
+        "$@" > /dev/null
+        t1=$(now)
+        best=$(awk -v a="$t0" -v b="$t1" -v best="$best" \
+            'BEGIN { t = b - a; if(best == "" || t < best) best = t; print best }')
+        i=$((i + 1))
+    done
+    echo "$best"
+}
+
+rm -rf "$BENCH_DIR"
+mkdir -p "$BENCH_DIR"
+
+printf '%-16s  %-8s  %10s  %14s  %10s\n' config mode seconds frames/s MB/s
+for config in $BENCH_CONFIGS; do
+    rate=${config%%:*}
+    rest=${config#*:}
+    channels=${rest%%:*}
+    bits=${rest#*:}
+    capture="$BENCH_DIR/capture-$rate-$channels-$bits.wav"
+
+    "$GENCAPTURE" -r "$rate" -c "$channels" -b "$bits" -d "$BENCH_DURATION" \
+        -s "$BENCH_SEED" "$capture"
+    bytes=$(wc -c < "$capture")
+    # Taken from the header, which may be longer than the canonical 44 bytes
+    frames=$("$TRACKCUTTER" -v -a -I 0-1 "$capture" 2>&1 >/dev/null \
+        | sed -n 's/.*Length: \([0-9]*\) frames.*/\1/p')
+
+    for mode in analyse cuts extract; do
+        case $mode in
+            analyse) secs=$(time_best "$TRACKCUTTER" -a "$capture") ;;
+            cuts)    secs=$(time_best "$TRACKCUTTER" -P "$capture") ;;
+            extract) secs=$(time_best "$TRACKCUTTER" -d "$BENCH_DIR/out" "$capture") ;;
+        esac
+        awk -v cfg="$config" -v mode="$mode" -v s="$secs" -v f="$frames" -v b="$bytes" \
+            'BEGIN { if(s <= 0) s = 1e-9;
+                     printf "%-16s  %-8s  %10.3f  %14.0f  %10.1f\n", cfg, mode, s, f / s, b / s / 1e6 }'
+    done
+done
+
+if [ "${BENCH_KEEP:-0}" != 1 ]; then
+    rm -rf "$BENCH_DIR"
+fi
@@ -0,0 +1,240 @@
+#!/bin/sh
+# check.sh: Regression checks for trackcutter; run by `make check'.
+# Copyright (C) 2026 agent <agent@local>
+#
+# Usage: check.sh [TRACKCUTTER [GENCAPTURE]]
+#
+# Generates synthetic recordings with gencapture, with their exact track
+# boundaries written alongside (--truth), covering the cases that trip up
+# silence detection (as bench-accuracy.sh does), plus a few mono ones for
+# --batch. Each recording is then put through every way trackcutter has
+# of processing it, and the results are checked against a single plain
+# run over it, the reference:
+#
+#   truth      The reference cut points lie within CHECK_TOLERANCE seconds
+#              of the true boundaries, and there are as many tracks.
+#   blocks     Reading CHECK_READ_BLOCKS frames at a time (set through a
+#              --wisdom file) gives the same cut points, and analysis
+#              figures within CHECK_EPSILON.
+#   shards     Splitting the recording into N shards for each N in
+#              CHECK_SHARDS, and merging them, gives the same cut points
+#              and analysis figures within CHECK_EPSILON. With --high-pass
+#              the shards' filters start up differently (see --merge in
+#              the manual), so there the cut points need only be within
+#              CHECK_TOLERANCE seconds of the reference's.
+#   extract    Extracting the tracks with the write block lengths in
+#              CHECK_WRITE_BLOCKS gives the same --manifest.
+#   batch      --batch over the mono recordings gives the same cut points
+#              as running over each in turn.
+#
+# Analysis figures are compared relative to their size, so CHECK_EPSILON
+# bounds the relative error; a figure that isn't a number (such as -inf)
+# must match exactly. Each check prints PASS or FAIL; the script exits
+# with status 1 if any failed.
+#
+# The following environment variables may be set to alter the checks:
+#
+#   CHECK_DIR          Scratch directory for recordings and results
+#                      (default: check.tmp; removed afterwards if all the
+#                      checks passed, unless CHECK_KEEP is set to 1)
+#   CHECK_DURATION     Length of each recording, in seconds or [HH:]MM:SS
+#                      (default: 2:00)
+#   CHECK_CASES        Space-separated list of stereo recordings to
+#                      generate, from: plain fades gap-clicks hum pauses
+#                      (default: all of them)
+#   CHECK_BATCH        Number of mono recordings for --batch (default: 3)
+#   CHECK_SHARDS       Space-separated shard counts (default: 2 3 7)
+#   CHECK_READ_BLOCKS  Space-separated read block lengths, in frames
+#                      (default: 1 97 65536)
+#   CHECK_WRITE_BLOCKS Space-separated write block lengths, in frames
+#                      (default: 1 4099)
+#   CHECK_TOLERANCE    Distance from the truth or reference within which a
+#                      cut point passes, in seconds (default: 0.5)
+#   CHECK_EPSILON      Relative tolerance for analysis figures
+#                      (default: 1e-9)
+#   CHECK_SEED         Random number seed given to gencapture (default: 1)
+
+TRACKCUTTER=${1:-./trackcutter}
+GENCAPTURE=${2:-./gencapture}
+CHECK_DIR=${CHECK_DIR:-check.tmp}
+CHECK_DURATION=${CHECK_DURATION:-2:00}
+CHECK_CASES=${CHECK_CASES:-"plain fades gap-clicks hum pauses"}
+CHECK_BATCH=${CHECK_BATCH:-3}
+CHECK_SHARDS=${CHECK_SHARDS:-"2 3 7"}
+CHECK_READ_BLOCKS=${CHECK_READ_BLOCKS:-"1 97 65536"}
+CHECK_WRITE_BLOCKS=${CHECK_WRITE_BLOCKS:-"1 4099"}
+CHECK_TOLERANCE=${CHECK_TOLERANCE:-0.5}
+CHECK_EPSILON=${CHECK_EPSILON:-1e-9}
+CHECK_SEED=${CHECK_SEED:-1}
+
+failed=0
+
+# Prints the gencapture options that produce the named case
+case_options()
+{
+    case $1 in
+        plain)      echo "" ;;
+        fades)      echo "--fade-out=5-15" ;;
+        gap-clicks) echo "--clicks=60" ;;
+        hum)        echo "--hum=-50" ;;
+        pauses)     echo "--pauses=0.5 --pause-length=0.5-3" ;;
+        *)          echo "check.sh: unknown case \`$1'" >&2; exit 2 ;;
+    esac
+}
+
+# Reports the outcome of check $1: passed if the remaining arguments,
+# run as a command, succeed
+check()
+{
+    name=$1
+    shift
+    if "$@"; then
+        echo "PASS: $name"
+    else
+        echo "FAIL: $name"
+        failed=1
+    fi
+}
+
+# Writes a wisdom file $1 with read and write block lengths $2 and $3
+# (zero for the default)
+wisdom()
+{
+    printf 'version 1\nread_block_frames %d\nwrite_block_frames %d\n' "$2" "$3" > "$1"
+}
+
+# Succeeds if the frame-index cuts files $1 and $2 hold as many tracks,
+# with every start and end point within $3 frames of each other
+same_cuts()
+{
+    awk -v tol="$3" '
+        $1 !~ /^[0-9]+$/ { next }
+        FNR == NR { s[++n] = $2; e[n] = $3; next }
+        {
+            m++
+            ds = $2 - s[m]; de = $3 - e[m]
+            if(m > n || ds > tol || -ds > tol || de > tol || -de > tol) bad = 1
+        }
+        END { exit (bad || m != n) }' "$1" "$2"
+}
+
+# Succeeds if the analysis tables $1 and $2 have the same statistics, the
+# numbers among them agreeing within CHECK_EPSILON relative error
+same_analysis()
+{
+    awk -v eps="$CHECK_EPSILON" '
+        function num(x) { return x ~ /^[-+]?[0-9]+(\.[0-9]*)?([eE][-+]?[0-9]+)?$/ }
+        FNR == NR { a[FNR] = $0; n = FNR; next }
+        {
+            if(FNR > n) { bad = 1; next }
+            if(split(a[FNR], x) != NF) { bad = 1; next }
+            for(i = 1; i <= NF; i++) {
+                if(num($i) && num(x[i])) {
+                    d = $i - x[i]; if(d < 0) d = -d
+                    m = (x[i] < 0) ? -x[i] : x[i]
+                    if(d > eps * (m > 1 ? m : 1)) bad = 1
+                }
+                else if($i != x[i]) bad = 1
+            }
+        }
+        END { exit (bad || FNR != n) }' "$1" "$2"
+}
+
+# Runs shards 1 to $2 of recording $1 with further options $4..., then
+# merges them, writing the result to $3
+shard_run()
+{
+    rec=$1
+    n=$2
+    out=$3
+    shift 3
+    i=1
+    parts=
+    while [ $i -le "$n" ]; do
+        "$TRACKCUTTER" --wisdom="$CHECK_DIR/default.wisdom" "$@" --shard=$i/$n \
+            --cuts-file="$out.$i" "$rec" || return 1
+        parts="$parts $out.$i"
+        i=$((i + 1))
+    done
+    "$TRACKCUTTER" --wisdom="$CHECK_DIR/default.wisdom" -P --merge $parts > "$out"
+}
+
+# Extracts the tracks of recording $1 with the wisdom file $2, writing
+# the manifest less its file name column to $3
+extract_run()
+{
+    rm -rf "$CHECK_DIR/tracks"
+    mkdir "$CHECK_DIR/tracks"
+    "$TRACKCUTTER" --wisdom="$2" -d "$CHECK_DIR/tracks" --manifest=- "$1" |
+        awk '{ $NF = ""; print }' > "$3"
+}
+
+set -e
+rm -rf "$CHECK_DIR"
+mkdir -p "$CHECK_DIR"
+wisdom "$CHECK_DIR/default.wisdom" 0 0
+for c in $CHECK_CASES; do
+    "$GENCAPTURE" -d "$CHECK_DURATION" -s "$CHECK_SEED" $(case_options "$c") \
+        --truth="$CHECK_DIR/$c.truth" "$CHECK_DIR/$c.wav"
+done
+i=1
+while [ $i -le "$CHECK_BATCH" ]; do
+    "$GENCAPTURE" -c 1 -d "$CHECK_DURATION" -s $((CHECK_SEED + i)) "$CHECK_DIR/mono$i.wav"
+    i=$((i + 1))
+done
+set +e
+
+for c in $CHECK_CASES; do
+    rec="$CHECK_DIR/$c.wav"
+    ref="$CHECK_DIR/$c"
+    tol=$(awk -v t="$CHECK_TOLERANCE" 'BEGIN { printf "%d", t * 44100 }')
+
+    "$TRACKCUTTER" --wisdom="$CHECK_DIR/default.wisdom" -P "$rec" > "$ref.cuts"
+    "$TRACKCUTTER" --wisdom="$CHECK_DIR/default.wisdom" -H -P "$rec" > "$ref.hpf.cuts"
+    "$TRACKCUTTER" --wisdom="$CHECK_DIR/default.wisdom" -a "$rec" > "$ref.analysis"
+    check "$c: truth" same_cuts "$CHECK_DIR/$c.truth" "$ref.cuts" "$tol"
+    check "$c: truth (-H)" same_cuts "$CHECK_DIR/$c.truth" "$ref.hpf.cuts" "$tol"
+
+    for n in $CHECK_READ_BLOCKS; do
+        wisdom "$CHECK_DIR/read$n.wisdom" "$n" 0
+        "$TRACKCUTTER" --wisdom="$CHECK_DIR/read$n.wisdom" -P "$rec" > "$ref.read$n.cuts"
+        "$TRACKCUTTER" --wisdom="$CHECK_DIR/read$n.wisdom" -a "$rec" > "$ref.read$n.analysis"
+        check "$c: read blocks of $n, cuts" same_cuts "$ref.cuts" "$ref.read$n.cuts" 0
+        check "$c: read blocks of $n, analysis" same_analysis "$ref.analysis" "$ref.read$n.analysis"
+    done
+
+    for n in $CHECK_SHARDS; do
+        shard_run "$rec" "$n" "$ref.shard$n.cuts" -P
+        check "$c: $n shards, cuts" same_cuts "$ref.cuts" "$ref.shard$n.cuts" 0
+        shard_run "$rec" "$n" "$ref.shard$n.hpf.cuts" -H -P
+        check "$c: $n shards, cuts (-H)" same_cuts "$ref.hpf.cuts" "$ref.shard$n.hpf.cuts" "$tol"
+        shard_run "$rec" "$n" "$ref.shard$n.analysis" -a
+        check "$c: $n shards, analysis" same_analysis "$ref.analysis" "$ref.shard$n.analysis"
+    done
+
+    extract_run "$rec" "$CHECK_DIR/default.wisdom" "$ref.manifest"
+    for n in $CHECK_WRITE_BLOCKS; do
+        wisdom "$CHECK_DIR/write$n.wisdom" 0 "$n"
+        extract_run "$rec" "$CHECK_DIR/write$n.wisdom" "$ref.write$n.manifest"
+        check "$c: write blocks of $n, manifest" cmp -s "$ref.manifest" "$ref.write$n.manifest"
+    done
+done
+
+if [ "$CHECK_BATCH" -gt 0 ]; then
+    i=1
+    monos=
+    while [ $i -le "$CHECK_BATCH" ]; do
+        echo "==> $CHECK_DIR/mono$i.wav <=="
+        "$TRACKCUTTER" --wisdom="$CHECK_DIR/default.wisdom" -P "$CHECK_DIR/mono$i.wav"
+        monos="$monos $CHECK_DIR/mono$i.wav"
+        i=$((i + 1))
+    done > "$CHECK_DIR/batch.ref"
+    "$TRACKCUTTER" --wisdom="$CHECK_DIR/default.wisdom" -P --batch $monos |
+        grep -v '^$' > "$CHECK_DIR/batch.cuts"
+    check "batch of $CHECK_BATCH" cmp -s "$CHECK_DIR/batch.ref" "$CHECK_DIR/batch.cuts"
+fi
+
+if [ $failed = 0 ] && [ "${CHECK_KEEP:-0}" != 1 ]; then
+    rm -rf "$CHECK_DIR"
+fi
+exit $failed
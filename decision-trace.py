@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+# decision-trace.py: Converts trackcutter --decision-trace files to CSV
+# Copyright (C) 2026 agent <agent@local>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or (at
+# your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+"""Prints the records of a trackcutter --decision-trace file as CSV.
+
+    decision-trace.py side-a.dtrace                  # the whole file
+    decision-trace.py side-a.dtrace 1:02:10-1:02:40  # a stretch of it
+    decision-trace.py -I side-a.dtrace 441000-       # by frame index
+
+A range is given in time as for trackcutter's -t, or in frames as for
+its -I if -I is given; either end may be left out. Records are all the
+same length and in frame order, so the start of the range is found by
+binary search without reading the rest of the file. Levels and the noise
+floor threshold are printed as RMS levels in dBFS, as given to
+--noise-floor; the context is the cut context after the frame, and ttl
+its time to live in frames. Records marked `change' are those where the
+context changed, the others start each hop.
+
+Only the Python standard library is needed. See init_decision_trace()
+in trackcutter.c for the file format."""
+
+import csv
+import math
+import mmap
+import os
+import signal
+import struct
+import sys
+
+MAGIC = b"TCDT"
+VERSION = 1
+HEADER = struct.Struct("<4sIIIIIq")
+RECORD_HEAD = struct.Struct("<qBBxxid")
+CONTEXTS = ("silence", "track", "track_starting", "track_ending")
+FLAG_SIGNAL, FLAG_EXEMPT, FLAG_CHANGE = 0x01, 0x02, 0x04
+
+
+def parse_time(s):
+    """Seconds given by [[HH:]MM:]SS.SSS."""
+    secs = 0.0
+    for part in s.split(":"):
+        secs = secs * 60 + float(part)
+    return secs
+
+
+def parse_range(s, rate, frames):
+    """Frame range [start, end) given by S-F; either may be empty."""
+    start, sep, end = s.partition("-")
+    if not sep:
+        raise ValueError("range must be given as START-END")
+    conv = (lambda v: int(v)) if frames else (lambda v: int(round(parse_time(v) * rate)))
+    return (conv(start) if start.strip() else 0,
+            conv(end) if end.strip() else None)
+
+
+def dbfs(sum_sq, window):
+    """RMS level in dBFS of a sum of squares over the RMS window."""
+    return 10 * math.log10(sum_sq / window) if sum_sq > 0 else float("-inf")
+
+
+def main(argv):
+    frames = False
+    if argv and argv[0] == "-I":
+        frames = True
+        argv = argv[1:]
+    if len(argv) not in (1, 2):
+        sys.exit("usage: decision-trace.py [-I] FILE [START-END]")
+
+    with open(argv[0], "rb") as f:
+        # mmap() refuses an empty file, so check the size first
+        if os.fstat(f.fileno()).st_size < HEADER.size:
+            sys.exit("%s: not a decision trace file" % argv[0])
+        data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    magic, version, rate, channels, hop, window, first = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        sys.exit("%s: not a decision trace file" % argv[0])
+    if version != VERSION:
+        sys.exit("%s: unsupported version %d" % (argv[0], version))
+    levels = struct.Struct("<%dd" % channels)
+    rec_sz = RECORD_HEAD.size + levels.size
+    count = (len(data) - HEADER.size) // rec_sz
+    start, end = parse_range(argv[1], rate, frames) if len(argv) > 1 else (0, None)
+
+    def frame_of(i):
+        return struct.unpack_from("<q", data, HEADER.size + i * rec_sz)[0]
+
+    # First record at or after the start of the range
+    lo, hi = 0, count
+    while lo < hi:
+        mid = (lo + hi) // 2
+        if frame_of(mid) < start:
+            lo = mid + 1
+        else:
+            hi = mid
+
+    out = csv.writer(sys.stdout, lineterminator="\n")
+    out.writerow(["frame", "seconds", "context", "ttl", "signal", "exempt", "change",
+                  "threshold_dbfs"] + ["level_dbfs_%d" % (c + 1) for c in range(channels)])
+    for i in range(lo, count):
+        ofs = HEADER.size + i * rec_sz
+        frame, context, flags, ttl, threshold = RECORD_HEAD.unpack_from(data, ofs)
+        if end is not None and frame >= end:
+            break
+        out.writerow([frame, "%.5f" % (frame / rate),
+                      CONTEXTS[context] if context < len(CONTEXTS) else context, ttl,
+                      int(bool(flags & FLAG_SIGNAL)), int(bool(flags & FLAG_EXEMPT)),
+                      int(bool(flags & FLAG_CHANGE)), "%.2f" % dbfs(threshold, window)]
+                     + ["%.2f" % dbfs(x, window)
+                        for x in levels.unpack_from(data, ofs + RECORD_HEAD.size)])
+
+
+if __name__ == "__main__":
+    # Stop quietly when the output is cut short, as by head(1)
+    signal.signal(signal.SIGPIPE, signal.SIG_DFL)
+    try:
+        main(sys.argv[1:])
+    except (OSError, ValueError) as e:
+        sys.exit("decision-trace.py: %s" % e)
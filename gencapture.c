@@ -0,0 +1,677 @@
+/*  gencapture: Generates synthetic multi-song recordings for benchmarking trackcutter
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or (at
+    your option) any later version.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+/** @file gencapture.c
+
+    Writes a synthetic recording resembling a digitised cassette or LP:
+    a series of tracks of tonal or noisy content, separated by gaps of
+    silence, with background hiss, mains hum, a DC offset and the odd
+    click laid over the whole thing. Tracks can optionally fade out, or
+    pause briefly part way through, to make the boundaries harder to
+    find.
+
+    The output is entirely determined by the options given (including
+    the random seed), so the same workload can be regenerated anywhere.
+    The exact track boundaries can be written out alongside, in the
+    layout of a trackcutter cuts file, for checking detection against.
+    Used by `make bench'; not installed. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <features.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sndfile.h>
+#include <getopt.h>
+#include <errno.h>
+#include <error.h>
+#include <math.h>
+#include <stdint.h>
+
+/** Definition for boolean constant @e false */
+#define FALSE 0
+/** Definition for boolean constant @e true */
+#define TRUE (!FALSE)
+
+/** Maximum number of channels supported (as for trackcutter) */
+#define MAX_CHANNELS 8
+
+/** Number of frames generated and written at a time */
+#define BLOCK_LEN 4096
+
+/** Number of harmonics in each note of a tonal track */
+#define NUM_HARMONICS 4
+
+/** Default sampling rate, in Hz */
+#define DFL_RATE 44100
+/** Default number of channels */
+#define DFL_CHANNELS 2
+/** Default sample size, in bits */
+#define DFL_BITS 16
+/** Default length of recording, in seconds */
+#define DFL_DURATION 600.0
+/** Default shortest track length, in seconds */
+#define DFL_MIN_TRACK_LEN 150.0
+/** Default longest track length, in seconds */
+#define DFL_MAX_TRACK_LEN 300.0
+/** Default shortest gap between tracks, in seconds */
+#define DFL_MIN_GAP_LEN 2.0
+/** Default longest gap between tracks, in seconds */
+#define DFL_MAX_GAP_LEN 5.0
+/** Default background hiss level, in dBFS */
+#define DFL_HISS -60.0
+/** Default mains hum level, in dBFS */
+#define DFL_HUM -66.0
+/** Default mains frequency, in Hz */
+#define DFL_HUM_FREQ 50.0
+/** Default DC offset, as a fraction of full scale */
+#define DFL_DC_OFFSET 0.002
+/** Default number of clicks per minute */
+#define DFL_CLICKS 4.0
+/** Default shortest pause within a track, in seconds */
+#define DFL_MIN_PAUSE_LEN 0.5
+/** Default longest pause within a track, in seconds */
+#define DFL_MAX_PAUSE_LEN 2.5
+
+/** Identifiers for long options that don't have a short equivalent */
+typedef enum {
+    LOPT_TRACK_LENGTH = 0x100,  /**< --track-length */
+    LOPT_GAP_LENGTH,            /**< --gap-length */
+    LOPT_HISS,                  /**< --hiss */
+    LOPT_HUM,                   /**< --hum */
+    LOPT_HUM_FREQ,              /**< --hum-freq */
+    LOPT_DC_OFFSET,             /**< --dc-offset */
+    LOPT_CLICKS,                /**< --clicks */
+    LOPT_TRUTH,                 /**< --truth */
+    LOPT_FADE_OUT,              /**< --fade-out */
+    LOPT_PAUSES,                /**< --pauses */
+    LOPT_PAUSE_LENGTH           /**< --pause-length */
+} long_only_opt_t;
+
+/** Kind of material in a passage of the recording */
+typedef enum {
+    SEG_GAP,        /**< Silence between tracks (hiss, hum and clicks only) */
+    SEG_TONAL,      /**< A track of pitched notes */
+    SEG_NOISY       /**< A track of rhythmic noise bursts (percussion) */
+} seg_kind_t;
+
+/** Command-line argument structure */
+typedef struct {
+    const char *out_file_name;  /**< Name of file to write */
+    int rate;                   /**< Sampling rate in Hz */
+    int channels;               /**< Number of channels */
+    int bits;                   /**< Sample size in bits (0 for floating point) */
+    double duration;            /**< Length of recording, in seconds */
+    double min_track_len;       /**< Shortest track, in seconds */
+    double max_track_len;       /**< Longest track, in seconds */
+    double min_gap_len;         /**< Shortest gap between tracks, in seconds */
+    double max_gap_len;         /**< Longest gap between tracks, in seconds */
+    double hiss_dbfs;           /**< Background hiss level, in dBFS */
+    double hum_dbfs;            /**< Mains hum level, in dBFS */
+    double hum_freq;            /**< Mains frequency, in Hz */
+    double dc_offset;           /**< DC offset, as a fraction of full scale */
+    double clicks;              /**< Average number of clicks per minute */
+    uint64_t seed;              /**< Random number generator seed */
+    const char *truth_file_name;/**< File to write the track boundaries to (@c NULL if not wanted) */
+    double min_fade_len;        /**< Shortest fade-out at the end of each track, in seconds (0 for none) */
+    double max_fade_len;        /**< Longest fade-out at the end of each track, in seconds (0 for none) */
+    double pauses;              /**< Average number of pauses per minute within tracks */
+    double min_pause_len;       /**< Shortest pause within a track, in seconds */
+    double max_pause_len;       /**< Longest pause within a track, in seconds */
+} options_t;
+
+/** Generator state */
+typedef struct {
+    uint64_t rng;               /**< xorshift64* random number generator state */
+    sf_count_t frame_idx;       /**< Index of next frame to be generated */
+    sf_count_t total_frames;    /**< Length of recording, in frames */
+    seg_kind_t seg_kind;        /**< Kind of passage being generated */
+    sf_count_t seg_end;         /**< Frame index at which current passage ends */
+    int track_num;              /**< Number of tracks started so far */
+    double level;               /**< Peak level of current track */
+    double pan[MAX_CHANNELS];   /**< Per-channel gain of current track */
+    sf_count_t note_end;        /**< Frame index at which current note (or beat) ends */
+    sf_count_t note_len;        /**< Length of current note (or beat), in frames */
+    double phase[NUM_HARMONICS];/**< Oscillator phases of current note */
+    double dphase;              /**< Phase increment of fundamental, per frame */
+    double noise_lp[MAX_CHANNELS]; /**< Low-pass filter state for noisy tracks */
+    double click_env;           /**< Envelope of the click being played, if any */
+    double click_sign;          /**< Polarity of the click being played */
+    double hum_phase;           /**< Mains hum oscillator phase */
+    FILE *truth_file;           /**< Track boundaries destination; NULL if not wanted */
+    sf_count_t track_start;     /**< Frame index at which current track started */
+    sf_count_t fade_start;      /**< Frame index at which current track starts fading out */
+    sf_count_t pause_end;       /**< Frame index at which the current pause (if any) ends */
+} state_t;
+
+/** Short option list for @c getopt() */
+static const char shortopts[] = "hr:c:b:d:s:";
+
+/** Long option array to supply to @c getopt_long() */
+static const struct option longopts[] =
+{
+    { "help", no_argument, NULL, 'h' },
+    { "rate", required_argument, NULL, 'r' },
+    { "channels", required_argument, NULL, 'c' },
+    { "bits", required_argument, NULL, 'b' },
+    { "duration", required_argument, NULL, 'd' },
+    { "seed", required_argument, NULL, 's' },
+    { "track-length", required_argument, NULL, LOPT_TRACK_LENGTH },
+    { "gap-length", required_argument, NULL, LOPT_GAP_LENGTH },
+    { "hiss", required_argument, NULL, LOPT_HISS },
+    { "hum", required_argument, NULL, LOPT_HUM },
+    { "hum-freq", required_argument, NULL, LOPT_HUM_FREQ },
+    { "dc-offset", required_argument, NULL, LOPT_DC_OFFSET },
+    { "clicks", required_argument, NULL, LOPT_CLICKS },
+    { "truth", required_argument, NULL, LOPT_TRUTH },
+    { "fade-out", required_argument, NULL, LOPT_FADE_OUT },
+    { "pauses", required_argument, NULL, LOPT_PAUSES },
+    { "pause-length", required_argument, NULL, LOPT_PAUSE_LENGTH },
+    { NULL },
+};
+
+/** Semitone offsets of a major pentatonic scale, used for picking notes */
+static const int pentatonic[] = { 0, 2, 4, 7, 9, 12, 14, 16 };
+
+/** Global command-line options */
+static options_t options;
+
+/** Global generator state */
+static state_t state;
+
+/** Prints the help message to standard output */
+static void print_help_msg(void)
+{
+    printf("Usage: %s [OPTION...] FILE\n", program_invocation_short_name);
+    printf("Writes a synthetic multi-song recording to FILE (WAV format) for benchmarking.\n");
+    printf("\n");
+    printf("  -r, --rate=N           Sampling rate in Hz. Default is %d.\n", DFL_RATE);
+    printf("  -c, --channels=N       Number of channels (max %d). Default is %d.\n", MAX_CHANNELS, DFL_CHANNELS);
+    printf("  -b, --bits=N           Bits per sample (8, 16, 24, 32), or `float'.\n");
+    printf("                         Default is %d.\n", DFL_BITS);
+    printf("  -d, --duration=T       Length of recording, in seconds or [HH:]MM:SS.\n");
+    printf("                         Default is %.0f seconds.\n", DFL_DURATION);
+    printf("  -s, --seed=N           Random number seed. Default is 1.\n");
+    printf("      --track-length=A-B Tracks last between A and B seconds.\n");
+    printf("                         Default is %.0f-%.0f.\n", DFL_MIN_TRACK_LEN, DFL_MAX_TRACK_LEN);
+    printf("      --gap-length=A-B   Gaps between tracks last between A and B seconds.\n");
+    printf("                         Default is %.0f-%.0f.\n", DFL_MIN_GAP_LEN, DFL_MAX_GAP_LEN);
+    printf("      --hiss=N           Background hiss level in dBFS. Default is %.0f.\n", DFL_HISS);
+    printf("      --hum=N            Mains hum level in dBFS. Default is %.0f.\n", DFL_HUM);
+    printf("      --hum-freq=N       Mains frequency in Hz. Default is %.0f.\n", DFL_HUM_FREQ);
+    printf("      --dc-offset=N      DC offset within [-1.0, +1.0]. Default is %g.\n", DFL_DC_OFFSET);
+    printf("      --clicks=N         Average number of clicks per minute. Default is %.0f.\n", DFL_CLICKS);
+    printf("      --fade-out=A-B     Tracks fade out to silence over their last A to B\n");
+    printf("                         seconds. By default they stop dead.\n");
+    printf("      --pauses=N         Average number of pauses per minute within tracks.\n");
+    printf("                         Default is none.\n");
+    printf("      --pause-length=A-B Pauses within tracks last between A and B seconds.\n");
+    printf("                         Default is %.1f-%.1f.\n", DFL_MIN_PAUSE_LEN, DFL_MAX_PAUSE_LEN);
+    printf("      --truth=FILE       Write the frame indices where each track starts and\n");
+    printf("                         ends to FILE, laid out as a trackcutter cuts file.\n");
+    printf("  -h, --help             Display this help message and exit.\n");
+}
+
+/** Parses a real number argument, terminating with an error message if invalid. */
+static double parse_real_arg(const char *s)
+{
+    /* tail: First character not parsed */
+    char *tail;
+    double x;
+
+    errno = 0;
+    x = strtod(s, &tail);
+    if(tail == s || *tail || errno || !isfinite(x))
+    {
+        error(EXIT_FAILURE, 0, "Invalid number `%s'", s);
+    }
+    return x;
+}
+
+/** Parses a positive integer argument, terminating with an error message if invalid. */
+static int parse_positive_int_arg(const char *s)
+{
+    /* tail: First character not parsed */
+    char *tail;
+    long x;
+
+    errno = 0;
+    x = strtol(s, &tail, 10);
+    if(tail == s || *tail || errno || x <= 0 || x > INT32_MAX)
+    {
+        error(EXIT_FAILURE, 0, "Invalid positive integer `%s'", s);
+    }
+    return (int)x;
+}
+
+/** Parses a duration given as seconds, MM:SS or HH:MM:SS. */
+static double parse_duration_arg(const char *s)
+{
+    /* x: Total so far, in seconds */
+    /* field: Current colon-separated field */
+    double x = 0.0;
+    char field[64];
+    const char *colon;
+
+    while((colon = strchr(s, ':')) != NULL)
+    {
+        if((size_t)(colon - s) >= sizeof(field))
+        {
+            error(EXIT_FAILURE, 0, "Invalid duration `%s'", s);
+        }
+        memcpy(field, s, colon - s);
+        field[colon - s] = 0;
+        x = x * 60.0 + parse_real_arg(field);
+        s = colon + 1;
+    }
+    x = x * 60.0 + parse_real_arg(s);
+    if(x <= 0.0)
+    {
+        error(EXIT_FAILURE, 0, "Duration must be positive");
+    }
+    return x;
+}
+
+/** Parses a range argument of the form A-B (in seconds). */
+static void parse_range_arg(const char *s, double *min, double *max)
+{
+    /* tail: First character not parsed */
+    char *tail;
+
+    errno = 0;
+    *min = strtod(s, &tail);
+    if(tail == s || *tail != '-' || errno)
+    {
+        error(EXIT_FAILURE, 0, "Invalid range `%s'; must be of form A-B", s);
+    }
+    *max = parse_real_arg(tail + 1);
+    if(*min <= 0.0 || *max < *min)
+    {
+        error(EXIT_FAILURE, 0, "Invalid range `%s'", s);
+    }
+}
+
+/** Parses command-line arguments into #options. */
+static void parse_options(int argc, char **argv)
+{
+    /* opt: Option returned by getopt_long() */
+    int opt;
+
+    options.rate = DFL_RATE;
+    options.channels = DFL_CHANNELS;
+    options.bits = DFL_BITS;
+    options.duration = DFL_DURATION;
+    options.min_track_len = DFL_MIN_TRACK_LEN;
+    options.max_track_len = DFL_MAX_TRACK_LEN;
+    options.min_gap_len = DFL_MIN_GAP_LEN;
+    options.max_gap_len = DFL_MAX_GAP_LEN;
+    options.hiss_dbfs = DFL_HISS;
+    options.hum_dbfs = DFL_HUM;
+    options.hum_freq = DFL_HUM_FREQ;
+    options.dc_offset = DFL_DC_OFFSET;
+    options.clicks = DFL_CLICKS;
+    options.min_pause_len = DFL_MIN_PAUSE_LEN;
+    options.max_pause_len = DFL_MAX_PAUSE_LEN;
+    options.seed = 1;
+
+    while((opt = getopt_long(argc, argv, shortopts, longopts, NULL)) >= 0)
+    {
+        switch(opt)
+        {
+            case 'h':
+                print_help_msg();
+                exit(EXIT_SUCCESS);
+            case 'r':
+                options.rate = parse_positive_int_arg(optarg);
+                break;
+            case 'c':
+                options.channels = parse_positive_int_arg(optarg);
+                if(options.channels > MAX_CHANNELS)
+                {
+                    error(EXIT_FAILURE, 0, "At most %d channels are supported", MAX_CHANNELS);
+                }
+                break;
+            case 'b':
+                options.bits = (strcmp(optarg, "float") == 0) ? 0 : parse_positive_int_arg(optarg);
+                if(options.bits != 0 && options.bits != 8 && options.bits != 16
+                    && options.bits != 24 && options.bits != 32)
+                {
+                    error(EXIT_FAILURE, 0, "Sample size must be 8, 16, 24, 32 or `float'");
+                }
+                break;
+            case 'd':
+                options.duration = parse_duration_arg(optarg);
+                break;
+            case 's':
+                options.seed = strtoull(optarg, NULL, 0);
+                break;
+            case LOPT_TRACK_LENGTH:
+                parse_range_arg(optarg, &options.min_track_len, &options.max_track_len);
+                break;
+            case LOPT_GAP_LENGTH:
+                parse_range_arg(optarg, &options.min_gap_len, &options.max_gap_len);
+                break;
+            case LOPT_HISS:
+                options.hiss_dbfs = parse_real_arg(optarg);
+                break;
+            case LOPT_HUM:
+                options.hum_dbfs = parse_real_arg(optarg);
+                break;
+            case LOPT_HUM_FREQ:
+                options.hum_freq = parse_real_arg(optarg);
+                break;
+            case LOPT_DC_OFFSET:
+                options.dc_offset = parse_real_arg(optarg);
+                if(options.dc_offset < -1.0 || options.dc_offset > 1.0)
+                {
+                    error(EXIT_FAILURE, 0, "DC offset must be within [-1.0, +1.0]");
+                }
+                break;
+            case LOPT_CLICKS:
+                options.clicks = parse_real_arg(optarg);
+                break;
+            case LOPT_TRUTH:
+                options.truth_file_name = optarg;
+                break;
+            case LOPT_FADE_OUT:
+                parse_range_arg(optarg, &options.min_fade_len, &options.max_fade_len);
+                break;
+            case LOPT_PAUSES:
+                options.pauses = parse_real_arg(optarg);
+                break;
+            case LOPT_PAUSE_LENGTH:
+                parse_range_arg(optarg, &options.min_pause_len, &options.max_pause_len);
+                break;
+            default:
+                fprintf(stderr, "Try `%s --help' for more information.\n", program_invocation_short_name);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(optind + 1 != argc)
+    {
+        fprintf(stderr, "Try `%s --help' for more information.\n", program_invocation_short_name);
+        error(EXIT_FAILURE, 0, (optind < argc) ? "Only one output file may be given" : "No output file was specified");
+    }
+    options.out_file_name = argv[optind];
+}
+
+/** Returns a uniformly-distributed random number in [0, 1). This is an
+    xorshift64* generator, so that output doesn't depend on the C library. */
+static double rnd(void)
+{
+    state.rng ^= state.rng >> 12;
+    state.rng ^= state.rng << 25;
+    state.rng ^= state.rng >> 27;
+    return (double)((state.rng * 0x2545f4914f6cdd1dULL) >> 11) / 9007199254740992.0;
+}
+
+/** Returns a random number in [@a min, @a max). */
+static double rnd_range(double min, double max)
+{
+    return min + (max - min) * rnd();
+}
+
+/** Converts a dBFS level to a linear amplitude. */
+static double dbfs_to_amplitude(double dbfs)
+{
+    return pow(10.0, dbfs / 20.0);
+}
+
+/** Writes the boundaries of the track that has just finished to the
+    truth file, if one is wanted. The end is the frame index just past
+    the track's last frame, as trackcutter reports it. */
+static void print_truth_entry(void)
+{
+    if(state.truth_file)
+    {
+        fprintf(state.truth_file, "%10d  %14lld  %14lld  %18lld  \n", state.track_num,
+            (long long)state.track_start, (long long)state.frame_idx,
+            (long long)(state.frame_idx - state.track_start));
+        if(ferror(state.truth_file))
+        {
+            error(EXIT_FAILURE, errno, "Unable to write to `%s'", options.truth_file_name);
+        }
+    }
+}
+
+/** Starts the next passage of the recording: a gap following a track,
+    or a track (alternating tonal and noisy) following a gap. */
+static void start_next_segment(void)
+{
+    /* len: Length of the new passage, in seconds */
+    /* c: Current channel */
+    double len;
+    int c;
+
+    if(state.seg_kind == SEG_GAP && state.frame_idx > 0)
+    {
+        state.track_num++;
+        state.seg_kind = (rnd() < 0.5) ? SEG_TONAL : SEG_NOISY;
+        len = rnd_range(options.min_track_len, options.max_track_len);
+        state.level = dbfs_to_amplitude(rnd_range(-12.0, -3.0));
+        for(c = 0; c < options.channels; c++)
+        {
+            state.pan[c] = rnd_range(0.6, 1.0);
+        }
+        state.note_end = state.frame_idx;
+        state.track_start = state.frame_idx;
+    }
+    else
+    {
+        print_truth_entry();
+        state.seg_kind = SEG_GAP;
+        len = rnd_range(options.min_gap_len, options.max_gap_len);
+    }
+    state.seg_end = state.frame_idx + (sf_count_t)(len * options.rate);
+    state.fade_start = state.seg_end;
+    if(state.seg_kind != SEG_GAP && options.max_fade_len > 0.0)
+    {
+        /* The fade can take up at most half the track */
+        state.fade_start -= (sf_count_t)(fmin(rnd_range(options.min_fade_len, options.max_fade_len),
+            len / 2.0) * options.rate);
+    }
+}
+
+/** Starts a new note (tonal tracks) or beat (noisy tracks). */
+static void start_next_note(void)
+{
+    /* h: Current harmonic */
+    int h;
+
+    if(state.seg_kind == SEG_TONAL)
+    {
+        /* A random note of the scale, from A2 upwards */
+        double freq = 110.0 * pow(2.0, pentatonic[(int)(rnd() * 8)] / 12.0 + (int)(rnd() * 3));
+
+        state.note_len = (sf_count_t)(rnd_range(0.15, 0.8) * options.rate);
+        state.dphase = 2.0 * M_PI * freq / options.rate;
+        for(h = 0; h < NUM_HARMONICS; h++)
+        {
+            state.phase[h] = 0.0;
+        }
+    }
+    else
+    {
+        /* Eighth notes at 120bpm */
+        state.note_len = options.rate / 4;
+    }
+    state.note_end = state.frame_idx + state.note_len;
+}
+
+/** Generates the next frame into @a frame. */
+static void generate_frame(double *frame)
+{
+    /* env: Envelope of current note, 1.0 at onset */
+    /* x: Sample of programme material (before channel gains) */
+    /* hiss: Amplitude of background hiss */
+    /* hum: Instantaneous mains hum level */
+    /* click: Instantaneous click level */
+    /* gain: Gain of programme material, for pauses and fade-outs */
+    double env;
+    double x = 0.0;
+    double hiss = dbfs_to_amplitude(options.hiss_dbfs);
+    double hum;
+    double click;
+    double gain = 1.0;
+    int c;
+    int h;
+
+    if(state.frame_idx >= state.seg_end)
+    {
+        start_next_segment();
+    }
+    if(state.seg_kind != SEG_GAP && state.frame_idx >= state.note_end)
+    {
+        start_next_note();
+    }
+    env = (state.seg_kind == SEG_GAP) ? 0.0
+        : 1.0 - (double)(state.frame_idx - (state.note_end - state.note_len)) / state.note_len;
+    if(state.seg_kind == SEG_TONAL)
+    {
+        /* Soft attack, then linear decay to 20% */
+        env = fmin(1.0, (1.0 - env) * 50.0) * (0.2 + 0.8 * env);
+        for(h = 0; h < NUM_HARMONICS; h++)
+        {
+            x += sin(state.phase[h]) / (h + 1);
+            state.phase[h] += state.dphase * (h + 1);
+        }
+        x *= state.level * env * 0.5;
+    }
+    if(state.seg_kind != SEG_GAP && options.pauses > 0.0 && state.frame_idx >= state.pause_end
+        && rnd() < options.pauses / (60.0 * options.rate))
+    {
+        /* len: Length of pause, in frames */
+        sf_count_t len = (sf_count_t)(rnd_range(options.min_pause_len, options.max_pause_len) * options.rate);
+
+        /* Keep well clear of the ends, so as not to move the track boundaries */
+        if(state.frame_idx > state.track_start + options.rate
+            && state.frame_idx + len + options.rate < state.fade_start)
+        {
+            state.pause_end = state.frame_idx + len;
+        }
+    }
+    if(state.frame_idx < state.pause_end)
+    {
+        gain = 0.0;
+    }
+    else if(state.frame_idx >= state.fade_start)
+    {
+        /* Linear fade, reaching silence as the track ends */
+        gain = (double)(state.seg_end - state.frame_idx) / (double)(state.seg_end - state.fade_start);
+    }
+    if(options.clicks > 0.0 && rnd() < options.clicks / (60.0 * options.rate))
+    {
+        state.click_env = 1.0;
+        state.click_sign = (rnd() < 0.5) ? -0.5 : 0.5;
+    }
+    click = state.click_sign * state.click_env;
+    state.click_env *= 0.7;
+    hum = dbfs_to_amplitude(options.hum_dbfs)
+        * (sin(state.hum_phase) + 0.5 * sin(3.0 * state.hum_phase));
+    state.hum_phase = fmod(state.hum_phase + 2.0 * M_PI * options.hum_freq / options.rate, 2.0 * M_PI);
+
+    for(c = 0; c < options.channels; c++)
+    {
+        double y = x;
+
+        if(state.seg_kind == SEG_NOISY)
+        {
+            /* Low-passed noise burst with a sharp exponential decay */
+            state.noise_lp[c] += 0.3 * (rnd_range(-1.0, 1.0) - state.noise_lp[c]);
+            y = state.noise_lp[c] * state.level * 2.0 * env * env * env;
+        }
+        y = y * state.pan[c] * gain + hiss * rnd_range(-1.0, 1.0) + hum + click + options.dc_offset;
+        frame[c] = fmax(-1.0, fmin(1.0, y));
+    }
+    state.frame_idx++;
+}
+
+int main(int argc, char **argv)
+{
+    /* sf_info: Output file attributes */
+    /* out_file: Output file */
+    /* buf: Block of generated frames */
+    SF_INFO sf_info;
+    SNDFILE *out_file;
+    double buf[BLOCK_LEN * MAX_CHANNELS];
+
+    parse_options(argc, argv);
+
+    memset(&sf_info, 0, sizeof(sf_info));
+    sf_info.samplerate = options.rate;
+    sf_info.channels = options.channels;
+    sf_info.format = SF_FORMAT_WAV | ((options.bits == 8) ? SF_FORMAT_PCM_U8
+        : (options.bits == 16) ? SF_FORMAT_PCM_16
+        : (options.bits == 24) ? SF_FORMAT_PCM_24
+        : (options.bits == 32) ? SF_FORMAT_PCM_32
+        : SF_FORMAT_FLOAT);
+    out_file = (strcmp(options.out_file_name, "-") == 0)
+        ? sf_open_fd(1, SFM_WRITE, &sf_info, FALSE)
+        : sf_open(options.out_file_name, SFM_WRITE, &sf_info);
+    if(!out_file)
+    {
+        error(EXIT_FAILURE, 0, "Unable to create `%s': %s", options.out_file_name, sf_strerror(NULL));
+    }
+
+    memset(&state, 0, sizeof(state));
+    if(options.truth_file_name)
+    {
+        state.truth_file = fopen(options.truth_file_name, "w");
+        if(!state.truth_file)
+        {
+            error(EXIT_FAILURE, errno, "Unable to create `%s'", options.truth_file_name);
+        }
+        fprintf(state.truth_file, "track_num   %-16s%-16s%-20s\n", "start_frame", "end_frame", "duration_frames");
+    }
+    state.rng = options.seed ? options.seed : 1;
+    state.total_frames = (sf_count_t)(options.duration * options.rate);
+    state.seg_kind = SEG_GAP;
+    state.seg_end = (sf_count_t)(rnd_range(options.min_gap_len, options.max_gap_len) * options.rate);
+    while(state.frame_idx < state.total_frames)
+    {
+        /* n: Number of frames in this block */
+        /* i: Current frame within block */
+        sf_count_t n = (state.total_frames - state.frame_idx < BLOCK_LEN)
+            ? state.total_frames - state.frame_idx : BLOCK_LEN;
+        sf_count_t i;
+
+        for(i = 0; i < n; i++)
+        {
+            generate_frame(buf + i * options.channels);
+        }
+        if(sf_writef_double(out_file, buf, n) < n)
+        {
+            error(EXIT_FAILURE, 0, "Unable to write to `%s': %s", options.out_file_name, sf_strerror(out_file));
+        }
+    }
+    sf_close(out_file);
+    if(state.truth_file)
+    {
+        if(state.seg_kind != SEG_GAP)
+        {
+            /* The recording ends part way through a track */
+            print_truth_entry();
+        }
+        if(fclose(state.truth_file) != 0)
+        {
+            error(EXIT_FAILURE, errno, "Unable to write to `%s'", options.truth_file_name);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,265 @@
+/*  libtrackcutter: Library interface to trackcutter's detection engine
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or (at
+    your option) any later version.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+/** @file libtrackcutter.c
+
+    Builds the engine into a shared library, with the plain C interface
+    declared in libtrackcutter.h, so that detector settings can be tried
+    out from other languages in-process (see trackcutter.py) rather than
+    by running the program and reading back its cuts file.
+
+    trackcutter.c is compiled in directly (with its main() renamed), as
+    for microbench.c, so the results are exactly those of the program.
+    The input is taken from memory in place of a file (see
+    #options_t::in_mem), and each call makes a single pass that both
+    searches for tracks and gathers the --analyse statistics.
+
+    The engine reports fatal errors through error(), which would end the
+    host process; here they jump back out of #tc_run, which fails with
+    the message kept for #tc_last_error. Warnings are dropped. */
+
+#include <error.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include "libtrackcutter.h"
+
+static void lib_error(int status, int errnum, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define error lib_error
+#define main trackcutter_main
+#include "trackcutter.c"
+#undef main
+#undef error
+
+#if MAX_CHANNELS != TC_MAX_CHANNELS
+#   error "TC_MAX_CHANNELS in libtrackcutter.h must match MAX_CHANNELS"
+#endif
+
+/** Size of the buffer holding the message for #tc_last_error */
+#define LIB_ERROR_MSG_SZ 512
+
+/** Description of the input, for messages from the engine */
+static const char lib_in_description[] = "(array)";
+
+/** Where fatal errors within the engine return to, in #tc_run */
+static jmp_buf lib_jmp;
+
+/** Message describing the last failure */
+static char lib_error_msg[LIB_ERROR_MSG_SZ];
+
+/** Tracks found so far by #tc_run */
+static tc_cut_t *lib_cuts;
+
+/** Number of entries in #lib_cuts */
+static int lib_cut_cnt;
+
+/** Allocated number of entries in #lib_cuts */
+static int lib_cut_alloc;
+
+/** Stands in for error() within the engine. Fatal errors are kept for
+    #tc_last_error, and abandon the call to #tc_run in progress;
+    warnings are ignored. */
+static void lib_error(int status, int errnum, const char *format, ...)
+{
+    /* ap: Variable argument pointer */
+    /* len: Length of message so far */
+    va_list ap;
+    int len;
+
+    if(status == 0)
+    {
+        return;
+    }
+    va_start(ap, format);
+    len = vsnprintf(lib_error_msg, sizeof(lib_error_msg), format, ap);
+    va_end(ap);
+    if(errnum && len >= 0 && len < (int)sizeof(lib_error_msg))
+    {
+        snprintf(lib_error_msg + len, sizeof(lib_error_msg) - len, ": %s", strerror(errnum));
+    }
+    longjmp(lib_jmp, 1);
+}
+
+/** Adds a track ending at the current frame to #lib_cuts. */
+static void lib_add_cut(void)
+{
+    if(lib_cut_cnt == lib_cut_alloc)
+    {
+        lib_cut_alloc = lib_cut_alloc ? lib_cut_alloc * 2 : 64;
+        /* cuts: Enlarged #lib_cuts; the old block is kept for
+           #tc_run to free should this fail */
+        tc_cut_t *cuts = realloc(lib_cuts, sizeof(tc_cut_t) * lib_cut_alloc);
+
+        if(!cuts)
+        {
+            lib_error(EXIT_FAILURE, errno, "Unable to allocate memory for cut points");
+        }
+        lib_cuts = cuts;
+    }
+    lib_cuts[lib_cut_cnt].start = state.cut.track_start;
+    lib_cuts[lib_cut_cnt].end = state.cur_frame_pos;
+    lib_cut_cnt++;
+}
+
+/** Releases the buffers set aside by #init_state, ready for the next call. */
+static void lib_release(void)
+{
+    if(state.arena.base)
+    {
+        munmap(state.arena.base, state.arena.size);
+        state.arena.base = NULL;
+    }
+}
+
+void tc_default_params(tc_params_t *params)
+{
+    init_options();
+    memset(params, 0, sizeof(*params));
+    params->noise_floor_dbfs = options.noise_floor_dbfs;
+    params->min_silence_period = options.min_silence_period;
+    params->min_signal_period = options.min_signal_period;
+    params->min_track_length = options.min_track_length;
+    params->floor_window = options.floor_window;
+}
+
+int64_t tc_envelope_len(int64_t frame_cnt, int hop_len)
+{
+    return (hop_len > 0 && frame_cnt > 0) ? (frame_cnt + hop_len - 1) / hop_len : 0;
+}
+
+/** Runs the detector over the whole input set up by #tc_run, adding the
+    tracks found to #lib_cuts and filling in @a envelope (if not @c NULL)
+    every @a params->hop_len frames. Kept out of #tc_run so that none of
+    the locals it changes live in the frame that setjmp() returns to. */
+static void lib_detect(const tc_params_t *params, int64_t frame_cnt, int channels, double *envelope)
+{
+    /* hop_left: Frames until the next envelope point is taken */
+    /* env_row: Next envelope point to be filled in */
+    int hop_left = 0;
+    double *env_row = envelope;
+
+    state.cut.context = CCTX_SILENCE;
+    do
+    {
+        /* prev: Cut context before this frame */
+        cut_context_t prev = state.cut.context;
+
+        analyse_new_frame();
+        update_context();
+        if(prev == CCTX_TRACK_ENDING && state.cut.context == CCTX_SILENCE)
+        {
+            lib_add_cut();
+        }
+        if(envelope && params->hop_len > 0 && state.cur_frame_pos < frame_cnt && hop_left-- == 0)
+        {
+            memcpy(env_row, state.cur_rms, sizeof(double) * channels);
+            env_row += channels;
+            hop_left = params->hop_len - 1;
+        }
+    }
+    while(fetch_next_frame());
+    if(state.cut.context == CCTX_TRACK || state.cut.context == CCTX_TRACK_ENDING)
+    {
+        lib_add_cut();
+    }
+}
+
+int tc_run(const tc_params_t *params, const double *frames, int64_t frame_cnt,
+    int channels, int samplerate, double *envelope, tc_result_t *result)
+{
+    /* c: Current channel in iterative loops */
+    int c;
+
+    memset(result, 0, sizeof(*result));
+    if(channels < 1 || channels > TC_MAX_CHANNELS)
+    {
+        snprintf(lib_error_msg, sizeof(lib_error_msg),
+            "Number of channels must be between 1 and %d", TC_MAX_CHANNELS);
+        return -1;
+    }
+    if(samplerate <= 0 || frame_cnt < 0 || (!frames && frame_cnt > 0) || params->hop_len < 0)
+    {
+        snprintf(lib_error_msg, sizeof(lib_error_msg), "Invalid input array or parameters");
+        return -1;
+    }
+    if(params->noise_floor_dbfs >= 0.0 || params->min_silence_period <= 0
+        || params->min_signal_period <= 0 || params->min_track_length <= 0
+        || params->adaptive_floor_margin < 0.0 || params->floor_window <= 0)
+    {
+        snprintf(lib_error_msg, sizeof(lib_error_msg),
+            "Noise floor must be negative, the floor margin not negative, "
+            "and the periods, track length and floor window positive");
+        return -1;
+    }
+    lib_cuts = NULL;
+    lib_cut_cnt = 0;
+    lib_cut_alloc = 0;
+    if(setjmp(lib_jmp))
+    {
+        lib_release();
+        free(lib_cuts);
+        return -1;
+    }
+
+    init_options();
+    options.in_file_name = lib_in_description;
+    options.in_mem = frames;
+    options.in_sfinfo.frames = frame_cnt;
+    options.in_sfinfo.samplerate = samplerate;
+    options.in_sfinfo.channels = channels;
+    options.noise_floor_dbfs = params->noise_floor_dbfs;
+    options.min_silence_period = params->min_silence_period;
+    options.min_signal_period = params->min_signal_period;
+    options.min_track_length = params->min_track_length;
+    options.high_pass_filter_enabled = params->high_pass_filter != 0;
+    options.adaptive_floor_margin = params->adaptive_floor_margin;
+    options.floor_window = params->floor_window;
+    memcpy(options.dc_offset, params->dc_offset, sizeof(options.dc_offset));
+
+    /* Set up as for --analyse, which leaves out the cuts file, and add
+       the detector on top */
+    options.task = TCT_ANALYSIS;
+    init_state();
+    init_detector();
+    lib_detect(params, frame_cnt, channels, envelope);
+
+    for(c = 0; c < channels; c++)
+    {
+        result->stats.positive_peak[c] = state.pos_peak[c];
+        result->stats.negative_peak[c] = state.neg_peak[c];
+        result->stats.min_rms[c] = state.min_rms[c];
+        result->stats.max_rms[c] = state.max_rms[c];
+        result->stats.avg_rms[c] = state.rms_ttl[c] / (double)state.frames_proc_ttl;
+        result->stats.dc_offset[c] = estimate_dc_offset(c);
+    }
+    result->cuts = lib_cuts;
+    result->cut_cnt = lib_cut_cnt;
+    lib_release();
+    return 0;
+}
+
+void tc_free_result(tc_result_t *result)
+{
+    free(result->cuts);
+    result->cuts = NULL;
+    result->cut_cnt = 0;
+}
+
+const char *tc_last_error(void)
+{
+    return lib_error_msg;
+}
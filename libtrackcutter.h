@@ -0,0 +1,103 @@
+/*  libtrackcutter: Library interface to trackcutter's detection engine
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or (at
+    your option) any later version.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+/** @file libtrackcutter.h
+
+    Plain C interface to the track-cutting and analysis engine, for
+    calling from other languages (see trackcutter.py). Audio is passed
+    in as an array of interleaved frames already in memory, and is read
+    by the engine in place. Only one call may be in progress at a time
+    in a process, as the engine keeps its state in globals.
+
+    The declarations here are repeated in trackcutter.py, so the two
+    must be kept in step. */
+
+#ifndef LIBTRACKCUTTER_H
+#define LIBTRACKCUTTER_H
+
+#include <stdint.h>
+
+/** Most channels the engine can handle */
+#define TC_MAX_CHANNELS 8
+
+/** Detector settings, as given by the like-named command-line options.
+    Use #tc_default_params to fill in the defaults before changing any. */
+typedef struct {
+    double noise_floor_dbfs;    /**< --noise-floor, in dBFS */
+    int min_silence_period;     /**< --min-silence-period, in ms */
+    int min_signal_period;      /**< --min-signal-period, in ms */
+    int min_track_length;       /**< --min-track-length, in seconds */
+    int high_pass_filter;       /**< Non-zero for --high-pass-filter */
+    double dc_offset[TC_MAX_CHANNELS];  /**< --dc-offset, for each channel */
+    int hop_len;                /**< Frames between points of the envelope; zero for none */
+    double adaptive_floor_margin;   /**< --adaptive-floor, in dB; zero for a fixed noise floor */
+    int floor_window;           /**< --floor-window, in seconds */
+} tc_params_t;
+
+/** A track found by #tc_run, as frame indices into the input */
+typedef struct {
+    int64_t start;              /**< First frame of track */
+    int64_t end;                /**< Frame just past the end of track */
+} tc_cut_t;
+
+/** Statistics over the whole input, as given by --analyse (linear
+    levels, not dBFS) */
+typedef struct {
+    double positive_peak[TC_MAX_CHANNELS];  /**< Highest sample */
+    double negative_peak[TC_MAX_CHANNELS];  /**< Lowest sample */
+    double min_rms[TC_MAX_CHANNELS];        /**< Lowest RMS level over the window */
+    double max_rms[TC_MAX_CHANNELS];        /**< Highest RMS level over the window */
+    double avg_rms[TC_MAX_CHANNELS];        /**< Mean RMS level */
+    double dc_offset[TC_MAX_CHANNELS];      /**< Estimated DC offset */
+} tc_stats_t;
+
+/** Outcome of #tc_run */
+typedef struct {
+    tc_cut_t *cuts;             /**< Tracks found, in order; free with #tc_free_result */
+    int cut_cnt;                /**< Number of entries in @a cuts */
+    tc_stats_t stats;           /**< Analysis statistics */
+} tc_result_t;
+
+/** Fills in @a params with the program's default settings. */
+void tc_default_params(tc_params_t *params);
+
+/** Returns the number of envelope points #tc_run gives for @a frame_cnt
+    frames, one every @a hop_len frames starting with the first. */
+int64_t tc_envelope_len(int64_t frame_cnt, int hop_len);
+
+/** Searches @a frames for tracks delimited by silence, and gathers the
+    analysis statistics, in a single pass.
+
+    @param params Detector settings
+    @param frames Interleaved input frames; not modified
+    @param frame_cnt Number of frames in @a frames
+    @param channels Number of channels (1 to #TC_MAX_CHANNELS)
+    @param samplerate Sampling rate in Hz
+    @param envelope If not @c NULL, receives the RMS level of each
+    channel at every @a params->hop_len frames, as a row of @a channels
+    values each; it must have room for #tc_envelope_len rows
+    @param result Receives the tracks found and statistics
+    @return Zero on success, or -1 on failure (see #tc_last_error) */
+int tc_run(const tc_params_t *params, const double *frames, int64_t frame_cnt,
+    int channels, int samplerate, double *envelope, tc_result_t *result);
+
+/** Frees the memory held by @a result. */
+void tc_free_result(tc_result_t *result);
+
+/** Returns a description of why the last failed #tc_run failed. */
+const char *tc_last_error(void);
+
+#endif /* LIBTRACKCUTTER_H */
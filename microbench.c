@@ -0,0 +1,552 @@
+/*  microbench: Micro-benchmarks for trackcutter's per-frame processing
+    Copyright (C) 2026 agent <agent@local>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or (at
+    your option) any later version.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+/** @file microbench.c
+
+    Times the per-frame primitives of trackcutter in isolation, on
+    synthetic buffers, for a range of channel counts and sampling rates.
+    This gives any future optimisation of these functions a baseline to
+    beat.
+
+    trackcutter.c is compiled in directly (with its main() renamed), so
+    the functions being measured are exactly those in the program, with
+    the same inlining opportunities. No audio files are touched; the
+    buffers are set up in the same way as #init_state does, then filled
+    with pseudo-random noise.
+
+    Each kernel is run for a number of warm-up repetitions that are
+    discarded, then for a number of measured repetitions, each over the
+    same count of frames. Minimum, median, mean and standard deviation
+    of the time per frame are reported, along with the median number of
+    timestamp counter ticks per sample (where the CPU has one). Kernels
+    that can't be run without some supporting code (e.g. the buffer
+    pointers must advance for #filter_new_frame to see fresh frames) are
+    reported net of that supporting code, which is timed separately: its
+    median is subtracted from each repetition before the statistics are
+    taken, so the minimum never exceeds the median. */
+
+#define main trackcutter_main
+#include "trackcutter.c"
+#undef main
+
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#   include <x86intrin.h>
+#   define HAVE_TSC 1
+#endif
+
+/** Default number of frames processed per repetition */
+#define MB_DFL_FRAMES 1000000
+/** Default number of measured repetitions */
+#define MB_DFL_REPS 9
+/** Default number of warm-up repetitions */
+#define MB_DFL_WARMUP 2
+/** Maximum number of repetitions */
+#define MB_MAX_REPS 1000
+/** Maximum number of entries in the -c and -s lists */
+#define MB_MAX_LIST 16
+/** Number of frames in the table that #filter_new_frame input is copied from */
+#define MB_SRC_FRAMES 4096
+
+/** Compiler barrier, so loop bodies that only read global state aren't
+    hoisted out of the timing loops. */
+#define MB_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/** Identifies each measured loop */
+typedef enum {
+    MBK_ADVANCE,            /**< advance_buf_ptrs() */
+    MBK_ADVANCE_REFILL,     /**< advance_buf_ptrs() plus copying in a new frame (harness only) */
+    MBK_FILTER,             /**< filter_new_frame() */
+    MBK_ANALYSE,            /**< analyse_new_frame() */
+    MBK_SIGNAL,             /**< we_have_signal(), with every channel below the noise floor */
+    MBK_CTX_SILENCE,        /**< update_context() while in silence */
+    MBK_CTX_TRACK,          /**< update_context() while inside a track */
+    MBK_CTX_MIXED,          /**< update_context() cycling through every transition */
+    MBK_COUNT
+} mb_kernel_t;
+
+/** Names of kernels, as printed */
+static const char *mb_kernel_t_s[] =
+{
+    "advance_buf_ptrs",
+    NULL,
+    "filter_new_frame",
+    "analyse_new_frame",
+    "we_have_signal",
+    "update_context/silence",
+    "update_context/track",
+    "update_context/mixed"
+};
+
+/** Kernel whose time is subtracted from each kernel's; -1 if none */
+static const int mb_kernel_baseline[] =
+{
+    -1,
+    -1,
+    MBK_ADVANCE_REFILL,
+    MBK_ADVANCE,
+    -1,
+    -1,
+    -1,
+    -1
+};
+
+/** Results of timing one kernel */
+typedef struct {
+    double ns[MB_MAX_REPS];     /**< Time per frame, for each measured repetition */
+    double ticks[MB_MAX_REPS];  /**< Timestamp counter ticks per frame, for each repetition */
+    double min;                 /**< Minimum of @a ns */
+    double median;              /**< Median of @a ns */
+    double mean;                /**< Mean of @a ns */
+    double sd;                  /**< Standard deviation of @a ns */
+    double median_ticks;        /**< Median of @a ticks */
+} mb_result_t;
+
+/** Micro-benchmark command-line options */
+static struct {
+    long frames;                    /**< Frames per repetition */
+    int reps;                       /**< Measured repetitions */
+    int warmup;                     /**< Warm-up repetitions */
+    int channels[MB_MAX_LIST];      /**< Channel counts to test */
+    int channels_cnt;               /**< Number of entries in @a channels */
+    int rates[MB_MAX_LIST];         /**< Sampling rates to test */
+    int rates_cnt;                  /**< Number of entries in @a rates */
+} mb_options;
+
+/** Source of fresh frames for #filter_new_frame */
+static double *mb_src;
+
+/** Per-frame signal decisions driving the mixed update_context() run */
+static unsigned char *mb_schedule;
+
+/** Length of @a mb_schedule, in frames */
+static int mb_schedule_len;
+
+/** Consumes results so the optimiser can't discard the work producing them */
+static volatile double mb_sink;
+
+/** Prints the micro-benchmark help message */
+static void mb_print_help_msg(void)
+{
+    printf("Usage: %s [OPTION...]\n", program_invocation_short_name);
+    printf("Times trackcutter's per-frame processing functions on synthetic buffers.\n");
+    printf("\n");
+    printf("  -n N     Frames processed per repetition. Default is %d.\n", MB_DFL_FRAMES);
+    printf("  -r N     Measured repetitions. Default is %d.\n", MB_DFL_REPS);
+    printf("  -w N     Warm-up repetitions (discarded). Default is %d.\n", MB_DFL_WARMUP);
+    printf("  -c LIST  Comma-separated channel counts. Default is 1,2,6,8.\n");
+    printf("  -s LIST  Comma-separated sampling rates. Default is 44100,48000,96000,192000.\n");
+    printf("  -H       Enable the high-pass filter.\n");
+    printf("  -h       Display this help message and exit.\n");
+}
+
+/** Parses a comma-separated list of positive integers into @a list. */
+static int mb_parse_list(const char *s, int *list, int max)
+{
+    /* n: Number of entries parsed */
+    /* tail: First character not parsed */
+    int n = 0;
+    char *tail;
+
+    do
+    {
+        long x = strtol(s, &tail, 10);
+
+        if(tail == s || x <= 0 || x > INT_MAX || n >= max || (*tail && *tail != ','))
+        {
+            error(EXIT_FAILURE, 0, "Invalid list `%s'", s);
+        }
+        list[n++] = (int)x;
+        s = tail + 1;
+    }
+    while(*tail);
+    return n;
+}
+
+/** Parses command-line arguments into #mb_options and #options */
+static void mb_parse_options(int argc, char **argv)
+{
+    int opt;
+
+    init_options();
+    mb_options.frames = MB_DFL_FRAMES;
+    mb_options.reps = MB_DFL_REPS;
+    mb_options.warmup = MB_DFL_WARMUP;
+    mb_options.channels_cnt = mb_parse_list("1,2,6,8", mb_options.channels, MB_MAX_LIST);
+    mb_options.rates_cnt = mb_parse_list("44100,48000,96000,192000", mb_options.rates, MB_MAX_LIST);
+    while((opt = getopt(argc, argv, "hn:r:w:c:s:H")) >= 0)
+    {
+        switch(opt)
+        {
+            case 'h':
+                mb_print_help_msg();
+                exit(EXIT_SUCCESS);
+            case 'n':
+                mb_options.frames = atol(optarg);
+                break;
+            case 'r':
+                mb_options.reps = atoi(optarg);
+                break;
+            case 'w':
+                mb_options.warmup = atoi(optarg);
+                break;
+            case 'c':
+                mb_options.channels_cnt = mb_parse_list(optarg, mb_options.channels, MB_MAX_LIST);
+                break;
+            case 's':
+                mb_options.rates_cnt = mb_parse_list(optarg, mb_options.rates, MB_MAX_LIST);
+                break;
+            case 'H':
+                options.high_pass_filter_enabled = TRUE;
+                break;
+            default:
+                fprintf(stderr, "Try `%s -h' for more information.\n", program_invocation_short_name);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(mb_options.frames <= 0 || mb_options.reps <= 0 || mb_options.reps > MB_MAX_REPS
+        || mb_options.warmup < 0)
+    {
+        error(EXIT_FAILURE, 0, "Frame and repetition counts must be positive (at most %d repetitions)",
+            MB_MAX_REPS);
+    }
+    for(opt = 0; opt < mb_options.channels_cnt; opt++)
+    {
+        if(mb_options.channels[opt] > MAX_CHANNELS)
+        {
+            error(EXIT_FAILURE, 0, "At most %d channels are supported", MAX_CHANNELS);
+        }
+    }
+}
+
+/** Returns a pseudo-random number in [-1, 1), from a deterministic generator. */
+static double mb_rnd(void)
+{
+    static uint32_t x = 2463534242U;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return (double)x / 2147483648.0 - 1.0;
+}
+
+/** Sets up #state for the given format, as #init_state does for an
+    input file, with the buffers filled with noise at around -20dBFS. */
+static void mb_init_state(int samplerate, int numchannels)
+{
+    /* i: Sample index */
+    int i;
+
+    free(state.sq_buf);
+    free(state.main_buf);
+    memset(&state, 0, sizeof(state));
+    state.cut.track_num = 1;
+    state.samplerate = samplerate;
+    state.numchannels = numchannels;
+    state.frame_sz = sizeof(double) * numchannels;
+    state.frames_remaining = SF_COUNT_MAX;
+    state.rms_window_len = state.samplerate * RMS_WINDOW_PERIOD / 1000;
+    state.sq_buf = calloc(state.rms_window_len, state.frame_sz);
+    state.sq_buf_edge = state.sq_buf + state.rms_window_len * state.numchannels;
+    state.sq_buf_cen = state.sq_buf + (state.rms_window_len / 2) * state.numchannels;
+    state.main_buf = calloc(state.rms_window_len, state.frame_sz);
+    state.main_buf_edge = state.main_buf + state.rms_window_len * state.numchannels;
+    state.main_buf_cen = state.main_buf + (state.rms_window_len / 2) * state.numchannels;
+    if(!state.sq_buf || !state.main_buf)
+    {
+        error(EXIT_FAILURE, errno, "Unable to allocate buffers");
+    }
+    state.alpha = HIGH_PASS_TAU / (HIGH_PASS_TAU + 1.0 / (double)state.samplerate);
+    for(i = 0; i < state.rms_window_len * state.numchannels; i++)
+    {
+        state.main_buf[i] = 0.1 * mb_rnd();
+        state.sq_buf[i] = state.main_buf[i] * state.main_buf[i];
+        state.x_sq_ttl[i % numchannels] += state.sq_buf[i];
+    }
+    state.main_buf_head = state.main_buf_edge - state.numchannels;
+    state.main_buf_tail = state.main_buf;
+    state.sq_buf_head = state.sq_buf_edge - state.numchannels;
+    state.sq_buf_tail = state.sq_buf;
+    init_analysis();
+    init_detector();
+    state.cut.context = CCTX_SILENCE;
+}
+
+/** Builds #mb_schedule: a repeating pattern of a false positive, a
+    track with a brief dropout, and a gap, so that the mixed run passes
+    through every update_context() transition once per cycle. The
+    minimum periods in #state are shrunk to suit. */
+static void mb_build_schedule(void)
+{
+    /* pattern: Alternating run lengths (silence first), in frames */
+    static const int pattern[] = { 200, 5, 100, 400, 20, 300, 200 };
+    int i;
+    int j;
+    int k = 0;
+
+    mb_schedule_len = 0;
+    for(i = 0; i < (int)(sizeof(pattern) / sizeof(pattern[0])); i++)
+    {
+        mb_schedule_len += pattern[i];
+    }
+    free(mb_schedule);
+    mb_schedule = malloc(mb_schedule_len);
+    for(i = 0; i < (int)(sizeof(pattern) / sizeof(pattern[0])); i++)
+    {
+        for(j = 0; j < pattern[i]; j++)
+        {
+            mb_schedule[k++] = i & 1;
+        }
+    }
+    state.min_signal_len = 10;
+    state.min_silence_len = 100;
+    state.min_track_len = 200;
+}
+
+/** Runs kernel @a k over @a n frames. */
+static void mb_run_kernel(mb_kernel_t k, long n)
+{
+    /* i: Frame counter */
+    /* src: Next frame of #mb_src to copy in */
+    /* acc: Accumulates results of pure functions */
+    /* loud: Sum of squares that is above the noise floor */
+    long i;
+    int src = 0;
+    int acc = 0;
+    double loud = state.n_x_nf_sq * 4.0;
+
+    switch(k)
+    {
+        case MBK_ADVANCE:
+            for(i = 0; i < n; i++)
+            {
+                advance_buf_ptrs();
+                MB_BARRIER();
+            }
+            break;
+        case MBK_ADVANCE_REFILL:
+        case MBK_FILTER:
+            for(i = 0; i < n; i++)
+            {
+                advance_buf_ptrs();
+                memcpy(state.main_buf_head, mb_src + src * state.numchannels, state.frame_sz);
+                src = (src + 1) % MB_SRC_FRAMES;
+                if(k == MBK_FILTER)
+                {
+                    filter_new_frame();
+                }
+                MB_BARRIER();
+            }
+            break;
+        case MBK_ANALYSE:
+            for(i = 0; i < n; i++)
+            {
+                advance_buf_ptrs();
+                analyse_new_frame();
+                MB_BARRIER();
+            }
+            break;
+        case MBK_SIGNAL:
+            for(i = 0; i < n; i++)
+            {
+                acc += we_have_signal();
+                MB_BARRIER();
+            }
+            break;
+        case MBK_CTX_SILENCE:
+        case MBK_CTX_TRACK:
+            state.cut.context = (k == MBK_CTX_TRACK) ? CCTX_TRACK : CCTX_SILENCE;
+            state.cut.track_start = state.cur_frame_pos;
+            for(i = 0; i < n; i++)
+            {
+                update_context();
+                state.cur_frame_pos++;
+                MB_BARRIER();
+            }
+            break;
+        case MBK_CTX_MIXED:
+            for(i = 0; i < n; i++)
+            {
+                /* j: Channel being set */
+                int j;
+
+                for(j = 0; j < state.numchannels; j++)
+                {
+                    state.x_sq_ttl[j] = mb_schedule[src] ? loud : 0.0;
+                }
+                src = (src + 1 == mb_schedule_len) ? 0 : src + 1;
+                update_context();
+                state.cur_frame_pos++;
+                MB_BARRIER();
+            }
+            break;
+        default:
+            break;
+    }
+    mb_sink = acc + state.x_sq_ttl[0] + state.cur_rms[0];
+}
+
+/** Comparison function for qsort(), for sorting doubles in ascending order */
+static int mb_compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/** Returns the median of @a n values in @a x (which is sorted in place) */
+static double mb_median(double *x, int n)
+{
+    qsort(x, n, sizeof(double), mb_compare_doubles);
+    return (n & 1) ? x[n / 2] : 0.5 * (x[n / 2 - 1] + x[n / 2]);
+}
+
+/** Times kernel @a k with warm-up, storing statistics in @a res. If
+    @a base isn't @c NULL, the statistics are net of the median times in
+    it, which are subtracted from each repetition. */
+static void mb_time_kernel(mb_kernel_t k, mb_result_t *res, const mb_result_t *base)
+{
+    /* t0, t1: Wall-clock time before and after each repetition */
+    /* c0, c1: Timestamp counter before and after each repetition */
+    /* sorted: Copy of res->ns for taking the median */
+    struct timespec t0, t1;
+    uint64_t c0 = 0, c1 = 0;
+    double sorted[MB_MAX_REPS];
+    double ss = 0.0;
+    int r;
+
+    /* In the context runs, every channel is below the noise floor, so
+       we_have_signal() scans them all; the mixed run sets its own levels. */
+    for(r = 0; r < state.numchannels; r++)
+    {
+        state.x_sq_ttl[r] = (k == MBK_CTX_TRACK) ? state.n_x_nf_sq * 4.0 : 0.0;
+    }
+    if(k == MBK_SIGNAL)
+    {
+        memset(state.x_sq_ttl, 0, sizeof(state.x_sq_ttl));
+    }
+    for(r = 0; r < mb_options.warmup; r++)
+    {
+        mb_run_kernel(k, mb_options.frames);
+    }
+    res->mean = 0.0;
+    for(r = 0; r < mb_options.reps; r++)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+#ifdef HAVE_TSC
+        c0 = __rdtsc();
+#endif
+        mb_run_kernel(k, mb_options.frames);
+#ifdef HAVE_TSC
+        c1 = __rdtsc();
+#endif
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        res->ns[r] = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / mb_options.frames;
+        res->ticks[r] = (double)(c1 - c0) / mb_options.frames;
+        if(base)
+        {
+            res->ns[r] -= base->median;
+            res->ticks[r] -= base->median_ticks;
+        }
+        res->mean += res->ns[r];
+    }
+    res->mean /= mb_options.reps;
+    for(r = 0; r < mb_options.reps; r++)
+    {
+        ss += (res->ns[r] - res->mean) * (res->ns[r] - res->mean);
+        sorted[r] = res->ns[r];
+    }
+    res->sd = (mb_options.reps > 1) ? sqrt(ss / (mb_options.reps - 1)) : 0.0;
+    res->median = mb_median(sorted, mb_options.reps);
+    res->min = sorted[0];
+    res->median_ticks = mb_median(res->ticks, mb_options.reps);
+}
+
+int main(int argc, char **argv)
+{
+    /* results: Timings of each kernel for the current format */
+    /* ri, ci: Current index into rate and channel lists */
+    static mb_result_t results[MBK_COUNT];
+    int ri;
+    int ci;
+    int i;
+    int k;
+
+    mb_parse_options(argc, argv);
+    mb_src = malloc(sizeof(double) * MB_SRC_FRAMES * MAX_CHANNELS);
+    for(i = 0; i < MB_SRC_FRAMES * MAX_CHANNELS; i++)
+    {
+        mb_src[i] = 0.1 * mb_rnd();
+    }
+
+    printf("# %ld frames x %d repetitions (+%d warm-up); high-pass filter %s\n",
+        mb_options.frames, mb_options.reps, mb_options.warmup,
+        options.high_pass_filter_enabled ? "on" : "off");
+    printf("%-24s  %6s  %2s  %10s  %10s  %10s  %8s  %12s\n", "kernel", "rate", "ch",
+        "min_ns/fr", "median", "mean", "sd", "ticks/sample");
+    for(ri = 0; ri < mb_options.rates_cnt; ri++)
+    {
+        for(ci = 0; ci < mb_options.channels_cnt; ci++)
+        {
+            /* cuts_file: Sink for cut points found in update_context() runs */
+            FILE *cuts_file;
+
+            mb_init_state(mb_options.rates[ri], mb_options.channels[ci]);
+            if(!(cuts_file = fopen("/dev/null", "w")))
+            {
+                error(EXIT_FAILURE, errno, "Unable to open `/dev/null'");
+            }
+            for(k = 0; k < MBK_COUNT; k++)
+            {
+                if(k == MBK_CTX_SILENCE)
+                {
+                    /* Restore the pristine cutting state for the context runs */
+                    mb_init_state(mb_options.rates[ri], mb_options.channels[ci]);
+                    state.cuts_file = cuts_file;
+                }
+                else if(k == MBK_CTX_MIXED)
+                {
+                    mb_build_schedule();
+                    state.cut.context = CCTX_SILENCE;
+                }
+                mb_time_kernel(k, &results[k],
+                    (mb_kernel_baseline[k] >= 0) ? &results[mb_kernel_baseline[k]] : NULL);
+            }
+            state.cuts_file = NULL;
+            fclose(cuts_file);
+
+            for(k = 0; k < MBK_COUNT; k++)
+            {
+                /* r: Result being printed, already net of its baseline */
+                mb_result_t *r = &results[k];
+
+                if(!mb_kernel_t_s[k])
+                {
+                    continue;
+                }
+                printf("%-24s  %6d  %2d  %10.3f  %10.3f  %10.3f  %8.3f  ",
+                    mb_kernel_t_s[k], state.samplerate, state.numchannels,
+                    r->min, r->median, r->mean, r->sd);
+#ifdef HAVE_TSC
+                printf("%12.3f\n", r->median_ticks / state.numchannels);
+#else
+                printf("%12s\n", "-");
+#endif
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
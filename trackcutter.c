@@ -50,6 +50,18 @@
 #include <math.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#   include <sys/syscall.h>
+#   include <linux/perf_event.h>
+#endif
 
 /** Definition for boolean constant @e false */
 #define FALSE 0
@@ -70,19 +82,142 @@
 #define DFL_MIN_TRACK_LENGTH 40
 /** Default signal-to-noise ratio used to discriminate non-silence from silence (in dBFS) */
 #define DFL_NOISE_FLOOR -48.0
-
-/** Corner frequency for high-pass filter in Hz */
+/** Default length of the window --adaptive-floor takes the least energy
+    over (in seconds); long enough to take in a gap between songs */
+#define DFL_FLOOR_WINDOW 240
+/** Number of sub-windows the --adaptive-floor window is divided into.
+    The least energy of each is kept, so the window moves on one
+    sub-window at a time. */
+#define FLOOR_SUBWIN_CNT 8
+/** Lowest level the --adaptive-floor tracker lets the noise floor fall to
+    (in dBFS), so that passages of digital silence don't leave dither
+    counting as signal */
+#define FLOOR_MIN_DBFS -96.0
+
+/** Number of frames in a CD frame (1/75 second at 44.1kHz), which
+    --cd-frames pads track files out to a multiple of */
+#define CD_FRAME_LEN 588
+
+/** Default corner frequency for high-pass filter in Hz */
 #define HIGH_PASS_CORNER_FREQ 20.0
-/** Time constant for high-pass filter */
+/** Time constant for high-pass filter at the default corner frequency */
 #define HIGH_PASS_TAU (1.0 / (2.0 * M_PI * HIGH_PASS_CORNER_FREQ))
 
+/** Scale of the fixed-point sums of samples that the DC offset is
+    estimated from: 2^23 steps to full scale. Integer sums come out the
+    same whatever order or stretches of the recording they're added up
+    in, so --merge gives exactly the figure a single pass would, however
+    many shards there are. Rounding each sample to the step bounds the
+    error of the estimate at 2^-24 of full scale (PCM of up to 24 bits is
+    summed exactly, bar --dc-offset). Samples are within [-2.0, +2.0]
+    after --dc-offset correction unless they're floating point and over
+    full scale, so each adds at most 2^24 to the sum, which then can't
+    overflow within 2^39 frames: over 130 days at 48kHz. */
+#define DC_ACC_SCALE 8388608.0
+
+/** Period (in milliseconds) of the moving average that
+    `--output-filter=dc' takes away from each frame, centred on it */
+#define OUTPUT_DC_WINDOW_PERIOD 1000
+
 /** Length of a timecode string buffer, in characters (incl. terminator) */
 #define TIMECODE_STR_SZ 20
 
+/** Period (in milliseconds) of audio that each shard processes ahead of
+    its own slice, so the high-pass filter and RMS window have settled by
+    the time the slice begins. The HPF transient decays by a factor of
+    e^-125 per second, well below double precision. */
+#define SHARD_PREROLL_PERIOD 1000
+/** Version number written into, and expected from, shard partial-state files */
+#define SHARD_FILE_VERSION 3
+/** Length of a line buffer used when parsing shard partial-state files */
+#define SHARD_LINE_SZ 1024
+/** Length of a line buffer used when reading the --exempt file */
+#define EXEMPT_LINE_SZ 256
+
+/** With --profile, the per-frame stages are only timed on one in this
+    many frames (a power of two), and their totals scaled up, to keep
+    the cost of reading the clock down. */
+#define PROFILE_SAMPLE_PERIOD 64
+/** With --profile, number of track latencies there's room for at the
+    start, so that recording them needn't allocate in the main loop */
+#define PROFILE_TRACK_LATENCY_LEN 1024
+
+/** Number of events kept by --trace (a power of two); once the ring is
+    full, the oldest events are overwritten. */
+#define TRACE_RING_LEN 65536
+/** Version number written into --energy-map files */
+#define ENERGY_MAP_VERSION 1
+/** Magic number at the start of --decision-trace files */
+#define DECISION_TRACE_MAGIC "TCDT"
+/** Version number written into --decision-trace files */
+#define DECISION_TRACE_VERSION 1
+/** Size of the header of --decision-trace files, in bytes */
+#define DECISION_TRACE_HDR_SZ 32
+/** Size of the stdio buffer that --decision-trace records are gathered
+    in, so they're written a few thousand at a time */
+#define DECISION_TRACE_BUF_SZ 65536
+/** Fewest events --trace may keep when planning within --memory-limit */
+#define TRACE_MIN_RING_LEN 1024
+/** Frames are filtered one at a time, so --trace records them
+    as one span per this many frames. */
+#define TRACE_BLOCK_LEN 4096
+
+/** Room made for output file names at the start; longer track names
+    enlarge it */
+#define OUT_FILE_NAME_BUF_SZ 256
+
+/** Room made for output file headers at the start (see #out_io_t);
+    larger headers enlarge it */
+#define OUT_IO_HDR_BUF_SZ 4096
+
+/** Room made for staging track files in memory (tar output only) once
+    the first is written; a longer track file at least doubles it */
+#define OUT_IO_MEM_SZ (1 << 20)
+
+/** Alignment of each buffer carved out of the arena (see #init_arena),
+    in bytes: a cache line, so no two buffers share one. */
+#define ARENA_ALIGN 64
+/** Size of a huge page, in bytes, which large arenas are aligned to */
+#define HUGE_PAGE_SZ (2 * 1024 * 1024)
+
+/** Number of frames between checks for whether a progress report is due */
+#define PROGRESS_CHECK_LEN 16384
+/** With --progress, interval between reports (in ms) when they're redrawn on a terminal */
+#define PROGRESS_TTY_PERIOD 1000
+/** With --progress, interval between reports (in ms) when they're printed as lines */
+#define PROGRESS_LOG_PERIOD 30000
+
+/** Default number of frames read from the input file at a time, if
+    there's no wisdom file (see --tune) */
+#define DFL_READ_BLOCK_LEN 1024
+/** Default number of frames written to a track file at a time, if
+    there's no wisdom file */
+#define DFL_WRITE_BLOCK_LEN 1024
+/** Largest block length accepted from a wisdom file, in frames */
+#define MAX_BLOCK_LEN 65536
+/** Name of the wisdom file written by --tune, in the home directory */
+#define WISDOM_FILE_NAME ".trackcutter-wisdom"
+/** Version number written into, and expected from, wisdom files */
+#define WISDOM_FILE_VERSION 1
+/** Length of a line buffer used when parsing wisdom files */
+#define WISDOM_LINE_SZ 256
+/** Length of the synthetic recording that --tune times (in seconds) */
+#define TUNE_PERIOD 30
+/** Sampling rate of the synthetic recording used by --tune (in Hz) */
+#define TUNE_SAMPLERATE 44100
+/** Number of channels in the synthetic recording used by --tune */
+#define TUNE_CHANNELS 2
+/** Number of times --tune times each block length; the best is taken */
+#define TUNE_REPEAT 3
+/** --tune picks the shortest block length that comes within this
+    proportion of the fastest, as longer blocks only cost memory */
+#define TUNE_TOLERANCE 0.05
+
 /** Main task descriptor */
 typedef enum {
     TCT_CUTTING,         /**< Default mode, cutting up a recording. */
-    TCT_ANALYSIS         /**< Analysis mode, print maximum/minimum amplitude. */
+    TCT_ANALYSIS,        /**< Analysis mode, print maximum/minimum amplitude. */
+    TCT_MERGE            /**< Merge partial-state files written by shard runs. */
 } tc_task_t;
 
 /** Current mode with respect to cutting the audio recording */
@@ -93,6 +228,27 @@ typedef enum {
     CCTX_TRACK_ENDING     /**< We suspect the current track may be ending */
 } cut_context_t;
 
+/** Track-cutting state of one stream of audio: the recording, or one
+    input file in --batch mode. Stepped a frame at a time by
+    #step_cut_context. */
+typedef struct {
+    cut_context_t context;      /**< Current track-cutting context state */
+    sf_count_t time_to_live;    /**< Time-to-live for current state, in frames (when relevant) */
+    sf_count_t track_start;     /**< Current track starting frame index */
+    int track_num;              /**< Current track number */
+} cut_stream_t;
+
+/** What #step_cut_context made of the current frame of a stream */
+typedef enum {
+    CEV_GAP,              /**< The frame is in the gap between tracks */
+    CEV_SIGNAL,           /**< Signal in the gap; the frame may start a track, so hold it back */
+    CEV_LEADIN,           /**< The signal goes on; hold this frame back too */
+    CEV_FALSE_START,      /**< The frames held back, and this one, were part of the gap after all */
+    CEV_TRACK_START,      /**< A track starts with the frames held back; this frame is in it */
+    CEV_TRACK,            /**< The frame is in the current track */
+    CEV_TRACK_END         /**< The frame is the last of the current track */
+} cut_event_t;
+
 /** Action to take when encountering new tracks */
 typedef enum {
     CPA_LOG_POINT,      /**< Write to a cut point file */
@@ -106,6 +262,121 @@ typedef enum {
     CPF_SEC_INDEX      /**< Absolute number of seconds */
 } cut_point_format_t;
 
+/** Processing of the audio written to track files (--output-filter) */
+typedef enum {
+    OFM_SAME,          /**< As the detector sees it (--dc-offset and --high-pass) */
+    OFM_NONE,          /**< Unaltered from the input */
+    OFM_DC             /**< Less a centred moving average, removing DC offset */
+} output_filter_t;
+
+/** Codes returned by @c getopt_long() for options that have no short form */
+typedef enum {
+    LOPT_SHARD = 0x100,       /**< --shard */
+    LOPT_MERGE,               /**< --merge */
+    LOPT_MANIFEST,            /**< --manifest */
+    LOPT_COPY_FRAMES,         /**< --copy-frames */
+    LOPT_BATCH,               /**< --batch */
+    LOPT_PROFILE,             /**< --profile */
+    LOPT_PROFILE_COUNTERS,    /**< --profile-counters */
+    LOPT_TRACE,               /**< --trace */
+    LOPT_PROGRESS,            /**< --progress */
+    LOPT_METRICS,             /**< --metrics */
+    LOPT_TUNE,                /**< --tune */
+    LOPT_WISDOM,              /**< --wisdom */
+    LOPT_MEMORY_LIMIT,        /**< --memory-limit */
+    LOPT_PRE_GAP,             /**< --pre-gap */
+    LOPT_POST_GAP,            /**< --post-gap */
+    LOPT_CD_FRAMES,           /**< --cd-frames */
+    LOPT_EXEMPT,              /**< --exempt */
+    LOPT_ADAPTIVE_FLOOR,      /**< --adaptive-floor */
+    LOPT_FLOOR_WINDOW,        /**< --floor-window */
+    LOPT_ENERGY_MAP,          /**< --energy-map */
+    LOPT_OUTPUT_FILTER,       /**< --output-filter */
+    LOPT_HIGH_PASS_CORNER,    /**< --high-pass-corner */
+    LOPT_DECISION_TRACE       /**< --decision-trace */
+} long_only_opt_t;
+
+/** Processing stages timed by --profile */
+typedef enum {
+    PST_DECODE,         /**< Reading blocks of frames from libsndfile (exact) */
+    PST_FILTER,         /**< DC correction, high-pass filter and RMS window (sampled) */
+    PST_DETECT,         /**< Cutting state machine, or analysis statistics (sampled) */
+    PST_WRITE,          /**< Writing blocks of frames to the current track file (exact) */
+    PST_TRACK_OPEN,     /**< Starting a track, incl. flushing the lead-in buffer (exact) */
+    PST_TRACK_CLOSE,    /**< Finishing a track (exact) */
+    PST_COUNT
+} prof_stage_t;
+
+/** Hardware events counted by --profile-counters */
+typedef enum {
+    PCT_CYCLES,         /**< CPU cycles */
+    PCT_INSTRUCTIONS,   /**< Instructions retired */
+    PCT_CACHE_MISSES,   /**< Last-level cache misses */
+    PCT_BRANCH_MISSES,  /**< Mispredicted branches */
+    PCT_COUNT
+} perf_counter_t;
+
+/** Compressed input containers that can be cut without re-encoding (--copy-frames) */
+typedef enum {
+    CCF_MPEG,           /**< MPEG-1/2/2.5 Layer III elementary stream */
+    CCF_OGG_VORBIS      /**< Ogg Vorbis, single logical bitstream */
+} copy_container_t;
+
+/** One indivisible unit of compressed input: an MPEG audio frame, or an Ogg page */
+typedef struct {
+    sf_count_t ofs;             /**< Byte offset in input file */
+    int len;                    /**< Length in bytes */
+    /** Decoded frame index at which the audio of this unit ends. For Ogg
+        pages, this is the granule position (carried over from the
+        previous page if no packet ends on this one). */
+    sf_count_t end_frame_idx;
+    /** MP3: number of bytes of main data borrowed from preceding frames
+        (main_data_begin). Ogg: non-zero if the page begins part-way
+        through a packet. */
+    int borrowed;
+    int main_data_len;          /**< MP3: number of bytes of main data carried by this frame */
+} codec_unit_t;
+
+/** MD5 message digest context (RFC 1321) */
+typedef struct {
+    uint32_t h[4];              /**< Intermediate hash value */
+    uint64_t len;               /**< Number of bytes digested so far */
+    unsigned char blk[64];      /**< Partial block awaiting digestion */
+} md5_ctx_t;
+
+/** Length of an MD5 digest string buffer, in characters (incl. terminator) */
+#define MD5_STR_SZ 33
+
+/** Output file I/O state, used through libsndfile's virtual I/O
+    interface when a manifest is requested (so that the CRC-32 of each
+    encoded file can be computed as it is written), or when tracks are
+    streamed as a tar archive (so that each file can be staged in memory
+    until its size is known).
+
+    libsndfile writes a header when the file is opened, appends the
+    audio data, and then patches the header on closing. Bytes within the
+    header are therefore held back in @a hdr_buf and only digested at
+    close, while bytes appended after it are digested straight away; the
+    two CRCs are then combined. Should the encoder ever rewrite data
+    that has already been digested, the file is simply re-read at close. */
+typedef struct {
+    int fd;                     /**< File descriptor of the output file; negative if staged in @a mem */
+    unsigned char *mem;         /**< Staging buffer holding the output file (tar output only) */
+    sf_count_t mem_sz;          /**< malloc() allocation size of @a mem */
+    sf_count_t pos;             /**< Current file position */
+    sf_count_t len;             /**< Current file length */
+    int hdr_sealed;             /**< Set once sf_open_virtual() has returned */
+    unsigned char *hdr_buf;     /**< Copy of header bytes written before @a hdr_sealed was set */
+    sf_count_t hdr_len;         /**< Number of bytes in @a hdr_buf */
+    sf_count_t hdr_buf_sz;      /**< malloc() allocation size of @a hdr_buf */
+    /** Most bytes that may be staged in @a mem (tar output only); a file
+        that grows beyond this is moved to a temporary file */
+    sf_count_t mem_max;
+    sf_count_t digest_end;      /**< Bytes [@a hdr_len, @a digest_end) have been folded into @a crc */
+    uint32_t crc;               /**< CRC-32 of the bytes after the header written so far */
+    int digest_valid;           /**< Cleared if already-digested bytes are overwritten */
+} out_io_t;
+
 /** File extension-format mapping */
 typedef struct {
     int sf_format;      /**< sndfile format code (0 for terminating entry) */
@@ -113,6 +384,202 @@ typedef struct {
     const char *desc;   /**< brief description */
 } file_format_t;
 
+/** Partial-state file written by a shard run, as read back by --merge */
+typedef struct {
+    const char *file_name;      /**< Name of the file (for error messages) */
+    FILE *file;                 /**< File handle; positioned after the header once parsed */
+    int shard_idx;              /**< Shard number, counting from 1 */
+    int shard_cnt;              /**< Total number of shards */
+    tc_task_t task;             /**< Task the shard was run in (cutting or analysis) */
+    int samplerate;             /**< Sampling rate of the recording in Hz */
+    int numchannels;            /**< Number of channels in the recording */
+    sf_count_t start_frame_idx; /**< Frame range given to the shard run (start) */
+    sf_count_t end_frame_idx;   /**< Frame range given to the shard run (end) */
+    int min_signal_len;         /**< Minimum signal period of the shard run, in frames */
+    int min_silence_len;        /**< Minimum silence period of the shard run, in frames */
+    int min_track_len;          /**< Minimum track length of the shard run, in frames */
+    sf_count_t slice_start;     /**< First frame index covered by the shard */
+} shard_file_t;
+
+/** Window of the recording exempted from silence detection (--exempt) */
+typedef struct {
+    sf_count_t start;           /**< First frame of window */
+    sf_count_t end;             /**< Frame just past the end of window */
+} exempt_win_t;
+
+/** Decoder delay of MPEG Layer III, in frames; added to the encoder
+    delay given in a LAME tag to find where gapless decoding begins */
+#define MPEG_DECODER_DELAY 529
+
+/** How far into an MP3 file (after any ID3 tag) to look for the first
+    frame before concluding it isn't one, in bytes */
+#define MPEG_SYNC_SEARCH_LEN 65536
+
+/** Largest possible size of an Ogg page, in bytes */
+#define OGG_MAX_PAGE_SZ (27 + 255 + 255 * 255)
+
+/** Size of a tar archive block, in bytes */
+#define TAR_BLOCK_SZ 512
+
+/** Header block of a tar archive member, in POSIX ustar format. All
+    numeric fields are octal ASCII strings. */
+typedef struct {
+    char name[100];             /**< Member name */
+    char mode[8];               /**< Permission bits */
+    char uid[8];                /**< Owner user ID */
+    char gid[8];                /**< Owner group ID */
+    char size[12];              /**< Member size in bytes */
+    char mtime[12];             /**< Modification time, in seconds since the epoch */
+    char chksum[8];             /**< Sum of header bytes, taking this field as spaces */
+    char typeflag;              /**< Member type ('0' regular file, 'x' extended header) */
+    char linkname[100];         /**< Link target (unused) */
+    char magic[6];              /**< "ustar" */
+    char version[2];            /**< "00" */
+    char uname[32];             /**< Owner user name */
+    char gname[32];             /**< Owner group name */
+    char devmajor[8];           /**< Device major number (unused) */
+    char devminor[8];           /**< Device minor number (unused) */
+    char prefix[155];           /**< Leading directory components of @a name */
+    char pad[12];               /**< Pads header out to #TAR_BLOCK_SZ */
+} tar_header_t;
+
+/** Size of the read buffer for each input file in --batch mode, in frames */
+#define LANE_RD_BUF_LEN 4096
+
+/** Per-file state in --batch mode. Each mono input file is carried in
+    one channel ("lane") of the engine, so the filter and RMS arrays in
+    #state_t serve as per-file state as they stand; what's kept here is
+    the input and cutting state that #state_t only holds one of. */
+typedef struct {
+    const char *file_name;      /**< Input file name */
+    SNDFILE *file;              /**< Input file */
+    double *rd_buf;             /**< Read buffer of #LANE_RD_BUF_LEN samples */
+    int rd_pos;                 /**< Next sample to be taken from @a rd_buf */
+    int rd_len;                 /**< Number of samples in @a rd_buf */
+    int in_eof;                 /**< Set once EOF is reached on the input file */
+    sf_count_t frames_remaining;/**< Number of frames remaining yet to be processed */
+    int active;                 /**< Cleared once this file has been fully processed */
+    cut_stream_t cut;           /**< Track-cutting state of this file */
+    FILE *cuts;                 /**< Cut points found so far, held until the end (open_memstream()) */
+    char *cuts_buf;             /**< Buffer behind @a cuts */
+    size_t cuts_buf_sz;         /**< Size of @a cuts_buf */
+} lane_t;
+
+/** Timings and counters collected with --profile */
+typedef struct {
+    int64_t start_ns;           /**< Clock reading when processing began */
+    int64_t clock_ns;           /**< Cost of reading the clock, taken out of each timed stage */
+    int64_t loop_ns;            /**< Time spent in the main loop (exact) */
+    int64_t stage_ns[PST_COUNT];/**< Time spent in each stage (on sampled frames only, if sampled) */
+    int64_t nested_ns;          /**< Time of nested stages within the detection stage of this frame */
+    int sampled;                /**< Set while the current frame is being timed */
+    int event_sampled;          /**< Value of @a sampled before the event in progress */
+    int in_event;               /**< Set while an exactly-timed event is in progress */
+    sf_count_t frames;          /**< Number of frames processed */
+    sf_count_t sampled_frames;  /**< Number of frames that were timed */
+    sf_count_t out_bytes;       /**< Number of bytes in the track files closed so far */
+    int tracks;                 /**< Number of tracks completed */
+    int false_positives;        /**< Number of track starts abandoned as glitches */
+    sf_count_t in_file_bytes;   /**< Size of the input file; zero if not a regular file */
+    int64_t track_start_ns;     /**< Clock reading when the current track's first frame was seen */
+    double *track_latency;      /**< Seconds from the first frame of each track to its completion */
+    int track_latency_alloc;    /**< Allocated number of entries in @a track_latency */
+
+    /* The following are only used with --profile-counters. */
+    int perf_fd;                /**< Group leader of the hardware counters (if @a perf_cnt is non-zero) */
+    int perf_cnt;               /**< Number of counters in the group; zero if none could be opened */
+    perf_counter_t perf_kind[PCT_COUNT];        /**< Event counted by each member of the group, in order */
+    int64_t perf_outer_ns[PST_COUNT];           /**< Clock readings before the counters were read, for each stage in progress */
+    uint64_t perf_probe[PCT_COUNT];             /**< Events counted by the act of reading the counters */
+    uint64_t perf_begin[PST_COUNT][PCT_COUNT];  /**< Counter readings at the start of each stage in progress */
+    uint64_t perf_nested[PCT_COUNT];            /**< Events in nested stages within the detection stage of this frame */
+    uint64_t stage_ctr[PST_COUNT][PCT_COUNT];   /**< Events counted in each stage */
+    uint64_t perf_start[PCT_COUNT];             /**< Counter readings when processing began */
+    int perf_multiplexed;       /**< Set if the kernel had to time-share the counters with others */
+    unsigned long loop_allocs;  /**< Number of heap allocations made within the main loop */
+} profile_t;
+
+/** Figures worked out from #profile_t at the end of a run, for the
+    --profile report and --metrics */
+typedef struct {
+    double stage_ns[PST_COUNT]; /**< Estimated time spent in each stage */
+    double other_ns;            /**< Time in the main loop not accounted for by any stage */
+    double setup_ns;            /**< Time outside the main loop */
+    double total_ns;            /**< Wall-clock time since start of processing */
+    double scale;               /**< Ratio of frames processed to frames sampled */
+    double in_bytes;            /**< Bytes of input consumed (estimated pro rata from file size) */
+    long peak_rss_kib;          /**< Peak resident set size, in KiB */
+} prof_summary_t;
+
+/** One event recorded by --trace */
+typedef struct {
+    const char *name;           /**< Name of event (a string literal) */
+    const char *cat;            /**< Category of event (a string literal) */
+    char ph;                    /**< Trace-event phase: 'X' for a span, 'i' for an instant */
+    int64_t ts_ns;              /**< Clock reading at start of event */
+    int64_t dur_ns;             /**< Duration of event (spans only) */
+    sf_count_t frame;           /**< Frame index at start of event */
+    const char *arg_name;       /**< Name of additional argument; NULL if none */
+    int64_t arg;                /**< Value of additional argument */
+    const char *prev;           /**< Previous cut context (context transitions only) */
+} trace_event_t;
+
+/** Timeline recorded with --trace. The program is single-threaded, so
+    there's just the one ring buffer. */
+typedef struct {
+    FILE *file;                 /**< Trace file, opened at start so that it's checked early */
+    trace_event_t *ring;        /**< Ring buffer of @a ring_len events; NULL if not tracing */
+    int ring_len;               /**< Number of events in @a ring (a power of two) */
+    uint64_t cnt;               /**< Number of events recorded, including those overwritten */
+    int64_t start_ns;           /**< Clock reading taken as time zero */
+    int64_t block_ns;           /**< Clock reading at start of current block of frames */
+    sf_count_t block_frame;     /**< Frame index at start of current block */
+    int block_frames;           /**< Number of frames processed in current block */
+} trace_t;
+
+/** Per-hop energy levels being written with --energy-map */
+typedef struct {
+    FILE *file;                 /**< Energy map file; NULL if not writing one */
+    int hop_left;               /**< Frames left in the current hop */
+    double lo;                  /**< Least energy within the current hop so far */
+    double hi;                  /**< Greatest energy within the current hop so far */
+    sf_count_t hop_cnt;         /**< Number of hops written */
+} energy_map_t;
+
+/** Flags in the records of --decision-trace files */
+typedef enum {
+    DTF_SIGNAL = 0x01,          /**< A channel is over the noise floor */
+    DTF_EXEMPT = 0x02,          /**< The frame is within an --exempt window */
+    DTF_CHANGE = 0x04           /**< The cut context changed on this frame */
+} decision_trace_flag_t;
+
+/** Detector state being written with --decision-trace */
+typedef struct {
+    FILE *file;                 /**< Decision trace file; NULL if not writing one */
+    int hop_left;               /**< Frames left until the next hop starts */
+    int rec_sz;                 /**< Size of each record, in bytes */
+    sf_count_t rec_cnt;         /**< Number of records written */
+} decision_trace_t;
+
+/** Single mapping that all the long-lived buffers of a job are carved
+    out of, sized up front by #plan_memory (see #init_arena) */
+typedef struct {
+    unsigned char *base;        /**< Start of arena; NULL if empty */
+    sf_count_t size;            /**< Size of arena, in bytes */
+    sf_count_t used;            /**< Number of bytes handed out so far */
+} arena_t;
+
+/** Progress reporting (--progress, or on SIGUSR1) */
+typedef struct {
+    int countdown;              /**< Frames left until the next check */
+    sf_count_t first_frame;     /**< Frame index where processing began */
+    sf_count_t total_frames;    /**< Number of frames to be processed; zero if unknown */
+    int64_t start_ns;           /**< Clock reading when processing began */
+    int64_t next_ns;            /**< Clock reading when the next report is due (--progress only) */
+    int64_t period_ns;          /**< Interval between reports (--progress only) */
+    int tty;                    /**< Set if standard error is a terminal */
+} progress_t;
+
 /** Command-line argument structure */
 typedef struct
 {
@@ -139,9 +606,16 @@ typedef struct
     /** Directory where extracted tracks are written (@c NULL means not given) */
     const char *track_directory;
 
+    /** Set this flag if extracted tracks are written to standard output
+        as a tar archive (given as --extract-dir=-) */
+    int tar_output;
+
     /** List file containing track names (@c NULL means not specified; use numbers instead.) */
     const char *track_names_file_name;
 
+    /** File listing time ranges exempted from silence detection (@c NULL if not given) */
+    const char *exempt_file_name;
+
     /** Print format for cutting points in cuts file (frame offsets or time indices) */
     cut_point_format_t cut_point_format;
 
@@ -162,6 +636,15 @@ typedef struct
         silence. Given in dBFS; must be negative. */
     float noise_floor_dbfs;
 
+    /** Margin above the least energy seen lately at which the noise
+        floor is set, when it is tracked through the recording rather
+        than fixed (in decibels; zero if not tracking) */
+    double adaptive_floor_margin;
+
+    /** Length of the window the least energy is taken over, when
+        tracking the noise floor (in seconds) */
+    int floor_window;
+
     /** Minimum length for a track; this is used to prevent tracks that
         start off with mostly rests (e.g. a lone high-hat, other
         percussion, staccato notes, musique concrete) from being
@@ -199,6 +682,12 @@ typedef struct
     /** Input audio stream attributes (use for specifying raw audio parameters) */
     SF_INFO in_sfinfo;
 
+    /** Interleaved frames to process in place of an input file (@c NULL
+        if reading a file). Only set through the library interface (see
+        libtrackcutter.c), which also gives the sampling rate, number of
+        channels and number of frames in @a in_sfinfo. */
+    const double *in_mem;
+
     /** Output file format (if set to zero, use input format) */
     int out_sfinfo_format;
 
@@ -208,8 +697,99 @@ typedef struct
     /** High-pass filter option */
     int high_pass_filter_enabled;
 
+    /** Corner frequency of the high-pass filter, in Hz */
+    double high_pass_corner;
+
+    /** Processing of the audio written to track files, which otherwise
+        has the same DC offset correction and high-pass filtering as the
+        detector works on */
+    output_filter_t output_filter;
+
     /** Set this flag to suppress cuts file header */
     int no_cuts_file_header;
+
+    /** Shard number (counting from 1) of this invocation, when @a
+        shard_cnt is non-zero. */
+    int shard_idx;
+
+    /** Number of shards the input recording is divided into; zero if
+        shard mode is not in use. */
+    int shard_cnt;
+
+    /** Partial-state file names given to --merge (points into @a argv) */
+    char **merge_file_names;
+
+    /** Number of entries in @a merge_file_names */
+    int merge_file_cnt;
+
+    /** Checksum manifest file name, for extraction mode (@c NULL if not requested) */
+    const char *manifest_file_name;
+
+    /** Set this flag to extract tracks by copying compressed frames from
+        the input file verbatim, rather than re-encoding them */
+    int copy_frames;
+
+    /** Length of the gap put before each extracted track (in
+        milliseconds), taken from the recording where it can be */
+    int pre_gap_period;
+
+    /** Length of digital silence put after each extracted track (in milliseconds) */
+    int post_gap_period;
+
+    /** Set this flag to pad each extracted track out to a whole number
+        of CD frames (#CD_FRAME_LEN) */
+    int cd_frames;
+
+    /** Set this flag to process several mono files at once, one per channel */
+    int batch;
+
+    /** Input file names given with --batch (points into @a argv) */
+    char **batch_file_names;
+
+    /** Number of entries in @a batch_file_names */
+    int batch_file_cnt;
+
+    /** Set this flag to collect timings and counters, for --profile or --metrics */
+    int profile;
+
+    /** Set this flag to print a breakdown of where the time went on exit */
+    int profile_report;
+
+    /** Set this flag to add hardware performance counters to the breakdown */
+    int profile_counters;
+
+    /** Chrome trace-event file name (@c NULL if not requested) */
+    const char *trace_file_name;
+
+    /** Per-hop energy map file name (@c NULL if not requested) */
+    const char *energy_map_file_name;
+
+    /** Per-hop detector state file name (@c NULL if not requested) */
+    const char *decision_trace_file_name;
+
+    /** Set this flag to report progress periodically on standard error */
+    int progress;
+
+    /** Run metrics file name (@c NULL if not requested) */
+    const char *metrics_file_name;
+
+    /** Set this flag to time the available block lengths and write the
+        best to the wisdom file, instead of processing a recording */
+    int tune;
+
+    /** Wisdom file name given with --wisdom (@c NULL means the default
+        in the home directory) */
+    const char *wisdom_file_name;
+
+    /** Number of frames read from the input file at a time */
+    int read_block_len;
+
+    /** Number of frames written to a track file at a time */
+    int write_block_len;
+
+    /** Most memory the program's buffers may take, in bytes; zero if
+        not limited */
+    sf_count_t memory_limit;
     
     /** Verbose flag */
     int verbose;
@@ -218,23 +798,85 @@ typedef struct
 typedef struct 
 {
     SNDFILE *in_file;           /**< Input file containing audio to process */
-    char *out_file_name;        /**< Current output file name (extraction mode only) */
+    char *out_file_name;        /**< Current output file name (extraction mode only); NULL between tracks */
+    char *out_file_name_buf;    /**< Buffer behind @a out_file_name, reused from track to track */
+    size_t out_file_name_buf_sz;/**< Current malloc() allocation size of @a out_file_name_buf */
     SNDFILE *out_file;          /**< Current output file (extraction mode only) */
     SF_INFO *out_sfinfo;        /**< Format options for current output file (extraction mode only)*/
     FILE *cuts_file;            /**< Cut point destination (may point to stdout); NULL in extraction mode. */
     FILE *track_names_file;     /**< Track names source (may point to stdin); NULL if absent. */
+    FILE *manifest_file;        /**< Checksum manifest destination; NULL if not requested. */
+    out_io_t out_io;            /**< I/O state of current output file (manifest or tar output only) */
+    md5_ctx_t out_pcm_md5;      /**< Digest of samples written to current output file, as decoded (manifest only) */
+    sf_count_t out_frames_written; /**< Number of frames written to current output file */
+    double *wr_buf;             /**< Frames held back for writing, #options_t::write_block_len at a time */
+    int wr_len;                 /**< Number of frames in @a wr_buf */
+    int *wr_qbuf;               /**< Block of samples quantised for integer PCM track files (see #track_sample_bits) */
     int in_eof;                 /**< Set this flag once EOF is reached on input audio stream */
+    double *rd_buf;             /**< Read buffer of #options_t::read_block_len frames */
+    int rd_pos;                 /**< Next frame to be taken from @a rd_buf */
+    int rd_len;                 /**< Number of frames in @a rd_buf */
+    sf_count_t in_mem_pos;      /**< Next frame to be taken from #options_t::in_mem */
+
+    /* The following are only used with --copy-frames. */
+    int copy_fd;                    /**< Second descriptor on the input file, for copying from */
+    copy_container_t copy_container;/**< Container format of the input file */
+    codec_unit_t *copy_units;       /**< Index of compressed units in the input file */
+    int copy_unit_cnt;              /**< Number of entries in @a copy_units */
+    int copy_unit_alloc;            /**< Allocated number of entries in @a copy_units */
+    int copy_hdr_cnt;               /**< Ogg: number of leading pages holding the codec headers */
+    int copy_margin;                /**< Ogg: frames lost when decoding starts on a new page */
+
+    /* The following are only used with --pre-gap and --post-gap. */
+    double *gap_buf;                /**< Ring of the latest frames of the gap before the next track */
+    int gap_buf_len;                /**< Capacity of @a gap_buf, in frames (the pre-gap length) */
+    int gap_buf_pos;                /**< Next frame of @a gap_buf to be filled */
+    int gap_buf_cnt;                /**< Number of frames held in @a gap_buf */
+    int post_gap_len;               /**< Length of the post-gap, in frames */
+
+    /* The following are only used with --output-filter. */
+    /** Frames of @a main_buf as read, before DC offset correction and
+        filtering, at the same positions */
+    double *raw_buf;
+    /** `dc' only: ring of frames of the current track file waiting to
+        be written, with those before and after them in the window */
+    double *dc_buf;
+    int dc_buf_len;                 /**< Capacity of @a dc_buf, in frames: the whole window */
+    int dc_half_len;                /**< Frames either side of each in its window (the lookahead) */
+    sf_count_t dc_in;               /**< Frames of the current track file taken into @a dc_buf */
+    sf_count_t dc_out;              /**< Frames of the current track file written out */
+    sf_count_t dc_lo;               /**< First frame summed in @a dc_sum */
+    double dc_sum[MAX_CHANNELS];    /**< Sum of frames @a dc_lo to @a dc_in (exclusive) */
+
+    /* The following are only used with --exempt. */
+    exempt_win_t *exempt_wins;      /**< Exempt windows, in order, none overlapping */
+    int exempt_win_cnt;             /**< Number of entries in @a exempt_wins */
+    int exempt_cur;                 /**< Index of the first window not yet passed */
+    int exempt_on;                  /**< Set while the current frame is within a window */
+    /** Frame at which the current frame next moves into or out of a
+        window (@c SF_COUNT_MAX if it never does) */
+    sf_count_t exempt_edge;
+
+    /* The following are only used with --adaptive-floor. */
+    /** Frames until the energy of the current hop is taken (@c
+        SF_COUNT_MAX if the noise floor is fixed) */
+    sf_count_t floor_hop_left;
+    int floor_sub_len;              /**< Length of each sub-window, in hops */
+    int floor_sub_left;             /**< Hops left in the current sub-window */
+    int floor_sub_idx;              /**< Entry of @a floor_sub_min for the current sub-window */
+    double floor_sub_min[FLOOR_SUBWIN_CNT]; /**< Least hop energy in each sub-window */
+    double floor_old_min;           /**< Least of @a floor_sub_min over the completed sub-windows */
+    double floor_ratio;             /**< Margin above the least energy, as a ratio */
+    double floor_lowest;            /**< Energy the tracked noise floor can't fall below */
+
     sf_count_t frames_remaining;/**< Number of frames remaining yet to be processed */
-    cut_context_t cut_context;  /**< Current track-cutting context state */
-    sf_count_t time_to_live;    /**< Time-to-live for current state, in frames (when relevant). */
+    cut_stream_t cut;           /**< Track-cutting state of the input file */
     
     sf_count_t frames_read_ttl; /**< Number of frames read to date (for HPF) */
     sf_count_t frames_proc_ttl; /**< Number of frames processed to date (for RMS) */
     sf_count_t cur_frame_pos;   /**< Current frame position in input file */
-    int cur_track_num;          /**< Current track number in input file */
     char *cur_track_name;       /**< Current track name (if supplied; NULL otherwise) */
     size_t cur_track_name_sz;   /**< Current malloc() allocation size of @a cur_track_name */
-    sf_count_t cur_track_start; /**< Current track starting frame index */
     int numchannels;            /**< Number of channels in input file */
     int samplerate;             /**< Sampling rate in Hz */
     int rms_window_len;         /**< Number of samples in RMS/prefilter/postfilter buffers */
@@ -246,11 +888,34 @@ typedef struct
     /** Number of frames that input file position is ahead of current processing position by */
     sf_count_t ra_frame_cnt;
 
+    /* The following are only used in shard mode. */
+    sf_count_t shard_slice_start;   /**< First frame index of this shard's slice */
+    sf_count_t shard_slice_end;     /**< Frame index where the next shard's slice begins */
+    int shard_run_sig;              /**< Signal decision of the run being collected (-1 if none yet) */
+    sf_count_t shard_run_len;       /**< Length of the run being collected, in frames */
+
+    /* The following are only used in batch mode. */
+    lane_t lanes[MAX_CHANNELS];     /**< Per-file state, indexed by channel */
+
+    /* The following are only used in merge mode. */
+    shard_file_t *merge_files;      /**< Partial-state files, sorted by shard number */
+    int merge_cur;                  /**< Index into @a merge_files of the shard being replayed */
+    sf_count_t merge_run_left;      /**< Frames left in the run currently being replayed */
+
+    profile_t prof;                 /**< Timings and counters (--profile only) */
+    trace_t trace;                  /**< Event timeline (--trace only) */
+    energy_map_t emap;              /**< Per-hop energy levels (--energy-map only) */
+    decision_trace_t dtrace;        /**< Per-hop detector state (--decision-trace only) */
+    arena_t arena;                  /**< Memory for the long-lived buffers */
+    progress_t progress;            /**< Progress reporting state */
+    int metrics_dir_fd;             /**< Directory to write the metrics file into (--metrics only) */
+    char *metrics_base_name;        /**< Name of the metrics file within it (--metrics only) */
+
     double alpha;                         /**< Scaling factor in high-pass filter */
     double n_x_nf_sq;                    /**< n(x_nf)^2 precomputed for RMS comparisons */
     double x_sq_ttl[MAX_CHANNELS];        /**< Current sum(x_i^2) for RMS comparisons */
     double hpf_rej[MAX_CHANNELS];         /**< Previous shunt-to-earth level for high-pass filter */
-    double hpf_rej_ttl[MAX_CHANNELS];     /**< Cumulative total of reject levels, used for computing DC offset */
+    int64_t dc_acc[MAX_CHANNELS];         /**< Sum of DC-corrected input samples in fixed point (see #DC_ACC_SCALE), used for computing DC offset */
     double hpf_out[MAX_CHANNELS];         /**< HPF output for current frame, used for computing DC offset */
     double hpf_prev_out[MAX_CHANNELS];    /**< HPF output for previous frame, used for computing DC offset */
     double hpf_prev_rej[MAX_CHANNELS];    /**< HPF residual for previous frame, used for computing DC offset */
@@ -334,6 +999,29 @@ static const struct option longopts[] =
     { "no-cuts-file-header", no_argument, NULL, 'N' },
     { "version", no_argument, NULL, 'V' },
     { "verbose", no_argument, NULL, 'v' },
+    { "shard", required_argument, NULL, LOPT_SHARD },
+    { "merge", no_argument, NULL, LOPT_MERGE },
+    { "manifest", required_argument, NULL, LOPT_MANIFEST },
+    { "copy-frames", no_argument, NULL, LOPT_COPY_FRAMES },
+    { "batch", no_argument, NULL, LOPT_BATCH },
+    { "profile", no_argument, NULL, LOPT_PROFILE },
+    { "profile-counters", no_argument, NULL, LOPT_PROFILE_COUNTERS },
+    { "trace", required_argument, NULL, LOPT_TRACE },
+    { "progress", no_argument, NULL, LOPT_PROGRESS },
+    { "metrics", required_argument, NULL, LOPT_METRICS },
+    { "tune", no_argument, NULL, LOPT_TUNE },
+    { "wisdom", required_argument, NULL, LOPT_WISDOM },
+    { "memory-limit", required_argument, NULL, LOPT_MEMORY_LIMIT },
+    { "pre-gap", required_argument, NULL, LOPT_PRE_GAP },
+    { "post-gap", required_argument, NULL, LOPT_POST_GAP },
+    { "cd-frames", no_argument, NULL, LOPT_CD_FRAMES },
+    { "exempt", required_argument, NULL, LOPT_EXEMPT },
+    { "adaptive-floor", required_argument, NULL, LOPT_ADAPTIVE_FLOOR },
+    { "floor-window", required_argument, NULL, LOPT_FLOOR_WINDOW },
+    { "energy-map", required_argument, NULL, LOPT_ENERGY_MAP },
+    { "output-filter", required_argument, NULL, LOPT_OUTPUT_FILTER },
+    { "high-pass-corner", required_argument, NULL, LOPT_HIGH_PASS_CORNER },
+    { "decision-trace", required_argument, NULL, LOPT_DECISION_TRACE },
     { NULL },
 };
 
@@ -354,6 +1042,7 @@ static const char *tc_task_t_s[] =
 {
     "TCT_CUTTING",
     "TCT_ANALYSIS",
+    "TCT_MERGE",
     NULL,
 };
 
@@ -374,6 +1063,30 @@ static const char *cut_point_format_t_s[] =
     NULL,
 };
 
+/** Human-readable representations of #output_filter_t values */
+static const char *output_filter_t_s[] =
+{
+    "OFM_SAME",
+    "OFM_NONE",
+    "OFM_DC",
+    NULL,
+};
+
+/** Arguments to --output-filter, in the order of #output_filter_t */
+static const char *output_filter_names[] =
+{
+    "same",
+    "none",
+    "dc",
+    NULL,
+};
+
+/** Block lengths that --tune chooses between, in frames */
+static const int tune_block_lens[] = { 1, 16, 64, 256, 1024, 4096, 16384 };
+
+/** Number of entries in #tune_block_lens */
+#define TUNE_BLOCK_LEN_CNT ((int)(sizeof(tune_block_lens) / sizeof(tune_block_lens[0])))
+
 
 /* Oh dear, this isn't necessary. Look at sf_command(SFC_GET_FORMAT_MAJOR_COUNT) */
 
@@ -398,6 +1111,44 @@ static options_t options;
 /** Program state */
 static state_t state;
 
+/** Set by the SIGUSR1 handler to ask for a progress report */
+static volatile sig_atomic_t progress_requested;
+
+/** Number of heap allocations made so far, reported by --profile to
+    show that the main loop makes none once running. Only this program's
+    own calls are counted, made through counted_malloc() and its kin;
+    those made within libsndfile and the C library (bar getline()) are
+    not. */
+static unsigned long alloc_cnt;
+
+/** malloc(), counted in #alloc_cnt. */
+static void *counted_malloc(size_t sz)
+{
+    alloc_cnt++;
+    return malloc(sz);
+}
+
+/** calloc(), counted in #alloc_cnt. */
+static void *counted_calloc(size_t n, size_t sz)
+{
+    alloc_cnt++;
+    return calloc(n, sz);
+}
+
+/** realloc(), counted in #alloc_cnt. */
+static void *counted_realloc(void *p, size_t sz)
+{
+    alloc_cnt++;
+    return realloc(p, sz);
+}
+
+/** strdup(), counted in #alloc_cnt. */
+static char *counted_strdup(const char *s)
+{
+    alloc_cnt++;
+    return strdup(s);
+}
+
 /** Sets default program options */
 static void init_options(void)
 {
@@ -409,8 +1160,12 @@ static void init_options(void)
     options.min_signal_period = DFL_MIN_SIGNAL_PERIOD;
     options.min_track_length = DFL_MIN_TRACK_LENGTH;
     options.noise_floor_dbfs = DFL_NOISE_FLOOR;
+    options.floor_window = DFL_FLOOR_WINDOW;
+    options.high_pass_corner = HIGH_PASS_CORNER_FREQ;
     options.end_frame_idx = SF_COUNT_MAX;
     options.track_num_end = INT_MAX;
+    options.read_block_len = DFL_READ_BLOCK_LEN;
+    options.write_block_len = DFL_WRITE_BLOCK_LEN;
 }
 
 /** Prints "try `progname --help' for more information" message to
@@ -429,11 +1184,22 @@ static void print_help_msg(void)
     printf("Usage: %s [--cut] [--cuts-file=CUTSFILE] [OPTION...] FILE\n", program_invocation_short_name);
     printf("   or: %s [--cut] --extract-dir=DIR [OPTION...] FILE\n", program_invocation_short_name);
     printf("   or: %s --analyse [OPTION...] FILE\n", program_invocation_short_name);
+    printf("   or: %s --merge [OPTION...] PARTFILE...\n", program_invocation_short_name);
+    printf("   or: %s --batch [--cuts-file=CUTSFILE] [OPTION...] FILE...\n", program_invocation_short_name);
+    printf("   or: %s --tune [--wisdom=FILE]\n", program_invocation_short_name);
     printf("Divides an audio recording into multiple tracks delimited by silence.\n");
     printf("\n");
     printf("Mode switches:\n");
     printf("  -C, --cut                 Search for track delimiters (default mode)\n");
     printf("  -a, --analyse             Perform statistical analysis on FILE\n");
+    printf("      --merge               Combine partial-state files written by --shard\n");
+    printf("                            runs into the report a single run would give.\n");
+    printf("      --batch               Search for track delimiters in up to %d mono\n", MAX_CHANNELS);
+    printf("                            FILEs at once, at little more than the cost of\n");
+    printf("                            one. They must share the same sampling rate.\n");
+    printf("      --tune                Time reading and writing audio in blocks of\n");
+    printf("                            various lengths on this machine, and save the\n");
+    printf("                            fastest to the wisdom file for later runs.\n");
     printf("\n");
     printf("Options applicable in all modes:\n");
     printf("  -t, --time-range=S-F   Only process input file between given bounds.\n");
@@ -457,7 +1223,55 @@ static void print_help_msg(void)
     printf("  -H, --high-pass        Run audio signal thru high-pass filter with\n");
     printf("                         corner frequency (3dB att.) at %.1fHz\n", HIGH_PASS_CORNER_FREQ);
     printf("                         before processing.\n");
+    printf("      --high-pass-corner=N\n");
+    printf("                         Corner frequency of the high-pass filter, in Hz.\n");
+    printf("                         Default is %.1f.\n", HIGH_PASS_CORNER_FREQ);
     printf("  -r, --raw              Indicates input recording is raw (headerless) audio.\n");
+    printf("      --shard=I/N        Only process the I-th of N equal slices of FILE, and\n");
+    printf("                         write a partial-state file to CUTSFILE instead of\n");
+    printf("                         the usual report. FILE must be seekable.\n");
+    printf("      --profile          On exit, print to standard error how long each\n");
+    printf("                         stage of processing took, with throughput and\n");
+    printf("                         memory figures. Not available with --batch,\n");
+    printf("                         --shard or --merge.\n");
+    printf("      --profile-counters As --profile, adding CPU cycles, instructions, cache\n");
+    printf("                         misses and branch misses per frame for each stage,\n");
+    printf("                         where the system permits (Linux only).\n");
+    printf("      --trace=FILE       Record a timeline of reading, filtering and track\n");
+    printf("                         files being written, and save it to FILE on exit\n");
+    printf("                         as Chrome trace-event JSON (for Perfetto or\n");
+    printf("                         chrome://tracing). Not available with --batch,\n");
+    printf("                         --shard or --merge.\n");
+    printf("      --energy-map=FILE  Write the least and greatest RMS level within\n");
+    printf("                         each 50ms hop to FILE, for tools that query the\n");
+    printf("                         level over spans of the recording. Not available\n");
+    printf("                         with --batch, --shard or --merge.\n");
+    printf("      --decision-trace=FILE\n");
+    printf("                         In cutting mode, write the detector's levels,\n");
+    printf("                         threshold and state every 50ms, and at each change\n");
+    printf("                         of state, to FILE in binary (see decision-trace.py\n");
+    printf("                         to read it). Not available with --batch, --shard\n");
+    printf("                         or --merge.\n");
+    printf("      --progress         Report the position reached, speed, estimated\n");
+    printf("                         time remaining and tracks found so far on standard\n");
+    printf("                         error: every second on a terminal, otherwise every\n");
+    printf("                         30 seconds. A report can also be had at any time\n");
+    printf("                         by sending the process SIGUSR1.\n");
+    printf("      --metrics=FILE     On exit, write run metrics (duration, throughput,\n");
+    printf("                         bytes, tracks, time per stage, peak memory) to\n");
+    printf("                         FILE: in Prometheus text format if its name ends\n");
+    printf("                         in .prom, otherwise as JSON. FILE is replaced\n");
+    printf("                         atomically. Not available with --batch, --shard or\n");
+    printf("                         --merge.\n");
+    printf("      --wisdom=FILE      Use the block lengths saved in FILE by --tune,\n");
+    printf("                         instead of those in ~/%s. If there's\n", WISDOM_FILE_NAME);
+    printf("                         no wisdom, blocks of %d frames are used.\n", DFL_READ_BLOCK_LEN);
+    printf("      --memory-limit=SIZE\n");
+    printf("                         Keep buffers within SIZE bytes (or KiB, MiB or GiB\n");
+    printf("                         if suffixed by K, M or G), making the resizable\n");
+    printf("                         ones smaller and staging tar output in a temporary\n");
+    printf("                         file as needed. Fails if even the minimum won't\n");
+    printf("                         fit.\n");
     printf("\n");
     printf("For raw audio the following options must be given; no defaults are presumed.\n");
     printf("  -R, --rate=N          Sampling rate in Hz\n");
@@ -474,6 +1288,7 @@ static void print_help_msg(void)
     printf("                            This is the default action. If omitted or `-' is\n");
     printf("                            given, cuts list is sent to standard output.\n");
     printf("  -d, --extract-dir=DIR     Extract tracks to individual files in directory DIR\n");
+    printf("                            (if `-', write them to stdout as a tar archive)\n");
     printf("\n");
     printf("Options applicable in cutting mode (--cut):\n");
     printf("  -i, --track-names-file=LISTFILE  Text file containing track names.\n");
@@ -492,6 +1307,11 @@ static void print_help_msg(void)
     printf("                                   signal from silence. Given in decibels\n");
     printf("                                   full scale (dBFS), must be a negative real\n");
     printf("                                   number. Default is %.2f.\n", DFL_NOISE_FLOOR);
+    printf("      --adaptive-floor=N           Track the noise floor through the recording,\n");
+    printf("                                   N decibels above the quietest recent audio,\n");
+    printf("                                   starting from the --noise-floor level.\n");
+    printf("      --floor-window=N             Time in seconds the quietest audio is taken\n");
+    printf("                                   over by --adaptive-floor. Default is %d.\n", DFL_FLOOR_WINDOW);
     printf("  -T, --track-range=A-B            Signifies track numbering will start from A\n");
     printf("                                   and processing will stop at track number B.\n");
     printf("                                   Track numbers must be positive integers.\n");
@@ -501,6 +1321,8 @@ static void print_help_msg(void)
     printf("                                   Will skip first A lines in LISTFILE given by\n");
     printf("                                   -i, however corresponding start point in\n");
     printf("                                   input recording must be given by -t or -I.\n");
+    printf("      --exempt=FILE                Never treat the time ranges listed in FILE,\n");
+    printf("                                   one per line as for -t, as silence.\n");
     printf("\n");
     printf("Options applicable in cuts file mode (--cuts-file):\n");
     printf("  -P, --print-frame-indices   Cut points & track durations given in frames.\n");
@@ -512,6 +1334,24 @@ static void print_help_msg(void)
     printf("Options applicable in extraction mode (--extract-dir):\n");
     printf("  -f, --output-format=EXT   Format for output files. See list below.\n");
     printf("                            If not given, input file format will be used.\n");
+    printf("      --manifest=FILE       Write the MD5 of the samples and CRC-32 of the\n");
+    printf("                            file of each track to FILE, for verification.\n");
+    printf("      --copy-frames         Copy MP3 frames or Ogg Vorbis pages from the input\n");
+    printf("                            file verbatim rather than re-encoding (cuts fall\n");
+    printf("                            on the nearest frame or page boundary).\n");
+    printf("      --pre-gap=N           Begin each track with N milliseconds of the gap\n");
+    printf("                            before it, made up with digital silence where\n");
+    printf("                            the gap is shorter.\n");
+    printf("      --post-gap=N          End each track with N milliseconds of digital\n");
+    printf("                            silence.\n");
+    printf("      --cd-frames           Pad each track with digital silence to a whole\n");
+    printf("                            number of CD frames (%d samples), for burning\n", CD_FRAME_LEN);
+    printf("                            disc-at-once.\n");
+    printf("      --output-filter=MODE  Processing of the audio written: `same' (the\n");
+    printf("                            default) as the detector has it after -D and -H,\n");
+    printf("                            `none' as read, or `dc' less its mean over the\n");
+    printf("                            surrounding %dms, a gentle zero-phase DC removal.\n",
+        OUTPUT_DC_WINDOW_PERIOD);
     printf("\n");
     printf("List of available output file formats:\n");
     {
@@ -638,6 +1478,49 @@ static int parse_positive_int_arg(void)
     return n;
 }
 
+/** Parses current option argument as an amount of memory, given in
+    bytes, or in units of 1024, 1024^2 or 1024^3 bytes if suffixed by K,
+    M or G. Terminates program with an error message if an invalid
+    argument is given.
+
+    @returns Parsed size in bytes, guaranteed to be positive. */
+static sf_count_t parse_memory_size_arg(void)
+{
+    /* tail: Remainder of the argument after the number */
+    /* shift: Power of two the number is multiplied by */
+    char *tail;
+    long long n;
+    int shift = 0;
+
+    errno = 0;
+    n = strtoll(optarg, &tail, 10);
+    switch(*tail)
+    {
+        case 'k':
+        case 'K':
+            shift = 10;
+            tail++;
+            break;
+        case 'm':
+        case 'M':
+            shift = 20;
+            tail++;
+            break;
+        case 'g':
+        case 'G':
+            shift = 30;
+            tail++;
+            break;
+    }
+    if(tail == optarg || *tail || n <= 0 || errno || n > (LLONG_MAX >> shift))
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Argument `%s' for option `%s' must be a positive number of bytes, "
+            "optionally followed by K, M or G", optarg, render_current_option());
+    }
+    return (sf_count_t)n << shift;
+}
+
 /** Parses current option argument as a noise floor quantity,
     given in decibels full-scale (dbFS). Must be negative. Terminates
     program with an error message if an invalid argument is given
@@ -664,14 +1547,60 @@ static double parse_noise_floor_arg(void)
     return n;
 }
 
-/** Parses a time code string; returns absolute number of seconds.
-    Terminates program with error message if string is malformed.
+/** Parses the current argument as the processing to apply to the audio
+    written to track files, given with --output-filter. Will terminate
+    the program if an unknown mode is given. */
+static void parse_output_filter_arg(void)
+{
+    /* i: Index of the mode being tested against the argument */
+    int i;
 
-    @param s String to parse
+    for(i = 0; output_filter_names[i] && strcmp(output_filter_names[i], optarg) != 0; i++)
+    {
+    }
+    if(!output_filter_names[i])
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Argument `%s' for option `%s' must be `same', `none' or `dc'",
+            optarg, render_current_option());
+    }
+    options.output_filter = (output_filter_t)i;
+}
+
+/** Parses current option argument as a positive real number.
+    Terminates program with an error message if an invalid argument is
+    given (non-positive or non-numeric).
+
+    @returns Parsed value, guaranteed to be positive. */
+static double parse_positive_real_arg(void)
+{
+    char *optarg_str_tail;
+    double n = strtod(optarg, &optarg_str_tail);
+
+    if(optarg_str_tail == optarg || *optarg_str_tail || !(n > 0.0))
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Argument `%s' for option `%s' must be a positive real number",
+            optarg, render_current_option());
+    }
+    else if(errno)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, errno, "Bad argument `%s' for option `%s'",
+            optarg, render_current_option());
+    }
+    return n;
+}
+
+/** Scans a time code string, in any of the forms described for
+    #parse_time_range.
+
+    @param s String to scan
     @param dfl Default value to use if string is empty or only contains
     whitespace.
-    @returns Parsed numeric value of @a s in absolute seconds, if valid. */
-static double parse_time_code(const char *s, double dfl)
+    @param sec_out Receives the value of @a s in absolute seconds
+    @returns @c TRUE if @a s is well-formed; @c FALSE otherwise. */
+static int scan_time_code(const char *s, double dfl, double *sec_out)
 {
     /* hrs,min,sec: Used for storing hrs:min:sec components from sscanf() */
     /* s_tail_idx: Index into s of last character parsed */
@@ -699,9 +1628,26 @@ static double parse_time_code(const char *s, double dfl)
         sec = dfl;
     }
 
-    if(s[s_tail_idx])
+    *sec_out = sec;
+    /* Anything left over means the string is blatantly malformed or
+       contains spurious junk at the end */
+    return !s[s_tail_idx];
+}
+
+/** Parses a time code string; returns absolute number of seconds.
+    Terminates program with error message if string is malformed.
+
+    @param s String to parse
+    @param dfl Default value to use if string is empty or only contains
+    whitespace.
+    @returns Parsed numeric value of @a s in absolute seconds, if valid. */
+static double parse_time_code(const char *s, double dfl)
+{
+    /* sec: Parsed value of s */
+    double sec;
+
+    if(!scan_time_code(s, dfl, &sec))
     {
-        /* String is blatantly malformed or contains spurious junk at the end */
         atexit(print_get_help_msg);
         error(EXIT_FAILURE, 0, "Timecode `%s' specified in argument for option `%s' is malformed",
             s, render_current_option());
@@ -877,6 +1823,35 @@ static void parse_track_range(void)
     }
 }
 
+/** Parses current shard argument, given by @c --shard. Results stored
+    in @c options.shard_idx and @c options.shard_cnt. Terminates program
+    with an error message if malformed or out of range.
+
+    A shard argument is two positive integers separated by a slash; the
+    first is the shard number (counting from 1), the second is the total
+    number of shards. */
+static void parse_shard_arg(void)
+{
+    /* s_tail_idx: Index into optarg of last character parsed */
+    int s_tail_idx = 0;
+
+    if(sscanf(optarg, "%d/%d %n", &options.shard_idx, &options.shard_cnt, &s_tail_idx) != 2
+        || optarg[s_tail_idx])
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0,
+            "Shard `%s' given with `%s' must be two positive integers separated by a slash.",
+            optarg, render_current_option());
+    }
+    if(options.shard_cnt <= 0 || options.shard_idx <= 0 || options.shard_idx > options.shard_cnt)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0,
+            "Shard `%s' given by `%s' must satisfy 1 <= I <= N.",
+            optarg, render_current_option());
+    }
+}
+
 /** Parses DC offset argument, given by @c -D option. Note that the
     string pointed to by @a optarg will be munged, and that the number
     of channels is not verified here, since it may not be known yet. Any
@@ -923,6 +1898,35 @@ static void parse_dc_offset_arg(void)
     }
 }
 
+/** Tells whether an option has any effect in --merge mode. Options that
+    read or process the audio, or delimit tracks, are the business of the
+    shard runs, and the track extraction options need the audio too.
+
+    @param opt Code returned by @c getopt_long() for the option.
+    @return @c TRUE if @a opt is applied when merging. */
+static int option_applies_to_merge(int opt)
+{
+    switch(opt)
+    {
+        case 'f': case 'd': case 'l': case 's': case 'n': case 'S':
+        case 't': case 'I': case 'r': case 'R': case 'c': case 'b':
+        case 'x': case 'u': case 'X': case 'E': case 'e': case 'D':
+        case 'H':
+        case LOPT_MANIFEST:
+        case LOPT_COPY_FRAMES:
+        case LOPT_BATCH:
+        case LOPT_PRE_GAP:
+        case LOPT_POST_GAP:
+        case LOPT_CD_FRAMES:
+        case LOPT_FLOOR_WINDOW:
+        case LOPT_OUTPUT_FILTER:
+        case LOPT_HIGH_PASS_CORNER:
+            return FALSE;
+        default:
+            return TRUE;
+    }
+}
+
 /** Parses command line arguments and stores them in the #options
     structure. Note that this function will terminate the program if any
     errors are encountered, or the user help message is requested while
@@ -935,6 +1939,9 @@ static void parse_options(void)
     /* raw_is_fp: Set flag if raw input format has floating point samples */
     /* raw_is_signed: Set flag if raw input format is has signed integer samples */
     /* raw_is_little_endian: Set flag if raw input format is little endian */
+    /* floor_window_given: Set if --floor-window was given */
+    /* high_pass_corner_given: Set if --high-pass-corner was given */
+    /* no_merge_opt: First option given that --merge has no use for */
     int raw_rate_given = FALSE;
     int raw_channels_given = FALSE;
     int raw_bits_given = FALSE;
@@ -944,11 +1951,19 @@ static void parse_options(void)
     int raw_is_fp = FALSE;
     int raw_is_signed = FALSE;
     int raw_is_little_endian = FALSE;
+    int floor_window_given = FALSE;
+    int high_pass_corner_given = FALSE;
+    char no_merge_opt[MAX_LONG_OPTION_NAME_LEN + 3] = "";
 
     do
     {
         options.cur_longopt_idx = -1;
         options.cur_shortopt = getopt_long(options.argc, options.argv, shortopts, longopts, &options.cur_longopt_idx);
+        if(options.cur_shortopt >= 0 && !no_merge_opt[0]
+            && !option_applies_to_merge(options.cur_shortopt))
+        {
+            strcpy(no_merge_opt, render_current_option());
+        }
 
         switch(options.cur_shortopt)
         {
@@ -979,6 +1994,7 @@ static void parse_options(void)
             case 'd':
                 /** Implies track extraction mode */
                 options.track_directory = optarg;
+                options.tar_output = strcmp(optarg, stdout_file_name) == 0;
                 options.cut_point_action = CPA_EXTRACT_TRACK;
                 break;
             case 'i':
@@ -1069,6 +2085,81 @@ static void parse_options(void)
             case 'v':
                 options.verbose = TRUE;
                 break;
+            case LOPT_SHARD:
+                parse_shard_arg();
+                break;
+            case LOPT_MERGE:
+                options.task = TCT_MERGE;
+                break;
+            case LOPT_MANIFEST:
+                options.manifest_file_name = optarg;
+                break;
+            case LOPT_COPY_FRAMES:
+                options.copy_frames = TRUE;
+                break;
+            case LOPT_BATCH:
+                options.batch = TRUE;
+                break;
+            case LOPT_PROFILE:
+                options.profile = TRUE;
+                options.profile_report = TRUE;
+                break;
+            case LOPT_PROFILE_COUNTERS:
+                options.profile = TRUE;
+                options.profile_report = TRUE;
+                options.profile_counters = TRUE;
+                break;
+            case LOPT_TRACE:
+                options.trace_file_name = optarg;
+                break;
+            case LOPT_PROGRESS:
+                options.progress = TRUE;
+                break;
+            case LOPT_METRICS:
+                options.profile = TRUE;
+                options.metrics_file_name = optarg;
+                break;
+            case LOPT_TUNE:
+                options.tune = TRUE;
+                break;
+            case LOPT_WISDOM:
+                options.wisdom_file_name = optarg;
+                break;
+            case LOPT_MEMORY_LIMIT:
+                options.memory_limit = parse_memory_size_arg();
+                break;
+            case LOPT_PRE_GAP:
+                options.pre_gap_period = parse_positive_int_arg();
+                break;
+            case LOPT_POST_GAP:
+                options.post_gap_period = parse_positive_int_arg();
+                break;
+            case LOPT_CD_FRAMES:
+                options.cd_frames = TRUE;
+                break;
+            case LOPT_EXEMPT:
+                options.exempt_file_name = optarg;
+                break;
+            case LOPT_ADAPTIVE_FLOOR:
+                options.adaptive_floor_margin = parse_positive_real_arg();
+                break;
+            case LOPT_ENERGY_MAP:
+                options.energy_map_file_name = optarg;
+                break;
+            case LOPT_FLOOR_WINDOW:
+                options.floor_window = parse_positive_int_arg();
+                floor_window_given = TRUE;
+                break;
+            case LOPT_OUTPUT_FILTER:
+                parse_output_filter_arg();
+                break;
+            case LOPT_DECISION_TRACE:
+                options.decision_trace_file_name = optarg;
+                break;
+            case LOPT_HIGH_PASS_CORNER:
+                options.high_pass_corner = parse_positive_real_arg();
+                high_pass_corner_given = TRUE;
+                break;
             case '?':
             case ':':
                 /* Invalid/missing argument. The getopt() call will print
@@ -1082,57 +2173,267 @@ static void parse_options(void)
     }
     while(options.cur_shortopt >= 0);
 
-    if(optind + 1 == options.argc)
+    if(options.tune)
     {
-        /* Only one file name given in arguments */
-        if(strcmp(stdin_file_name, options.argv[optind]) != 0)
-        {
-            /* Audio data to be read from a file */
-            options.in_file_name = options.argv[optind];
-        }
-        else if(options.track_names_file_name &&
-            strcmp(stdin_file_name, options.track_names_file_name) == 0)
+        /* Tuning works on a synthetic recording of its own */
+        if(optind < options.argc)
         {
             atexit(print_get_help_msg);
-            error(EXIT_FAILURE, 0, "Can't read both audio data and track names from standard input");
+            error(EXIT_FAILURE, 0, "Option `--tune' doesn't take an input file: `%s'",
+                options.argv[optind]);
         }
+        return;
     }
-    else if(optind + 1 < options.argc)
+    if(options.profile && (options.task == TCT_MERGE || options.batch || options.shard_cnt))
     {
-        /* Multiple file names given in arguments */
         atexit(print_get_help_msg);
-        error(EXIT_FAILURE, 0, "Multiple input files not permitted: `%s'", options.argv[optind + 1]);
+        error(EXIT_FAILURE, 0, "Option `%s' can't be combined with `--batch', `--shard' or `--merge'",
+            options.profile_counters ? "--profile-counters"
+            : options.profile_report ? "--profile" : "--metrics");
     }
-    else
+    if(options.trace_file_name && (options.task == TCT_MERGE || options.batch || options.shard_cnt))
     {
-        /* No file names given in arguments */
         atexit(print_get_help_msg);
-        error(EXIT_FAILURE, 0, "No input file was specified");
+        error(EXIT_FAILURE, 0, "Option `--trace' can't be combined with `--batch', `--shard' or `--merge'");
+    }
+    if(options.energy_map_file_name && (options.task == TCT_MERGE || options.batch || options.shard_cnt))
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--energy-map' can't be combined with `--batch', `--shard' or `--merge'");
+    }
+    if(options.decision_trace_file_name
+        && (options.task != TCT_CUTTING || options.batch || options.shard_cnt))
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--decision-trace' only works in cutting mode, "
+            "and not with `--batch', `--shard' or `--merge'");
+    }
+    if(options.exempt_file_name && options.task == TCT_ANALYSIS)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--exempt' only works in cutting mode");
+    }
+    else if(options.exempt_file_name && options.shard_cnt)
+    {
+        /* Shards record the detector's decisions as they stand */
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--exempt' is applied by `--merge', not `--shard'");
+    }
+    if(options.adaptive_floor_margin > 0.0
+        && (options.task != TCT_CUTTING || options.batch || options.shard_cnt))
+    {
+        /* The tracked floor depends on all of the recording before it */
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--adaptive-floor' only works in cutting mode, "
+            "and not with `--batch', `--shard' or `--merge'");
+    }
+    else if(floor_window_given && options.adaptive_floor_margin <= 0.0)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--floor-window' needs `--adaptive-floor'");
+    }
+    else if(high_pass_corner_given && !options.high_pass_filter_enabled)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--high-pass-corner' needs `--high-pass'");
     }
 
-    if(options.input_is_raw)
+    if(options.task == TCT_MERGE)
     {
-        /* Validate raw audio parameters */
-        if(!raw_rate_given)
+        /* Merging takes any number of partial-state files instead of a recording */
+        int i;
+        int stdin_cnt = 0;
+
+        if(optind >= options.argc)
         {
             atexit(print_get_help_msg);
-            error(EXIT_FAILURE, 0, "Raw audio sampling rate must be given with `--rate'");
+            error(EXIT_FAILURE, 0, "No partial-state files were specified to merge");
         }
-        else if(!raw_channels_given)
+        else if(options.shard_cnt)
         {
             atexit(print_get_help_msg);
-            error(EXIT_FAILURE, 0, "Raw audio number of channels must be given with `--channels'");
+            error(EXIT_FAILURE, 0, "Options `--shard' and `--merge' are mutually exclusive");
         }
-        else if(!raw_bits_given)
+        else if(no_merge_opt[0])
         {
+            /* The shards have already read and delimited the audio */
             atexit(print_get_help_msg);
-            error(EXIT_FAILURE, 0, "Raw audio sample bit size must be given with `--bits'");
+            error(EXIT_FAILURE, 0, "Option `%s' doesn't apply to `--merge'",
+                no_merge_opt);
         }
-        else if(!raw_sign_given)
+        options.merge_file_names = options.argv + optind;
+        options.merge_file_cnt = options.argc - optind;
+        for(i = 0; i < options.merge_file_cnt; i++)
         {
-            atexit(print_get_help_msg);
-            error(EXIT_FAILURE, 0,
-                "Raw audio sample type must be given with either `--signed', `--unsigned' or `--floating-point'");
+            if(strcmp(stdin_file_name, options.merge_file_names[i]) == 0)
+            {
+                stdin_cnt++;
+            }
+        }
+        if(stdin_cnt > 1 || (stdin_cnt && options.track_names_file_name
+            && strcmp(stdin_file_name, options.track_names_file_name) == 0))
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0, "Standard input can only be read once");
+        }
+        return;
+    }
+    else if(options.batch)
+    {
+        /* Batch mode takes up to MAX_CHANNELS mono files instead of one recording */
+        int i;
+
+        if(options.task != TCT_CUTTING || options.cut_point_action != CPA_LOG_POINT
+            || options.shard_cnt)
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0, "Option `--batch' only works in cuts-file mode");
+        }
+        else if(options.track_names_file_name)
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0, "Options `--batch' and `--track-names-file' are mutually exclusive");
+        }
+        else if(options.input_is_raw)
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0, "Options `--batch' and `--raw' are mutually exclusive");
+        }
+        else if(optind >= options.argc)
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0, "No input file was specified");
+        }
+        else if(options.argc - optind > MAX_CHANNELS)
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0, "At most %d files can be processed in one batch", MAX_CHANNELS);
+        }
+        options.batch_file_names = options.argv + optind;
+        options.batch_file_cnt = options.argc - optind;
+        for(i = 0; i < options.batch_file_cnt; i++)
+        {
+            if(strcmp(stdin_file_name, options.batch_file_names[i]) == 0)
+            {
+                atexit(print_get_help_msg);
+                error(EXIT_FAILURE, 0, "Standard input can't be used with `--batch'");
+            }
+        }
+        return;
+    }
+    else if(options.shard_cnt && options.cut_point_action == CPA_EXTRACT_TRACK)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Options `--shard' and `--extract-dir' are mutually exclusive");
+    }
+    else if(options.manifest_file_name && options.cut_point_action != CPA_EXTRACT_TRACK)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--manifest' needs `--extract-dir'");
+    }
+    else if(options.copy_frames && options.cut_point_action != CPA_EXTRACT_TRACK)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--copy-frames' needs `--extract-dir'");
+    }
+    else if(options.copy_frames && options.out_sfinfo_format)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Options `--copy-frames' and `--output-format' are mutually exclusive");
+    }
+    else if((options.pre_gap_period || options.post_gap_period || options.cd_frames)
+        && options.cut_point_action != CPA_EXTRACT_TRACK)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Options `--pre-gap', `--post-gap' and `--cd-frames' need `--extract-dir'");
+    }
+    else if((options.pre_gap_period || options.post_gap_period || options.cd_frames)
+        && options.copy_frames)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0,
+            "Options `--pre-gap', `--post-gap' and `--cd-frames' can't be used with `--copy-frames'");
+    }
+    else if(options.output_filter != OFM_SAME && options.cut_point_action != CPA_EXTRACT_TRACK)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--output-filter' needs `--extract-dir'");
+    }
+    else if(options.output_filter != OFM_SAME && options.copy_frames)
+    {
+        /* Copied frames are never decoded */
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Options `--output-filter' and `--copy-frames' are mutually exclusive");
+    }
+    else if(options.copy_frames && options.manifest_file_name)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Options `--copy-frames' and `--manifest' are mutually exclusive");
+    }
+    else if(options.tar_output && options.manifest_file_name
+        && strcmp(options.manifest_file_name, stdout_file_name) == 0)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Can't write both tar archive and manifest to standard output");
+    }
+
+    if(options.copy_frames && optind + 1 == options.argc
+        && strcmp(stdin_file_name, options.argv[optind]) == 0)
+    {
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Option `--copy-frames' can't be used with standard input");
+    }
+    if(optind + 1 == options.argc)
+    {
+        /* Only one file name given in arguments */
+        if(strcmp(stdin_file_name, options.argv[optind]) != 0)
+        {
+            /* Audio data to be read from a file */
+            options.in_file_name = options.argv[optind];
+        }
+        else if(options.track_names_file_name &&
+            strcmp(stdin_file_name, options.track_names_file_name) == 0)
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0, "Can't read both audio data and track names from standard input");
+        }
+    }
+    else if(optind + 1 < options.argc)
+    {
+        /* Multiple file names given in arguments */
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "Multiple input files not permitted: `%s'", options.argv[optind + 1]);
+    }
+    else
+    {
+        /* No file names given in arguments */
+        atexit(print_get_help_msg);
+        error(EXIT_FAILURE, 0, "No input file was specified");
+    }
+
+    if(options.input_is_raw)
+    {
+        /* Validate raw audio parameters */
+        if(!raw_rate_given)
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0, "Raw audio sampling rate must be given with `--rate'");
+        }
+        else if(!raw_channels_given)
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0, "Raw audio number of channels must be given with `--channels'");
+        }
+        else if(!raw_bits_given)
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0, "Raw audio sample bit size must be given with `--bits'");
+        }
+        else if(!raw_sign_given)
+        {
+            atexit(print_get_help_msg);
+            error(EXIT_FAILURE, 0,
+                "Raw audio sample type must be given with either `--signed', `--unsigned' or `--floating-point'");
         }
         else if(!raw_endian_given)
         {
@@ -1221,11 +2522,29 @@ static void dump_options(void)
     verbose("options.in_file_name = %s", options.in_file_name);
     verbose("options.cuts_file_name = %s", options.cuts_file_name);
     verbose("options.track_directory = %s", options.track_directory);
+    verbose("options.tar_output = %d", options.tar_output);
+    verbose("options.copy_frames = %d", options.copy_frames);
+    verbose("options.pre_gap_period = %d", options.pre_gap_period);
+    verbose("options.post_gap_period = %d", options.post_gap_period);
+    verbose("options.cd_frames = %d", options.cd_frames);
+    verbose("options.output_filter = %s", output_filter_t_s[options.output_filter]);
+    verbose("options.batch = %d", options.batch);
+    verbose("options.profile = %d", options.profile);
+    verbose("options.profile_report = %d", options.profile_report);
+    verbose("options.profile_counters = %d", options.profile_counters);
+    verbose("options.trace_file_name = %s", options.trace_file_name);
+    verbose("options.energy_map_file_name = %s", options.energy_map_file_name);
+    verbose("options.decision_trace_file_name = %s", options.decision_trace_file_name);
+    verbose("options.progress = %d", options.progress);
+    verbose("options.metrics_file_name = %s", options.metrics_file_name);
     verbose("options.track_names_file_name = %s", options.track_names_file_name);
+    verbose("options.exempt_file_name = %s", options.exempt_file_name);
     verbose("options.cut_point_format = %s", cut_point_format_t_s[options.cut_point_format]);
     verbose("options.min_silence_period = %d", options.min_silence_period);
     verbose("options.min_signal_period = %d", options.min_signal_period);
     verbose("options.noise_floor_dbfs = %f", options.noise_floor_dbfs);
+    verbose("options.adaptive_floor_margin = %f", options.adaptive_floor_margin);
+    verbose("options.floor_window = %d", options.floor_window);
     verbose("options.min_track_length = %d", options.min_track_length);
     verbose("options.time_range_given = %d", options.time_range_given);
     verbose("options.start_time = %f", options.start_time);
@@ -1235,6 +2554,9 @@ static void dump_options(void)
     verbose("options.track_num_start = %d", options.track_num_start);
     verbose("options.track_num_end = %d", options.track_num_end);
     verbose("options.input_is_raw = %d", options.input_is_raw);
+    verbose("options.shard_idx = %d", options.shard_idx);
+    verbose("options.shard_cnt = %d", options.shard_cnt);
+    verbose("options.manifest_file_name = %s", options.manifest_file_name);
     {
         char s[MAX_CHANNELS * 16];
         char *s_end;
@@ -1248,6 +2570,7 @@ static void dump_options(void)
         verbose("options.dc_offset = %s", s);
     }
     verbose("options.high_pass_filter_enabled = %d", options.high_pass_filter_enabled);
+    verbose("options.high_pass_corner = %f", options.high_pass_corner);
     verbose("options.verbose = %d", options.verbose);
     verbose("options.in_sfinfo.samplerate = %d", options.in_sfinfo.samplerate);
     verbose("options.in_sfinfo.channels = %d", options.in_sfinfo.channels);
@@ -1302,924 +2625,6019 @@ static const char *render_frame_idx_as_sec(char *s, sf_count_t frame_idx)
     return s;
 }
 
-/** Determines if at least one of the channels in the current frame has
-    a RMS level above the SNR threshold. Uses @a state.x_sq_ttl and @a
-    state.n_x_nf_sq to make comparisons.
-    
-    @return @c TRUE if at least one of the channels in current frame has
-    RMS level above SNR; @c FALSE if all channels in current frame
-    contain noise or silence. */
-static int we_have_signal(void)
+/** Returns a monotonic clock reading for --profile and --trace, in
+    nanoseconds. */
+static int64_t prof_clock(void)
 {
-    /* res: Return result */
-    /* c: Current channel iteration variable */
-    int res = FALSE;
-    int c;
-    
-    for(c = 0; !res && c < state.numchannels; c++)
-    {
-        res = state.n_x_nf_sq < state.x_sq_ttl[c];
-    }
-    return res;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
-/** Prints the cuts file header (if enabled) */
-static void print_cuts_header(void)
+/** With --profile, counts another frame and decides whether its stages
+    are to be timed (one frame in #PROFILE_SAMPLE_PERIOD). Call this
+    once per processing cycle, before the frame is handled. */
+static void prof_next_frame(void)
 {
-    if(!options.no_cuts_file_header && state.cuts_file)
+    if(options.profile)
     {
-        char *start_s = NULL;
-        char *end_s = NULL;
-        char *duration_s = NULL;
-
-        switch(options.cut_point_format)
-        {   
-            case CPF_FRAME_INDEX:
-                start_s = "start_frame";
-                end_s = "end_frame";
-                duration_s = "duration_frames";
-                break;
-            case CPF_TIME_INDEX:
-                start_s = "start_time";
-                end_s = "end_time";
-                duration_s = "duration_time";
-                break;
-            case CPF_SEC_INDEX:
-                start_s = "start_sec";
-                end_s = "end_sec";
-                duration_s = "duration_secs";
-                break;
-        }
-        
-        fprintf(state.cuts_file, 
-           /*00000000001111111111222222222233333333334444444444555555555566666666667777777777*/
-           /*01234567890123456789012345678901234567890123456789012345678901234567890123456789*/
-           /*track_num   start_frame     end_frame       duration_frames     name            */
-           /*1               2147483647      2147483647          2147483647                  */
-           /*track_num   start_time      end_time        duration_time       name            */
-           /*1           hh:mm:ss.sssss  hh:mm:ss.sssss      hh:mm:ss.sssss                  */
-           /*track_num   start_sec       end_sec         duration_secs       name            */
-           /*1             ssssss.sssss    ssssss.sssss        ssssss.sssss                  */
-            "track_num   %-16s"          "%-16s"          "%-20s%s\n",
-            start_s, end_s, duration_s,
-            options.track_names_file_name ? "name" : "");
-        if(ferror(state.cuts_file))
+        state.prof.frames++;
+        state.prof.sampled = (state.prof.frames & (PROFILE_SAMPLE_PERIOD - 1)) == 0;
+        state.prof.sampled_frames += state.prof.sampled;
+        state.prof.nested_ns = 0;
+        if(state.prof.perf_cnt)
         {
-            error(EXIT_FAILURE, errno, "Unable to write header to cuts file `%s'",
-                options.cuts_file_name);
+            memset(state.prof.perf_nested, 0, sizeof(state.prof.perf_nested));
         }
     }
 }
 
-
-/** Writes cutting parameters for current track to the cuts file. */
-static void print_track_cut(void)
+/** Opens the hardware performance counters for --profile-counters, as
+    one group so that they can all be read with a single system call.
+    Only events in user space are counted, which is usually permitted
+    for unprivileged users. Counters that can't be opened (because the
+    CPU lacks them, we're running in a virtual machine, or the system
+    forbids it) are left out; if none can be, a warning is given and
+    profiling carries on with timings only. */
+static void perf_open_counters(void)
 {
-    if(state.cuts_file)
+#ifdef __linux__
+    /* config: Event codes for each counter */
+    /* attr: Attributes of the counter being opened */
+    /* open_errno: Reason the first counter that couldn't be opened failed */
+    static const uint64_t config[PCT_COUNT] =
     {
-        char start_s[TIMECODE_STR_SZ];
-        char end_s[TIMECODE_STR_SZ];
-        char duration_s[TIMECODE_STR_SZ];
-    
-        sf_count_t duration = state.cur_frame_pos - state.cur_track_start;
-        switch(options.cut_point_format)
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+    struct perf_event_attr attr;
+    int open_errno = 0;
+    int k;
+
+    for(k = 0; k < PCT_COUNT; k++)
+    {
+        /* fd: Descriptor of new counter */
+        int fd;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config[k];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP
+            | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1,
+            state.prof.perf_cnt ? state.prof.perf_fd : -1, 0);
+        if(fd < 0)
         {
-            case CPF_FRAME_INDEX:
-                snprintf(start_s, TIMECODE_STR_SZ, "%lld", state.cur_track_start);
-                snprintf(end_s, TIMECODE_STR_SZ, "%lld", state.cur_frame_pos);
-                snprintf(duration_s, TIMECODE_STR_SZ, "%lld", duration);
-                break;
-            case CPF_TIME_INDEX:
-                render_frame_idx_as_timecode(start_s, state.cur_track_start);
-                render_frame_idx_as_timecode(end_s, state.cur_frame_pos);
-                render_frame_idx_as_timecode(duration_s, duration);
-                break;
-            case CPF_SEC_INDEX:
-                render_frame_idx_as_sec(start_s, state.cur_track_start);
-                render_frame_idx_as_sec(end_s, state.cur_frame_pos);
-                render_frame_idx_as_sec(duration_s, duration);
-                break;
+            open_errno = open_errno ? open_errno : errno;
         }
-    
-        fprintf(state.cuts_file, "%10d  %14s  %14s  %18s  %s\n",
-            state.cur_track_num, start_s, end_s, duration_s,
-            state.cur_track_name ? state.cur_track_name : "");
-        if(ferror(state.cuts_file))
+        else
         {
-            error(EXIT_FAILURE, errno, "Unable to write entry to cuts file `%s'",
-                options.cuts_file_name);
+            if(!state.prof.perf_cnt)
+            {
+                state.prof.perf_fd = fd;
+            }
+            state.prof.perf_kind[state.prof.perf_cnt++] = k;
         }
     }
+    if(!state.prof.perf_cnt)
+    {
+        error(0, open_errno, "warning: hardware performance counters are unavailable; "
+            "profiling without them");
+    }
+    verbose("Opened %d of %d hardware performance counters", state.prof.perf_cnt, PCT_COUNT);
+#else
+    error(0, 0, "warning: hardware performance counters aren't supported on this platform; "
+        "profiling without them");
+#endif
 }
 
-/** Advances head/tail/central queue pointers in sq_buf[] and main_buf[]
-    by one frame, wrapping them around as necessary. */
-static void advance_buf_ptrs(void)
+/** Reads the hardware performance counters into @a ctr, indexed by
+    #perf_counter_t (counters that aren't available read as zero). */
+static void perf_read_counters(uint64_t *ctr)
 {
-    state.main_buf_head = state.main_buf_tail;
-    state.sq_buf_head = state.sq_buf_tail;
-    state.main_buf_tail += state.numchannels;
-    state.main_buf_cen += state.numchannels;
-    state.sq_buf_tail += state.numchannels;
-    state.sq_buf_cen += state.numchannels;
-    if(state.main_buf_tail >= state.main_buf_edge)
-    {
-        state.main_buf_tail = state.main_buf;
-    }
-    if(state.main_buf_cen >= state.main_buf_edge)
+    /* buf: Number of counters, time enabled, time running, then the counts */
+    uint64_t buf[3 + PCT_COUNT];
+    int i;
+
+    if(read(state.prof.perf_fd, buf, sizeof(buf)) < (ssize_t)(sizeof(uint64_t) * (3 + state.prof.perf_cnt)))
     {
-        state.main_buf_cen = state.main_buf;
+        error(EXIT_FAILURE, errno, "Unable to read hardware performance counters");
     }
-    if(state.sq_buf_tail >= state.sq_buf_edge)
+    if(buf[2] < buf[1])
     {
-        state.sq_buf_tail = state.sq_buf;
+        state.prof.perf_multiplexed = TRUE;
     }
-    if(state.sq_buf_cen >= state.sq_buf_edge)
+    memset(ctr, 0, sizeof(uint64_t) * PCT_COUNT);
+    for(i = 0; i < state.prof.perf_cnt; i++)
     {
-        state.sq_buf_cen = state.sq_buf;
+        ctr[state.prof.perf_kind[i]] = buf[3 + i];
     }
 }
 
-/** Compensates the newly-inserted head frame in the main buffer for DC
-    offset (if specified), runs it through the high-pass filter (if
-    enabled),  also updates @c sq_buf[] (for computing the running RMS
-    level). @a state.main_buf_head[] should point to the sample to be
-    processed. Call this function once per processing cycle. */
-static void filter_new_frame(void)
+/** Measures how long it takes to read the clock (and the hardware
+    counters, if in use), so that this can be taken back out of each
+    stage. The stages are so short that they would otherwise be
+    overstated considerably. */
+static void prof_calibrate(void)
 {
-    /* c: Current channel during loop iteration */
-    int c;
-
-    for(c = 0; c < state.numchannels; c++)
+    /* i: Attempt counter */
+    /* t0, t1: Consecutive clock readings */
+    /* c0, c1: Counter readings either side of two clock readings */
+    int i;
+    int k;
+    int64_t t0;
+    int64_t t1;
+    uint64_t c0[PCT_COUNT];
+    uint64_t c1[PCT_COUNT];
+
+    state.prof.clock_ns = INT64_MAX;
+    for(i = 0; i < 1000; i++)
     {
-        state.x_sq_ttl[c] -= state.sq_buf_head[c];
-        state.main_buf_head[c] += options.dc_offset[c];
-        state.hpf_out[c] = state.alpha * (state.main_buf_head[c] - state.hpf_prev_rej[c]);
-        state.hpf_rej[c] = state.main_buf_head[c] - state.hpf_out[c];
-        state.hpf_prev_out[c] = state.hpf_out[c];
-        state.hpf_prev_rej[c] = state.hpf_rej[c];
-        if(options.high_pass_filter_enabled)
+        t0 = prof_clock();
+        t1 = prof_clock();
+        if(t1 - t0 < state.prof.clock_ns)
         {
-            /* While we still compute HPF output anyway, it remains
-               "on the side" unless the user has actually asked for
-               HPF to be enabled, in which case we munge the audio.
-               This allows analyser to compute real DC offset. */
-            state.main_buf_head[c] = state.hpf_out[c];
+            state.prof.clock_ns = t1 - t0;
         }
-        else
+    }
+    if(state.prof.perf_cnt)
+    {
+        /* The same sequence of calls as around an empty stage */
+        memset(state.prof.perf_probe, 0xff, sizeof(state.prof.perf_probe));
+        for(i = 0; i < 100; i++)
         {
-            /* Collect residuals of low frequency components to compute DC offset */
-            state.hpf_rej_ttl[c] += state.hpf_rej[c];
+            perf_read_counters(c0);
+            t0 = prof_clock();
+            t1 = prof_clock();
+            perf_read_counters(c1);
+            for(k = 0; k < PCT_COUNT; k++)
+            {
+                if(c1[k] - c0[k] < state.prof.perf_probe[k])
+                {
+                    state.prof.perf_probe[k] = c1[k] - c0[k];
+                }
+            }
         }
-        state.sq_buf_head[c] = state.main_buf_head[c] * state.main_buf_head[c];
-        state.x_sq_ttl[c] += state.sq_buf_head[c];
     }
-    state.frames_proc_ttl++;
 }
 
-/** Computes running RMS level for the newly-inserted head frame in the
-    main buffer. @a state.main_buf_head[] should point to the sample to
-    be processed. x_sq_ttl[] should be already updated through
-    #filter_new_frame. Call this function once per processing cycle. */
-static void analyse_new_frame(void)
+/** Returns non-zero if @a stage is only timed on a sample of frames;
+    the others happen too rarely to sample, so are timed every time. */
+static int prof_stage_sampled(prof_stage_t stage)
 {
-    /* c: Current channel during loop iteration */
-    int c;
+    return stage == PST_FILTER || stage == PST_DETECT;
+}
 
-    for(c = 0; c < state.numchannels; c++)
+/** Marks the start of a per-frame stage.
+
+    @return Clock reading to pass to #prof_stage_end if the current
+    frame is being timed; zero otherwise. */
+static int64_t prof_stage_begin(prof_stage_t stage)
+{
+    if(!state.prof.sampled)
     {
-        state.cur_rms[c] = sqrt(state.x_sq_ttl[c] / (double)state.rms_window_len);
-        state.rms_ttl[c] += state.cur_rms[c];
-        state.min_rms[c] = fmin(state.min_rms[c], state.cur_rms[c]);
-        state.max_rms[c] = fmax(state.max_rms[c], state.cur_rms[c]);
-        state.pos_peak[c] = fmax(state.pos_peak[c], state.main_buf_cen[c]);
-        state.neg_peak[c] = fmin(state.neg_peak[c], state.main_buf_cen[c]);
+        return 0;
+    }
+    if(state.prof.perf_cnt)
+    {
+        state.prof.perf_outer_ns[stage] = prof_clock();
+        perf_read_counters(state.prof.perf_begin[stage]);
+    }
+    return prof_clock();
+}
+
+/** Adds the events counted since @a stage began to its totals. If @a
+    nested is set, they're also noted for taking back out of the
+    detection stage that encloses it. */
+static void prof_count_stage(prof_stage_t stage, int nested)
+{
+    /* ctr: Current counter readings */
+    /* n: Events counted in this stage */
+    uint64_t ctr[PCT_COUNT];
+    uint64_t n;
+    int k;
+
+    perf_read_counters(ctr);
+    for(k = 0; k < PCT_COUNT; k++)
+    {
+        n = ctr[k] - state.prof.perf_begin[stage][k];
+        if(nested)
+        {
+            state.prof.perf_nested[k] += n;
+        }
+        else if(stage == PST_DETECT)
+        {
+            n = (n > state.prof.perf_nested[k]) ? n - state.prof.perf_nested[k] : 0;
+        }
+        n = (n > state.prof.perf_probe[k]) ? n - state.prof.perf_probe[k] : 0;
+        state.prof.stage_ctr[stage][k] += n;
+    }
+}
+
+/** Charges the time since @a t0 (from #prof_stage_begin) to @a stage.
+    Writes and track events happen within the detection stage, so their
+    time is taken back out of it. */
+static void prof_stage_end(prof_stage_t stage, int64_t t0)
+{
+    if(t0)
+    {
+        /* dt: Time spent in this stage, including one clock reading */
+        int64_t dt = prof_clock() - t0;
+
+        if(state.prof.perf_cnt)
+        {
+            prof_count_stage(stage, FALSE);
+        }
+        if(stage == PST_DETECT)
+        {
+            dt -= state.prof.nested_ns;
+        }
+        dt -= state.prof.clock_ns;
+        state.prof.stage_ns[stage] += (dt > 0) ? dt : 0;
+    }
+}
+
+/** Marks the start of an infrequent event: a block of frames being
+    read or written, or a track being started or finished. These are too
+    few to sample, so they're timed every time. Events don't nest; any
+    frames written while a track is started or finished are charged to
+    that rather than to #PST_WRITE.
+
+    @return Clock reading to pass to #prof_event_end; zero if the event
+    isn't being timed. */
+static int64_t prof_event_begin(prof_stage_t stage)
+{
+    if(!options.profile || state.prof.in_event)
+    {
+        return 0;
+    }
+    state.prof.in_event = TRUE;
+    state.prof.event_sampled = state.prof.sampled;
+    state.prof.sampled = FALSE;
+    if(state.prof.perf_cnt)
+    {
+        state.prof.perf_outer_ns[stage] = prof_clock();
+        perf_read_counters(state.prof.perf_begin[stage]);
+    }
+    return prof_clock();
+}
+
+/** Records that a track has been completed, along with the time it
+    took since its first frame was seen. */
+static void prof_add_track_latency(void)
+{
+    if(state.prof.tracks == state.prof.track_latency_alloc)
+    {
+        state.prof.track_latency_alloc = state.prof.track_latency_alloc
+            ? state.prof.track_latency_alloc * 2 : 64;
+        state.prof.track_latency = counted_realloc(state.prof.track_latency,
+            sizeof(double) * state.prof.track_latency_alloc);
+        if(!state.prof.track_latency)
+        {
+            error(EXIT_FAILURE, errno, "Unable to allocate memory for profile");
+        }
+    }
+    state.prof.track_latency[state.prof.tracks++] =
+        (prof_clock() - state.prof.track_start_ns) / 1e9;
+}
+
+/** Charges the time since @a t0 (from #prof_event_begin) to @a stage.
+    Everything but reading happens within the detection stage, so its
+    time is taken back out of that. */
+static void prof_event_end(prof_stage_t stage, int64_t t0)
+{
+    if(t0)
+    {
+        /* dt: Time spent in this event */
+        /* nested: Set if the event happened within the detection stage */
+        int64_t dt = prof_clock() - t0;
+        int nested = stage != PST_DECODE;
+
+        if(state.prof.perf_cnt)
+        {
+            prof_count_stage(stage, nested);
+        }
+        state.prof.sampled = state.prof.event_sampled;
+        state.prof.in_event = FALSE;
+        state.prof.stage_ns[stage] += dt;
+        if(nested)
+        {
+            /* Reading the counters either side also delays the enclosing stage */
+            state.prof.nested_ns += state.prof.perf_cnt
+                ? prof_clock() - state.prof.perf_outer_ns[stage] : dt;
+        }
+    }
+}
+
+/** Rounds @a sz up to a whole number of #ARENA_ALIGN units. */
+static sf_count_t arena_round(sf_count_t sz)
+{
+    return (sz + ARENA_ALIGN - 1) & ~(sf_count_t)(ARENA_ALIGN - 1);
+}
+
+/** Maps the arena that the job's long-lived buffers are carved out of,
+    large enough for @a sz bytes. Large arenas are backed by huge pages
+    where possible, to cut TLB misses as the window queues and lead-in
+    buffer are swept through: explicitly reserved ones (MAP_HUGETLB) if
+    the system has any free, otherwise transparent ones (MADV_HUGEPAGE),
+    for which the mapping is aligned to a huge page boundary. The memory
+    starts out zeroed.
+
+    @param max_sz Largest the mapping may be made, when rounding up to
+    huge pages; zero if there's no limit */
+static void init_arena(sf_count_t sz, sf_count_t max_sz)
+{
+    /* huge_sz: Size rounded up to whole huge pages */
+    /* map: Start of the mapping, before any alignment */
+    /* map_sz: Size of the mapping, before any alignment */
+    sf_count_t huge_sz = (sz + HUGE_PAGE_SZ - 1) & ~(sf_count_t)(HUGE_PAGE_SZ - 1);
+    unsigned char *map;
+    size_t map_sz;
+
+    state.arena.size = sz;
+    if(sz == 0)
+    {
+        return;
+    }
+#ifdef MAP_HUGETLB
+    if(sz >= HUGE_PAGE_SZ && (!max_sz || huge_sz <= max_sz))
+    {
+        map = mmap(NULL, huge_sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(map != MAP_FAILED)
+        {
+            state.arena.base = map;
+            state.arena.size = huge_sz;
+            verbose("Arena is %lld bytes of reserved huge pages", (long long)huge_sz);
+            return;
+        }
+    }
+#endif
+    map_sz = sz;
+#ifdef MADV_HUGEPAGE
+    map_sz += (sz >= HUGE_PAGE_SZ) ? HUGE_PAGE_SZ : 0;
+#endif
+    map = mmap(NULL, map_sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(map == MAP_FAILED)
+    {
+        error(EXIT_FAILURE, errno, "Unable to allocate %lld bytes of memory for buffers", (long long)sz);
+    }
+    state.arena.base = map;
+#ifdef MADV_HUGEPAGE
+    if(sz >= HUGE_PAGE_SZ)
+    {
+        /* head: Bytes before the first huge page boundary, trimmed off with the tail */
+        size_t head = (HUGE_PAGE_SZ - (uintptr_t)map % HUGE_PAGE_SZ) % HUGE_PAGE_SZ;
+
+        state.arena.base = map + head;
+        if(head)
+        {
+            munmap(map, head);
+        }
+        munmap(state.arena.base + sz, map_sz - head - sz);
+        if(madvise(state.arena.base, sz, MADV_HUGEPAGE) == 0)
+        {
+            verbose("Arena is %lld bytes, backed by transparent huge pages where available",
+                (long long)sz);
+            return;
+        }
+    }
+#endif
+    verbose("Arena is %lld bytes", (long long)sz);
+}
+
+/** Carves @a sz bytes, aligned to #ARENA_ALIGN, out of the arena. The
+    arena is sized up front by #plan_memory for everything that will be
+    asked of it, so running out is a bug. */
+static void *arena_alloc(sf_count_t sz)
+{
+    /* p: Return result */
+    void *p = state.arena.base + state.arena.used;
+
+    sz = arena_round(sz);
+    if(state.arena.used + sz > state.arena.size)
+    {
+        error(EXIT_FAILURE, 0, "Internal error: buffer arena is exhausted");
+    }
+    state.arena.used += sz;
+    return p;
+}
+
+/** Opens the trace file for --trace and allocates the event ring. The
+    file is opened now, before any change of working directory, so that
+    a bad file name is reported straight away; it's written by
+    #write_trace_file on exit. */
+static void init_trace(void)
+{
+    state.trace.file = fopen(options.trace_file_name, "w");
+    if(!state.trace.file)
+    {
+        error(EXIT_FAILURE, errno, "Unable to create trace file `%s'", options.trace_file_name);
+    }
+    state.trace.ring = arena_alloc(sizeof(trace_event_t) * state.trace.ring_len);
+    state.trace.start_ns = prof_clock();
+    verbose("Recording trace to `%s'", options.trace_file_name);
+}
+
+/** Adds an event to the trace ring, overwriting the oldest if full.
+
+    @return Event to fill in. */
+static trace_event_t *trace_add(const char *name, const char *cat, char ph, int64_t ts_ns)
+{
+    trace_event_t *ev = &state.trace.ring[state.trace.cnt++ & (state.trace.ring_len - 1)];
+
+    ev->name = name;
+    ev->cat = cat;
+    ev->ph = ph;
+    ev->ts_ns = ts_ns;
+    ev->dur_ns = 0;
+    ev->frame = state.cur_frame_pos;
+    ev->arg_name = NULL;
+    ev->prev = NULL;
+    return ev;
+}
+
+/** Marks the start of a span with --trace.
+
+    @return Clock reading to pass to #trace_end, or zero if not tracing. */
+static int64_t trace_begin(void)
+{
+    return state.trace.ring ? prof_clock() : 0;
+}
+
+/** Records a span that began at @a t0 (from #trace_begin), with an
+    optional integer argument @a arg_name. */
+static void trace_end(const char *name, const char *cat, int64_t t0, const char *arg_name, int64_t arg)
+{
+    if(t0)
+    {
+        /* t1: Clock reading at end of span */
+        /* ev: Event recorded */
+        int64_t t1 = prof_clock();
+        trace_event_t *ev = trace_add(name, cat, 'X', t0);
+
+        ev->dur_ns = t1 - t0;
+        ev->arg_name = arg_name;
+        ev->arg = arg;
+    }
+}
+
+/** Closes the span covering the current block of frames, if any, and
+    starts the next. */
+static void trace_end_block(void)
+{
+    /* t: Clock reading at end of block */
+    /* ev: Event recorded */
+    int64_t t = prof_clock();
+    trace_event_t *ev;
+
+    if(state.trace.block_frames > 0)
+    {
+        ev = trace_add("frames", "pipeline", 'X', state.trace.block_ns);
+        ev->dur_ns = t - state.trace.block_ns;
+        ev->frame = state.trace.block_frame;
+        ev->arg_name = "frames";
+        ev->arg = state.trace.block_frames;
+    }
+    state.trace.block_ns = t;
+    state.trace.block_frame = state.cur_frame_pos;
+    state.trace.block_frames = 0;
+}
+
+/** With --trace, counts another frame processed by the main loop,
+    recording a span once every #TRACE_BLOCK_LEN frames. */
+static void trace_next_frame(void)
+{
+    if(state.trace.ring && ++state.trace.block_frames == TRACE_BLOCK_LEN)
+    {
+        trace_end_block();
+    }
+}
+
+/** Records a change of cut context, from @a prev to the current one. */
+static void trace_cut_context(cut_context_t prev)
+{
+    static const char *cctx_s[] = { "silence", "track", "track_starting", "track_ending" };
+
+    trace_add(cctx_s[state.cut.context], "context", 'i', prof_clock())->prev = cctx_s[prev];
+}
+
+/** Writes @a s to @a file as a JSON string literal. */
+static void write_json_string(FILE *file, const char *s)
+{
+    fputc('"', file);
+    for(; *s; s++)
+    {
+        if(*s == '"' || *s == '\\')
+        {
+            fprintf(file, "\\%c", *s);
+        }
+        else if((unsigned char)*s < 0x20)
+        {
+            fprintf(file, "\\u%04x", (unsigned char)*s);
+        }
+        else
+        {
+            fputc(*s, file);
+        }
+    }
+    fputc('"', file);
+}
+
+/** Writes the events in the trace ring to the trace file, oldest first,
+    in Chrome's trace-event JSON format (timestamps in microseconds). */
+static void write_trace_file(void)
+{
+    /* first: Sequence number of oldest event still in the ring */
+    /* pid: Process ID, to group the events by */
+    uint64_t first = (state.trace.cnt > (uint64_t)state.trace.ring_len)
+        ? state.trace.cnt - state.trace.ring_len : 0;
+    uint64_t i;
+    int pid = getpid();
+
+    fprintf(state.trace.file, "{\"traceEvents\":[\n");
+    fprintf(state.trace.file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,"
+        "\"args\":{\"name\":\"trackcutter\"}},\n", pid);
+    fprintf(state.trace.file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,"
+        "\"args\":{\"name\":\"main\"}}", pid);
+    for(i = first; i < state.trace.cnt; i++)
+    {
+        trace_event_t *ev = &state.trace.ring[i & (state.trace.ring_len - 1)];
+
+        fprintf(state.trace.file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,",
+            ev->name, ev->cat, ev->ph, (ev->ts_ns - state.trace.start_ns) / 1e3);
+        if(ev->ph == 'X')
+        {
+            fprintf(state.trace.file, "\"dur\":%.3f,", ev->dur_ns / 1e3);
+        }
+        else
+        {
+            fprintf(state.trace.file, "\"s\":\"t\",");
+        }
+        fprintf(state.trace.file, "\"pid\":%d,\"tid\":1,\"args\":{\"frame\":%lld", pid, (long long)ev->frame);
+        if(ev->arg_name)
+        {
+            fprintf(state.trace.file, ",\"%s\":%lld", ev->arg_name, (long long)ev->arg);
+        }
+        if(ev->prev)
+        {
+            fprintf(state.trace.file, ",\"from\":\"%s\"", ev->prev);
+        }
+        fprintf(state.trace.file, "}}");
+    }
+    fprintf(state.trace.file, "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"input\":");
+    write_json_string(state.trace.file, options.in_file_name);
+    fprintf(state.trace.file, ",\"events_recorded\":%llu,\"events_dropped\":%llu}}\n",
+        (unsigned long long)state.trace.cnt, (unsigned long long)first);
+    if(fclose(state.trace.file) != 0)
+    {
+        error(EXIT_FAILURE, errno, "Unable to write trace file `%s'", options.trace_file_name);
+    }
+    verbose("Wrote %llu trace events to `%s'", (unsigned long long)(state.trace.cnt - first),
+        options.trace_file_name);
+}
+
+/** Reads a little-endian integer of @a n bytes. */
+static uint64_t get_le(const unsigned char *p, int n)
+{
+    uint64_t x = 0;
+
+    while(n--)
+    {
+        x = (x << 8) | p[n];
+    }
+    return x;
+}
+
+/** Stores a little-endian integer of @a n bytes. */
+static void put_le(unsigned char *p, int n, uint64_t x)
+{
+    while(n--)
+    {
+        *p++ = (unsigned char)x;
+        x >>= 8;
+    }
+}
+
+/** Creates the --energy-map file and writes its header. Like the trace
+    file, it's opened before any change of working directory, so that a
+    bad file name is reported straight away.
+
+    The file is text: a @c trackcutter-energy line with the format
+    version, then @c samplerate, @c channels, @c hop (frames per hop)
+    and @c start_frame (first frame of the first hop) lines, then one
+    line per hop giving the least and greatest RMS level (in dBFS) of
+    the loudest channel over the RMS window centred on each frame of the
+    hop. These are the levels the detector compares with the noise
+    floor, so a span is silent to the detector just when the greatest
+    level over its hops is below the floor. The last hop may be short. */
+static void init_energy_map(void)
+{
+    state.emap.file = fopen(options.energy_map_file_name, "w");
+    if(!state.emap.file)
+    {
+        error(EXIT_FAILURE, errno, "Unable to create energy map file `%s'",
+            options.energy_map_file_name);
+    }
+    fprintf(state.emap.file, "trackcutter-energy %d\n", ENERGY_MAP_VERSION);
+    fprintf(state.emap.file, "samplerate %d\n", state.samplerate);
+    fprintf(state.emap.file, "channels %d\n", state.numchannels);
+    fprintf(state.emap.file, "hop %d\n", state.rms_window_len);
+    fprintf(state.emap.file, "start_frame %lld\n", state.cur_frame_pos);
+    fprintf(state.emap.file, "# min_dbfs max_dbfs\n");
+    state.emap.hop_left = state.rms_window_len;
+    state.emap.lo = INFINITY;
+    state.emap.hi = 0.0;
+    verbose("Writing energy map to `%s'", options.energy_map_file_name);
+}
+
+/** Writes the levels of the current hop to the --energy-map file, and
+    starts the next. */
+static void energy_map_write_hop(void)
+{
+    /* scale: Converts a sum over the RMS window to a mean */
+    double scale = 1.0 / (double)state.rms_window_len;
+
+    fprintf(state.emap.file, "%.2f %.2f\n",
+        10.0 * log10(state.emap.lo * scale), 10.0 * log10(state.emap.hi * scale));
+    state.emap.hop_cnt++;
+    state.emap.hop_left = state.rms_window_len;
+    state.emap.lo = INFINITY;
+    state.emap.hi = 0.0;
+}
+
+/** With --energy-map, takes the energy of the loudest channel in the
+    current frame into the current hop. */
+static void energy_map_next_frame(void)
+{
+    /* e: Energy of the loudest channel */
+    /* c: Current channel in iterative loops */
+    double e = 0.0;
+    int c;
+
+    if(!state.emap.file)
+    {
+        return;
+    }
+    for(c = 0; c < state.numchannels; c++)
+    {
+        if(state.x_sq_ttl[c] > e)
+        {
+            e = state.x_sq_ttl[c];
+        }
+    }
+    if(e < state.emap.lo)
+    {
+        state.emap.lo = e;
+    }
+    if(e > state.emap.hi)
+    {
+        state.emap.hi = e;
+    }
+    if(--state.emap.hop_left == 0)
+    {
+        energy_map_write_hop();
+    }
+}
+
+/** Writes out the last (short) hop to the --energy-map file, if any,
+    and closes it. */
+static void finish_energy_map(void)
+{
+    if(state.emap.hop_left < state.rms_window_len)
+    {
+        energy_map_write_hop();
+    }
+    if(ferror(state.emap.file) | fclose(state.emap.file))
+    {
+        error(EXIT_FAILURE, errno, "Unable to write energy map file `%s'",
+            options.energy_map_file_name);
+    }
+    state.emap.file = NULL;
+    verbose("Wrote %lld hops to energy map `%s'", state.emap.hop_cnt, options.energy_map_file_name);
+}
+
+/** Handles SIGUSR1 by asking for a progress report at the next check. */
+static void progress_sigusr1(int sig)
+{
+    (void)sig;
+    progress_requested = TRUE;
+}
+
+/** Installs the handler for SIGUSR1, whether or not --progress was
+    given, so that a long run can always be asked how far it has got.
+    This is done before any input is read, as the signal's default
+    action would terminate the program; a report asked for early is
+    given once #init_progress has run. */
+static void install_progress_handler(void)
+{
+    /* sa: Action to take on SIGUSR1 */
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = progress_sigusr1;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+}
+
+/** Sets up progress reporting, once the position and extent of the
+    frames to be processed are known. */
+static void init_progress(void)
+{
+    sf_count_t total = state.frames_remaining;
+
+    if(options.shard_cnt && options.shard_idx < options.shard_cnt)
+    {
+        total = state.shard_slice_end - state.cur_frame_pos;
+    }
+    else if(options.in_sfinfo.frames > 0 && options.in_sfinfo.frames != SF_COUNT_MAX
+        && total > options.in_sfinfo.frames - state.cur_frame_pos)
+    {
+        total = options.in_sfinfo.frames - state.cur_frame_pos;
+    }
+    state.progress.total_frames = (total > 0 && total != SF_COUNT_MAX) ? total : 0;
+    state.progress.first_frame = state.cur_frame_pos;
+    state.progress.countdown = PROGRESS_CHECK_LEN;
+    state.progress.start_ns = prof_clock();
+    state.progress.tty = isatty(STDERR_FILENO);
+    state.progress.period_ns = (int64_t)(state.progress.tty ? PROGRESS_TTY_PERIOD : PROGRESS_LOG_PERIOD)
+        * 1000000;
+    state.progress.next_ns = state.progress.start_ns + state.progress.period_ns;
+}
+
+/** Prints a progress report to standard error: the current position,
+    the proportion done (if the end is known), how many times faster
+    than real time the recording is being processed, the estimated time
+    remaining and the number of tracks found so far. With --progress on
+    a terminal, the report is redrawn in place unless @a newline is set. */
+static void print_progress(int newline)
+{
+    /* pos_s, end_s: Current and final positions, rendered as timecodes */
+    /* done: Frames processed so far */
+    /* elapsed: Seconds since processing began */
+    /* rate: Frames processed per second */
+    char pos_s[TIMECODE_STR_SZ];
+    char end_s[TIMECODE_STR_SZ];
+    sf_count_t done = state.cur_frame_pos - state.progress.first_frame;
+    double elapsed = (prof_clock() - state.progress.start_ns) / 1e9;
+    double rate = (elapsed > 0.0) ? (double)done / elapsed : 0.0;
+    int in_place = options.progress && state.progress.tty;
+
+    if(state.progress.total_frames && done > state.progress.total_frames)
+    {
+        /* Don't count the silence padded out beyond the end */
+        done = state.progress.total_frames;
+    }
+    fprintf(stderr, "%s%s: %s", in_place ? "\r" : "", program_invocation_short_name,
+        render_frame_idx_as_timecode(pos_s, state.progress.first_frame + done));
+    if(state.progress.total_frames)
+    {
+        fprintf(stderr, " of %s (%.1f%%)",
+            render_frame_idx_as_timecode(end_s, state.progress.first_frame + state.progress.total_frames),
+            100.0 * (double)done / (double)state.progress.total_frames);
+    }
+    fprintf(stderr, ", %.1fx realtime", rate / (double)state.samplerate);
+    if(state.progress.total_frames && rate > 0.0)
+    {
+        /* eta: Seconds remaining */
+        int eta = (done < state.progress.total_frames)
+            ? (int)ceil((double)(state.progress.total_frames - done) / rate) : 0;
+
+        fprintf(stderr, ", ETA %d:%02d:%02d", eta / 3600, (eta / 60) % 60, eta % 60);
+    }
+    if(options.task == TCT_CUTTING && !options.batch && !options.shard_cnt)
+    {
+        /* tracks: Tracks completed, plus the one in progress */
+        int tracks = state.cut.track_num - 1
+            + (state.cut.context == CCTX_TRACK || state.cut.context == CCTX_TRACK_ENDING);
+
+        fprintf(stderr, ", %d track%s", tracks, (tracks == 1) ? "" : "s");
+    }
+    fprintf(stderr, "%s%s", in_place ? "\033[K" : "", newline ? "\n" : "");
+}
+
+/** Checks whether a progress report is due, every #PROGRESS_CHECK_LEN
+    frames: either periodically with --progress, or because SIGUSR1 was
+    received. */
+static void progress_tick(void)
+{
+    /* now: Current clock reading */
+    int64_t now;
+
+    state.progress.countdown = PROGRESS_CHECK_LEN;
+    if(progress_requested)
+    {
+        progress_requested = FALSE;
+        print_progress(TRUE);
+    }
+    else if(options.progress && (now = prof_clock()) >= state.progress.next_ns)
+    {
+        state.progress.next_ns = now + state.progress.period_ns;
+        print_progress(!state.progress.tty);
+    }
+}
+
+/** Counts another frame processed by the main loop, checking every
+    #PROGRESS_CHECK_LEN frames whether to report progress. */
+static void progress_next_frame(void)
+{
+    if(--state.progress.countdown == 0)
+    {
+        progress_tick();
+    }
+}
+
+/** With --progress, prints a final report once processing is complete. */
+static void finish_progress(void)
+{
+    if(options.progress)
+    {
+        print_progress(TRUE);
+    }
+}
+
+/** Determines if at least one of the channels in the current frame has
+    a RMS level above the SNR threshold. Uses @a state.x_sq_ttl and @a
+    state.n_x_nf_sq to make comparisons.
+    
+    @return @c TRUE if at least one of the channels in current frame has
+    RMS level above SNR; @c FALSE if all channels in current frame
+    contain noise or silence. */
+static int we_have_signal(void)
+{
+    /* res: Return result */
+    /* c: Current channel iteration variable */
+    int res = FALSE;
+    int c;
+    
+    for(c = 0; !res && c < state.numchannels; c++)
+    {
+        res = state.n_x_nf_sq < state.x_sq_ttl[c];
+    }
+    return res;
+}
+
+/** Creates the --decision-trace file and writes its header. It's opened
+    before any change of working directory, like the energy map.
+
+    The file is binary, all fields little-endian. The header
+    (#DECISION_TRACE_HDR_SZ bytes) holds the magic number
+    #DECISION_TRACE_MAGIC, then the format version, sampling rate, number
+    of channels, hop length and RMS window length (each 32 bits
+    unsigned), then the frame index the trace starts at (64 bits). A
+    record follows for the first frame of every hop, and for every frame
+    on which the cut context changes, each of 24 bytes plus 8 per
+    channel:
+
+    - frame index (64-bit signed)
+    - cut context (8 bits, a #cut_context_t value)
+    - flags (8 bits): #DTF_SIGNAL if a channel is over the noise floor,
+      #DTF_EXEMPT if within an --exempt window, and #DTF_CHANGE if the
+      cut context changed on this frame
+    - two bytes of padding (zero)
+    - time to live of the cut context, in frames (32-bit signed)
+    - noise floor threshold, as a sum of squares over the RMS window
+      (IEEE 754 double)
+    - sum of squares over the RMS window of each channel (doubles)
+
+    The records are in frame order and all the same length, so a reader
+    can find a stretch of a long recording by binary search. */
+static void init_decision_trace(void)
+{
+    /* hdr: Header as written */
+    unsigned char hdr[DECISION_TRACE_HDR_SZ];
+
+    state.dtrace.file = fopen(options.decision_trace_file_name, "wb");
+    if(!state.dtrace.file)
+    {
+        error(EXIT_FAILURE, errno, "Unable to create decision trace file `%s'",
+            options.decision_trace_file_name);
+    }
+    setvbuf(state.dtrace.file, NULL, _IOFBF, DECISION_TRACE_BUF_SZ);
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, DECISION_TRACE_MAGIC, 4);
+    put_le(hdr + 4, 4, DECISION_TRACE_VERSION);
+    put_le(hdr + 8, 4, state.samplerate);
+    put_le(hdr + 12, 4, state.numchannels);
+    put_le(hdr + 16, 4, state.rms_window_len);
+    put_le(hdr + 20, 4, state.rms_window_len);
+    put_le(hdr + 24, 8, state.cur_frame_pos);
+    fwrite(hdr, 1, sizeof(hdr), state.dtrace.file);
+    state.dtrace.rec_sz = 24 + 8 * state.numchannels;
+    state.dtrace.hop_left = 1;
+    verbose("Writing decision trace to `%s'", options.decision_trace_file_name);
+}
+
+/** With --decision-trace, writes a record of the detector's state after
+    the current frame, if it starts a hop or the cut context has just
+    changed from @a prev. */
+static void decision_trace_next_frame(cut_context_t prev)
+{
+    /* rec: Record as written */
+    /* flags: Flags field of the record */
+    /* u: Bit pattern of a double being stored */
+    /* c: Current channel in iterative loops */
+    unsigned char rec[24 + 8 * MAX_CHANNELS];
+    int flags = 0;
+    uint64_t u;
+    int c;
+
+    if(!state.dtrace.file)
+    {
+        return;
+    }
+    if(--state.dtrace.hop_left > 0 && state.cut.context == prev)
+    {
+        return;
+    }
+    if(state.dtrace.hop_left == 0)
+    {
+        state.dtrace.hop_left = state.rms_window_len;
+    }
+    flags |= we_have_signal() ? DTF_SIGNAL : 0;
+    flags |= state.exempt_on ? DTF_EXEMPT : 0;
+    flags |= (state.cut.context != prev) ? DTF_CHANGE : 0;
+    put_le(rec, 8, state.cur_frame_pos);
+    rec[8] = (unsigned char)state.cut.context;
+    rec[9] = (unsigned char)flags;
+    rec[10] = rec[11] = 0;
+    put_le(rec + 12, 4, (uint32_t)state.cut.time_to_live);
+    memcpy(&u, &state.n_x_nf_sq, sizeof(u));
+    put_le(rec + 16, 8, u);
+    for(c = 0; c < state.numchannels; c++)
+    {
+        memcpy(&u, &state.x_sq_ttl[c], sizeof(u));
+        put_le(rec + 24 + 8 * c, 8, u);
+    }
+    fwrite(rec, 1, state.dtrace.rec_sz, state.dtrace.file);
+    state.dtrace.rec_cnt++;
+}
+
+/** Closes the --decision-trace file, reporting any failure to write it. */
+static void finish_decision_trace(void)
+{
+    if(ferror(state.dtrace.file) | fclose(state.dtrace.file))
+    {
+        error(EXIT_FAILURE, errno, "Unable to write decision trace file `%s'",
+            options.decision_trace_file_name);
+    }
+    state.dtrace.file = NULL;
+    verbose("Wrote %lld records to decision trace `%s'", state.dtrace.rec_cnt,
+        options.decision_trace_file_name);
+}
+
+/** Prints the cuts file header (if enabled) */
+static void print_cuts_header(void)
+{
+    if(!options.no_cuts_file_header && state.cuts_file)
+    {
+        char *start_s = NULL;
+        char *end_s = NULL;
+        char *duration_s = NULL;
+
+        switch(options.cut_point_format)
+        {   
+            case CPF_FRAME_INDEX:
+                start_s = "start_frame";
+                end_s = "end_frame";
+                duration_s = "duration_frames";
+                break;
+            case CPF_TIME_INDEX:
+                start_s = "start_time";
+                end_s = "end_time";
+                duration_s = "duration_time";
+                break;
+            case CPF_SEC_INDEX:
+                start_s = "start_sec";
+                end_s = "end_sec";
+                duration_s = "duration_secs";
+                break;
+        }
+        
+        fprintf(state.cuts_file, 
+           /*00000000001111111111222222222233333333334444444444555555555566666666667777777777*/
+           /*01234567890123456789012345678901234567890123456789012345678901234567890123456789*/
+           /*track_num   start_frame     end_frame       duration_frames     name            */
+           /*1               2147483647      2147483647          2147483647                  */
+           /*track_num   start_time      end_time        duration_time       name            */
+           /*1           hh:mm:ss.sssss  hh:mm:ss.sssss      hh:mm:ss.sssss                  */
+           /*track_num   start_sec       end_sec         duration_secs       name            */
+           /*1             ssssss.sssss    ssssss.sssss        ssssss.sssss                  */
+            "track_num   %-16s"          "%-16s"          "%-20s%s\n",
+            start_s, end_s, duration_s,
+            options.track_names_file_name ? "name" : "");
+        if(ferror(state.cuts_file))
+        {
+            error(EXIT_FAILURE, errno, "Unable to write header to cuts file `%s'",
+                options.cuts_file_name);
+        }
+    }
+}
+
+
+/** Writes a cuts file entry for a track spanning frame indices @a
+    start to @a end to @a file. */
+static void print_cut_entry(FILE *file, int track_num, sf_count_t start, sf_count_t end,
+    const char *name)
+{
+    char start_s[TIMECODE_STR_SZ];
+    char end_s[TIMECODE_STR_SZ];
+    char duration_s[TIMECODE_STR_SZ];
+
+    sf_count_t duration = end - start;
+    switch(options.cut_point_format)
+    {
+        case CPF_FRAME_INDEX:
+            snprintf(start_s, TIMECODE_STR_SZ, "%lld", start);
+            snprintf(end_s, TIMECODE_STR_SZ, "%lld", end);
+            snprintf(duration_s, TIMECODE_STR_SZ, "%lld", duration);
+            break;
+        case CPF_TIME_INDEX:
+            render_frame_idx_as_timecode(start_s, start);
+            render_frame_idx_as_timecode(end_s, end);
+            render_frame_idx_as_timecode(duration_s, duration);
+            break;
+        case CPF_SEC_INDEX:
+            render_frame_idx_as_sec(start_s, start);
+            render_frame_idx_as_sec(end_s, end);
+            render_frame_idx_as_sec(duration_s, duration);
+            break;
+    }
+
+    fprintf(file, "%10d  %14s  %14s  %18s  %s\n",
+        track_num, start_s, end_s, duration_s, name ? name : "");
+    if(ferror(file))
+    {
+        error(EXIT_FAILURE, errno, "Unable to write entry to cuts file `%s'",
+            options.cuts_file_name);
+    }
+}
+
+/** Writes cutting parameters for current track to the cuts file. */
+static void print_track_cut(void)
+{
+    if(state.cuts_file)
+    {
+        print_cut_entry(state.cuts_file, state.cut.track_num, state.cut.track_start,
+            state.cur_frame_pos, state.cur_track_name);
+    }
+}
+
+/** Writes the header of a shard partial-state file to the cuts file. */
+static void print_shard_header(void)
+{
+    fprintf(state.cuts_file, "trackcutter-shard %d\n", SHARD_FILE_VERSION);
+    fprintf(state.cuts_file, "shard %d %d\n", options.shard_idx, options.shard_cnt);
+    fprintf(state.cuts_file, "task %s\n", options.task == TCT_CUTTING ? "cutting" : "analysis");
+    fprintf(state.cuts_file, "samplerate %d\n", state.samplerate);
+    fprintf(state.cuts_file, "channels %d\n", state.numchannels);
+    fprintf(state.cuts_file, "frame_range %lld %lld\n", options.start_frame_idx, options.end_frame_idx);
+    if(options.task == TCT_CUTTING)
+    {
+        fprintf(state.cuts_file, "min_signal_len %d\n", state.min_signal_len);
+        fprintf(state.cuts_file, "min_silence_len %d\n", state.min_silence_len);
+        fprintf(state.cuts_file, "min_track_len %d\n", state.min_track_len);
+    }
+    fprintf(state.cuts_file, "slice_start %lld\n", state.shard_slice_start);
+    if(ferror(state.cuts_file))
+    {
+        error(EXIT_FAILURE, errno, "Unable to write header to partial-state file `%s'",
+            options.cuts_file_name);
+    }
+    state.shard_run_sig = -1;
+}
+
+/** Writes out the run of identical signal decisions collected so far
+    (if any) to the shard partial-state file. */
+static void flush_shard_run(void)
+{
+    if(state.shard_run_len > 0)
+    {
+        fprintf(state.cuts_file, "run %d %lld\n", state.shard_run_sig, state.shard_run_len);
+        if(ferror(state.cuts_file))
+        {
+            error(EXIT_FAILURE, errno, "Unable to write entry to partial-state file `%s'",
+                options.cuts_file_name);
+        }
+        state.shard_run_len = 0;
+    }
+}
+
+/** Records the signal decision for the current frame in shard mode.
+    Consecutive identical decisions are collapsed into a single run
+    descriptor, so a partial-state file only grows at signal/silence
+    boundaries. */
+static void record_shard_decision(void)
+{
+    /* sig: Signal decision for the current frame */
+    int sig = we_have_signal();
+
+    if(sig != state.shard_run_sig)
+    {
+        flush_shard_run();
+        state.shard_run_sig = sig;
+    }
+    state.shard_run_len++;
+}
+
+/** Writes one row of per-channel statistics to the shard partial-state
+    file. Values are printed in hexadecimal floating point notation so
+    they are carried over to --merge without rounding. */
+static void print_shard_stats_row(const char *key, const double *fields)
+{
+    int c;
+
+    fprintf(state.cuts_file, "%s", key);
+    for(c = 0; c < state.numchannels; c++)
+    {
+        fprintf(state.cuts_file, " %a", fields[c]);
+    }
+    fputc('\n', state.cuts_file);
+}
+
+/** Writes the trailer of a shard partial-state file: the end of the
+    slice, plus the accumulated statistics in analysis mode. */
+static void print_shard_trailer(void)
+{
+    /* c: Current channel in iterative loops */
+    int c;
+
+    flush_shard_run();
+    fprintf(state.cuts_file, "slice_end %lld\n", state.shard_slice_end);
+    if(options.task == TCT_ANALYSIS)
+    {
+        fprintf(state.cuts_file, "frames_read_ttl %lld\n", state.frames_read_ttl);
+        fprintf(state.cuts_file, "frames_proc_ttl %lld\n", state.frames_proc_ttl);
+        fprintf(state.cuts_file, "dc_acc");
+        for(c = 0; c < state.numchannels; c++)
+        {
+            fprintf(state.cuts_file, " %lld", (long long)state.dc_acc[c]);
+        }
+        fputc('\n', state.cuts_file);
+        print_shard_stats_row("rms_ttl", state.rms_ttl);
+        print_shard_stats_row("min_rms", state.min_rms);
+        print_shard_stats_row("max_rms", state.max_rms);
+        print_shard_stats_row("pos_peak", state.pos_peak);
+        print_shard_stats_row("neg_peak", state.neg_peak);
+    }
+    fprintf(state.cuts_file, "end\n");
+    if(fflush(state.cuts_file) != 0 || ferror(state.cuts_file))
+    {
+        error(EXIT_FAILURE, errno, "Unable to write trailer to partial-state file `%s'",
+            options.cuts_file_name);
+    }
+}
+
+/** Advances head/tail/central queue pointers in sq_buf[] and main_buf[]
+    by one frame, wrapping them around as necessary. */
+static void advance_buf_ptrs(void)
+{
+    state.main_buf_head = state.main_buf_tail;
+    state.sq_buf_head = state.sq_buf_tail;
+    state.main_buf_tail += state.numchannels;
+    state.main_buf_cen += state.numchannels;
+    state.sq_buf_tail += state.numchannels;
+    state.sq_buf_cen += state.numchannels;
+    if(state.main_buf_tail >= state.main_buf_edge)
+    {
+        state.main_buf_tail = state.main_buf;
+    }
+    if(state.main_buf_cen >= state.main_buf_edge)
+    {
+        state.main_buf_cen = state.main_buf;
+    }
+    if(state.sq_buf_tail >= state.sq_buf_edge)
+    {
+        state.sq_buf_tail = state.sq_buf;
+    }
+    if(state.sq_buf_cen >= state.sq_buf_edge)
+    {
+        state.sq_buf_cen = state.sq_buf;
+    }
+}
+
+/** Compensates the newly-inserted head frame in the main buffer for DC
+    offset (if specified), runs it through the high-pass filter (if
+    enabled),  also updates @c sq_buf[] (for computing the running RMS
+    level). The frame is first kept as read in @c raw_buf[], if the track
+    files are to be written otherwise (see --output-filter).
+    @a state.main_buf_head[] should point to the sample to be processed.
+    Call this function once per processing cycle. */
+static void filter_new_frame(void)
+{
+    /* c: Current channel during loop iteration */
+    int c;
+
+    if(state.raw_buf)
+    {
+        memcpy(state.raw_buf + (state.main_buf_head - state.main_buf), state.main_buf_head, state.frame_sz);
+    }
+    for(c = 0; c < state.numchannels; c++)
+    {
+        state.x_sq_ttl[c] -= state.sq_buf_head[c];
+        state.main_buf_head[c] += options.dc_offset[c];
+        if(options.high_pass_filter_enabled)
+        {
+            state.hpf_out[c] = state.alpha * (state.main_buf_head[c] - state.hpf_prev_rej[c]);
+            state.hpf_rej[c] = state.main_buf_head[c] - state.hpf_out[c];
+            state.hpf_prev_out[c] = state.hpf_out[c];
+            state.hpf_prev_rej[c] = state.hpf_rej[c];
+            state.main_buf_head[c] = state.hpf_out[c];
+        }
+        else if(options.task == TCT_ANALYSIS)
+        {
+            /* Sum the signal to compute DC offset. The sum is kept in
+               fixed point so that the sums from separate shards add up
+               to exactly that of a single pass. */
+            state.dc_acc[c] += llrint(state.main_buf_head[c] * DC_ACC_SCALE);
+        }
+        state.sq_buf_head[c] = state.main_buf_head[c] * state.main_buf_head[c];
+        state.x_sq_ttl[c] += state.sq_buf_head[c];
+    }
+    state.frames_proc_ttl++;
+}
+
+/** Computes running RMS level for the newly-inserted head frame in the
+    main buffer. @a state.main_buf_head[] should point to the sample to
+    be processed. x_sq_ttl[] should be already updated through
+    #filter_new_frame. Call this function once per processing cycle. */
+static void analyse_new_frame(void)
+{
+    /* c: Current channel during loop iteration */
+    int c;
+
+    for(c = 0; c < state.numchannels; c++)
+    {
+        state.cur_rms[c] = sqrt(state.x_sq_ttl[c] / (double)state.rms_window_len);
+        state.rms_ttl[c] += state.cur_rms[c];
+        state.min_rms[c] = fmin(state.min_rms[c], state.cur_rms[c]);
+        state.max_rms[c] = fmax(state.max_rms[c], state.cur_rms[c]);
+        state.pos_peak[c] = fmax(state.pos_peak[c], state.main_buf_cen[c]);
+        state.neg_peak[c] = fmin(state.neg_peak[c], state.main_buf_cen[c]);
+    }
+}
+    
+/** Retrieves another frame from the input file, and places it into the
+    head of the main buffer. The tail entry in the buffer will be
+    discarded. The @a sq_buf buffer will be updated accordingly, and the
+    incoming frame will be filtered through the high-pass filter if
+    enabled. If analysis mode is selected, the statistics will be
+    updated as well.
+
+    @return @c TRUE if more frames remaining in the input stream; @c
+    FALSE otherwise (any further attempts to call this function will
+    only produce padded-out silence). */
+static int fetch_next_frame(void)
+{
+    /* eof: Return result, set flag if no more frames left to process. */
+    /* rdcnt: Number of frames read into the read buffer (0 if EOF or -1 if error) */
+    /* t0: Start of stage being timed (--profile only) */
+    int eof = FALSE;
+    sf_count_t rdcnt;
+    int64_t t0;
+
+    /* Replace tail frame in buffer with new incoming frame */
+    if(!state.in_eof && state.frames_remaining > 0)
+    {
+        /* Attempt to read next frame, refilling the read buffer if it's used up */
+        state.frames_remaining--;
+        if(state.rd_pos == state.rd_len)
+        {
+            t0 = prof_event_begin(PST_DECODE);
+            if(options.in_mem)
+            {
+                /* Input is in memory; the rest of it serves as the read
+                   buffer, without copying (it's only ever read from) */
+                rdcnt = options.in_sfinfo.frames - state.in_mem_pos;
+                state.rd_buf = (double *)options.in_mem + state.in_mem_pos * state.numchannels;
+                state.in_mem_pos += rdcnt;
+            }
+            else
+            {
+                rdcnt = sf_readf_double(state.in_file, state.rd_buf, options.read_block_len);
+            }
+            prof_event_end(PST_DECODE, t0);
+            if(rdcnt < 0)
+            {
+                error(EXIT_FAILURE, errno, "Error while reading input file `%s'",
+                    options.in_file_name);
+            }
+            state.rd_pos = 0;
+            state.rd_len = rdcnt;
+        }
+        if(state.rd_pos == state.rd_len)
+        {
+            /* End of input file; pad out buffer with zero-silence frames. */
+            state.in_eof = TRUE;
+            if(state.ra_frame_cnt < state.frames_remaining)
+            {
+                state.frames_remaining = state.ra_frame_cnt;
+            }
+            memset(state.main_buf_tail, 0, state.frame_sz);
+        }
+        else
+        {
+            memcpy(state.main_buf_tail, state.rd_buf + state.rd_pos * state.numchannels, state.frame_sz);
+            state.rd_pos++;
+            state.frames_read_ttl++;
+        }
+    }
+    else
+    {
+        /* Pad out EOF overshoot with silence */
+        memset(state.main_buf_tail, 0, state.frame_sz);
+        if(state.frames_remaining > 0)
+        {
+            state.frames_remaining--;
+        }
+        else
+        {
+            eof = TRUE;
+        }
+    }
+    
+    state.cur_frame_pos++;
+    t0 = prof_stage_begin(PST_FILTER);
+    advance_buf_ptrs();
+    filter_new_frame();
+    prof_stage_end(PST_FILTER, t0);
+    return !eof;
+}
+
+/** Takes the next sample from an input file in batch mode.
+
+    @return @c FALSE if the end of the file has been reached. */
+static int lane_read_sample(lane_t *lane, double *x)
+{
+    if(lane->rd_pos == lane->rd_len)
+    {
+        /* rdcnt: Number of frames read into buffer */
+        sf_count_t rdcnt = sf_readf_double(lane->file, lane->rd_buf, LANE_RD_BUF_LEN);
+
+        if(rdcnt < 0)
+        {
+            error(EXIT_FAILURE, 0, "Error while reading input file `%s': %s",
+                lane->file_name, sf_strerror(lane->file));
+        }
+        lane->rd_pos = 0;
+        lane->rd_len = rdcnt;
+        if(rdcnt == 0)
+        {
+            return FALSE;
+        }
+    }
+    *x = lane->rd_buf[lane->rd_pos++];
+    return TRUE;
+}
+
+/** Batch mode equivalent of #fetch_next_frame: reads the next sample
+    of each input file into its channel of the new frame, and filters
+    the frame. Input files that have been fully processed are padded
+    with silence from then on, and any track still open is closed off.
+
+    @return @c FALSE once all input files have been fully processed. */
+static int batch_next_frame(void)
+{
+    /* c: Current channel (input file) */
+    /* eof: Per-channel flag, set if no more frames are left to process */
+    /* any_active: Return result */
+    int c;
+    int eof[MAX_CHANNELS];
+    int any_active = FALSE;
+
+    for(c = 0; c < state.numchannels; c++)
+    {
+        lane_t *lane = &state.lanes[c];
+
+        eof[c] = FALSE;
+        state.main_buf_tail[c] = 0.0;
+        if(!lane->active)
+        {
+            continue;
+        }
+        else if(!lane->in_eof && lane->frames_remaining > 0)
+        {
+            lane->frames_remaining--;
+            if(!lane_read_sample(lane, &state.main_buf_tail[c]))
+            {
+                lane->in_eof = TRUE;
+                if(state.ra_frame_cnt < lane->frames_remaining)
+                {
+                    lane->frames_remaining = state.ra_frame_cnt;
+                }
+            }
+        }
+        else if(lane->frames_remaining > 0)
+        {
+            lane->frames_remaining--;
+        }
+        else
+        {
+            eof[c] = TRUE;
+        }
+    }
+
+    state.cur_frame_pos++;
+    advance_buf_ptrs();
+    filter_new_frame();
+
+    for(c = 0; c < state.numchannels; c++)
+    {
+        lane_t *lane = &state.lanes[c];
+
+        if(lane->active && (eof[c] || lane->cut.track_num > options.track_num_end))
+        {
+            lane->active = FALSE;
+            if(lane->frames_remaining == 0
+                && (lane->cut.context == CCTX_TRACK || lane->cut.context == CCTX_TRACK_ENDING))
+            {
+                print_cut_entry(lane->cuts, lane->cut.track_num, lane->cut.track_start,
+                    state.cur_frame_pos, NULL);
+            }
+            verbose("Finished processing `%s' at frame %lld", lane->file_name, state.cur_frame_pos);
+        }
+        any_active |= lane->active;
+    }
+    return any_active;
+}
+
+/** Resets an MD5 context to the initial hash value. */
+static void md5_init(md5_ctx_t *ctx)
+{
+    ctx->h[0] = 0x67452301;
+    ctx->h[1] = 0xefcdab89;
+    ctx->h[2] = 0x98badcfe;
+    ctx->h[3] = 0x10325476;
+    ctx->len = 0;
+}
+
+/** Digests one 64-byte block into an MD5 context. */
+static void md5_transform(md5_ctx_t *ctx, const unsigned char *blk)
+{
+    /* k: Additive constants, floor(abs(sin(i + 1)) * 2^32) */
+    /* r: Per-round left rotate amounts */
+    static const uint32_t k[64] =
+    {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+    };
+    static const int r[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+    uint32_t w[16];
+    uint32_t a = ctx->h[0];
+    uint32_t b = ctx->h[1];
+    uint32_t c = ctx->h[2];
+    uint32_t d = ctx->h[3];
+    int i;
+
+    for(i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t)blk[i * 4] | ((uint32_t)blk[i * 4 + 1] << 8)
+            | ((uint32_t)blk[i * 4 + 2] << 16) | ((uint32_t)blk[i * 4 + 3] << 24);
+    }
+    for(i = 0; i < 64; i++)
+    {
+        /* f: Round function output */
+        /* g: Index of message word used in this step */
+        /* t: Temporary for rotating the working variables */
+        uint32_t f;
+        int g;
+        uint32_t t;
+
+        if(i < 16)
+        {
+            f = (b & c) | (~b & d);
+            g = i;
+        }
+        else if(i < 32)
+        {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        }
+        else if(i < 48)
+        {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        }
+        else
+        {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+        t = d;
+        d = c;
+        c = b;
+        f += a + k[i] + w[g];
+        b += (f << r[(i / 16) * 4 + i % 4]) | (f >> (32 - r[(i / 16) * 4 + i % 4]));
+        a = t;
+    }
+    ctx->h[0] += a;
+    ctx->h[1] += b;
+    ctx->h[2] += c;
+    ctx->h[3] += d;
+}
+
+/** Digests @a len bytes from @a data into an MD5 context. */
+static void md5_update(md5_ctx_t *ctx, const unsigned char *data, size_t len)
+{
+    /* fill: Number of bytes already waiting in the partial block */
+    size_t fill = ctx->len % 64;
+
+    ctx->len += len;
+    if(fill && fill + len >= 64)
+    {
+        memcpy(ctx->blk + fill, data, 64 - fill);
+        md5_transform(ctx, ctx->blk);
+        data += 64 - fill;
+        len -= 64 - fill;
+        fill = 0;
+    }
+    while(len >= 64)
+    {
+        md5_transform(ctx, data);
+        data += 64;
+        len -= 64;
+    }
+    memcpy(ctx->blk + fill, data, len);
+}
+
+/** Digests an array of samples into an MD5 context, as 64-bit IEEE 754
+    little-endian values regardless of host byte order. */
+static void md5_update_samples(md5_ctx_t *ctx, const double *x, size_t n)
+{
+    /* b: Serialised samples awaiting digestion */
+    unsigned char b[64 * sizeof(double)];
+    size_t i;
+
+    for(i = 0; i < n; i++)
+    {
+        uint64_t u;
+        int k;
+
+        memcpy(&u, &x[i], sizeof(u));
+        for(k = 0; k < 8; k++)
+        {
+            b[(i % 64) * 8 + k] = (unsigned char)(u >> (8 * k));
+        }
+        if(i % 64 == 63 || i == n - 1)
+        {
+            md5_update(ctx, b, (i % 64 + 1) * 8);
+        }
+    }
+}
+
+/** Completes an MD5 digest and renders it as a hexadecimal string.
+
+    @param s Points to a character buffer at least #MD5_STR_SZ characters long.
+    @return @a s, so this function can be called in an argument for @c printf(). */
+static const char *md5_final(md5_ctx_t *ctx, char *s)
+{
+    /* pad: Padding block (a one bit followed by zeros) */
+    /* bits: Message length in bits, little-endian */
+    static const unsigned char pad[64] = { 0x80 };
+    unsigned char bits[8];
+    uint64_t len = ctx->len;
+    int i;
+
+    for(i = 0; i < 8; i++)
+    {
+        bits[i] = (unsigned char)((len * 8) >> (8 * i));
+    }
+    md5_update(ctx, pad, 1 + (119 - len % 64) % 64);
+    md5_update(ctx, bits, 8);
+    for(i = 0; i < 16; i++)
+    {
+        sprintf(s + i * 2, "%02x", (ctx->h[i / 4] >> (8 * (i % 4))) & 0xff);
+    }
+    return s;
+}
+
+/** Updates a CRC-32 (as used by zip, gzip and PNG) with @a len bytes
+    from @a data. Start with a @a crc of zero. */
+static uint32_t crc32_update(uint32_t crc, const unsigned char *data, size_t len)
+{
+    /* table: Lookup table for reflected polynomial 0xedb88320, built on first call */
+    static uint32_t table[256];
+    int i;
+
+    if(!table[1])
+    {
+        for(i = 0; i < 256; i++)
+        {
+            uint32_t x = i;
+            int k;
+
+            for(k = 0; k < 8; k++)
+            {
+                x = (x & 1) ? 0xedb88320 ^ (x >> 1) : x >> 1;
+            }
+            table[i] = x;
+        }
+    }
+    crc = ~crc;
+    while(len--)
+    {
+        crc = table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/** Multiplies a 32x32 GF(2) matrix by a vector; helper for #crc32_combine. */
+static uint32_t gf2_matrix_times(const uint32_t *mat, uint32_t vec)
+{
+    uint32_t sum = 0;
+
+    while(vec)
+    {
+        if(vec & 1)
+        {
+            sum ^= *mat;
+        }
+        vec >>= 1;
+        mat++;
+    }
+    return sum;
+}
+
+/** Squares a 32x32 GF(2) matrix; helper for #crc32_combine. */
+static void gf2_matrix_square(uint32_t *square, const uint32_t *mat)
+{
+    int n;
+
+    for(n = 0; n < 32; n++)
+    {
+        square[n] = gf2_matrix_times(mat, mat[n]);
+    }
+}
+
+/** Combines the CRC-32 of two consecutive blocks of data, given the CRC
+    of each and the length of the second (after zlib's crc32_combine()).
+    This lets the CRC of a file be computed out of order. */
+static uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, sf_count_t len2)
+{
+    /* even, odd: Operators for applying 2^n zero bits to a CRC */
+    uint32_t even[32];
+    uint32_t odd[32];
+    uint32_t row = 1;
+    int n;
+
+    if(len2 <= 0)
+    {
+        return crc1;
+    }
+    odd[0] = 0xedb88320;
+    for(n = 1; n < 32; n++)
+    {
+        odd[n] = row;
+        row <<= 1;
+    }
+    gf2_matrix_square(even, odd);
+    gf2_matrix_square(odd, even);
+    do
+    {
+        gf2_matrix_square(even, odd);
+        if(len2 & 1)
+        {
+            crc1 = gf2_matrix_times(even, crc1);
+        }
+        len2 >>= 1;
+        if(len2 == 0)
+        {
+            break;
+        }
+        gf2_matrix_square(odd, even);
+        if(len2 & 1)
+        {
+            crc1 = gf2_matrix_times(odd, crc1);
+        }
+        len2 >>= 1;
+    }
+    while(len2 != 0);
+    return crc1 ^ crc2;
+}
+
+/** Folds bytes just written to the output file into its CRC-32 (see #out_io_t). */
+static void out_io_digest(out_io_t *io, const unsigned char *data, sf_count_t ofs, sf_count_t len)
+{
+    if(!io->hdr_sealed)
+    {
+        if(ofs + len > io->hdr_buf_sz)
+        {
+            io->hdr_buf_sz = (ofs + len) * 2;
+            io->hdr_buf = counted_realloc(io->hdr_buf, io->hdr_buf_sz);
+            if(!io->hdr_buf)
+            {
+                error(EXIT_FAILURE, errno, "Unable to allocate memory for header of output file `%s'",
+                    state.out_file_name);
+            }
+        }
+        if(ofs > io->hdr_len)
+        {
+            memset(io->hdr_buf + io->hdr_len, 0, ofs - io->hdr_len);
+        }
+        memcpy(io->hdr_buf + ofs, data, len);
+        io->hdr_len = (ofs + len > io->hdr_len) ? ofs + len : io->hdr_len;
+        return;
+    }
+    if(ofs < io->hdr_len)
+    {
+        /* n: Number of bytes landing within the header */
+        sf_count_t n = (io->hdr_len - ofs < len) ? io->hdr_len - ofs : len;
+
+        memcpy(io->hdr_buf + ofs, data, n);
+        data += n;
+        ofs += n;
+        len -= n;
+    }
+    if(len > 0)
+    {
+        if(ofs == io->digest_end)
+        {
+            io->crc = crc32_update(io->crc, data, len);
+            io->digest_end += len;
+        }
+        else
+        {
+            io->digest_valid = FALSE;
+        }
+    }
+}
+
+/** Creates a temporary file in the directory given by TMPDIR (or
+    /tmp), with a name starting @a prefix.
+
+    @param name If non-NULL, receives the name of the file (newly
+    allocated); otherwise the file is unlinked straight away, and is
+    removed once closed.
+
+    @return Descriptor of the file, open for reading and writing. */
+static int create_temp_file(const char *prefix, char **name)
+{
+    /* tmp_dir: Directory to create the file in */
+    /* tmp_name: Name of the file */
+    const char *tmp_dir = getenv("TMPDIR");
+    char *tmp_name;
+    int fd;
+
+    tmp_dir = (tmp_dir && *tmp_dir) ? tmp_dir : "/tmp";
+    tmp_name = counted_malloc(strlen(tmp_dir) + strlen(prefix) + 9);
+    if(!tmp_name)
+    {
+        error(EXIT_FAILURE, errno, "Unable to allocate memory for temporary file name");
+    }
+    sprintf(tmp_name, "%s/%sXXXXXX", tmp_dir, prefix);
+    fd = mkstemp(tmp_name);
+    if(fd < 0)
+    {
+        error(EXIT_FAILURE, errno, "Unable to create temporary file `%s'", tmp_name);
+    }
+    if(name)
+    {
+        *name = tmp_name;
+    }
+    else
+    {
+        unlink(tmp_name);
+        free(tmp_name);
+    }
+    return fd;
+}
+
+/** Writes bytes to standard output for the tar archive. */
+static void tar_write(const void *ptr, size_t len)
+{
+    if(fwrite(ptr, 1, len, stdout) < len)
+    {
+        error(EXIT_FAILURE, errno, "Unable to write tar archive to %s", stdout_description);
+    }
+}
+
+/** Writes a number into a tar header field as zero-padded octal. Sizes
+    that don't fit are stored in base-256 (a GNU tar extension that is
+    widely understood), with the top bit of the first byte set. */
+static void tar_set_num(char *field, size_t field_sz, uint64_t n)
+{
+    if(n < ((uint64_t)1 << (3 * (field_sz - 1))))
+    {
+        snprintf(field, field_sz, "%0*llo", (int)field_sz - 1, (unsigned long long)n);
+    }
+    else
+    {
+        size_t i;
+
+        for(i = field_sz - 1; i > 0; i--)
+        {
+            field[i] = (char)(n & 0xff);
+            n >>= 8;
+        }
+        field[0] = (char)0x80;
+    }
+}
+
+/** Writes a tar header block for a member of @a size bytes. */
+static void tar_write_header(const char *name, char typeflag, sf_count_t size)
+{
+    /* hdr: Header block under construction */
+    /* sum: Header checksum */
+    tar_header_t hdr;
+    unsigned sum = 0;
+    size_t i;
+
+    memset(&hdr, 0, sizeof(hdr));
+    /* The name field needn't be terminated if it is filled completely */
+    i = strlen(name);
+    memcpy(hdr.name, name, (i < sizeof(hdr.name)) ? i : sizeof(hdr.name));
+    tar_set_num(hdr.mode, sizeof(hdr.mode), 0644);
+    tar_set_num(hdr.uid, sizeof(hdr.uid), 0);
+    tar_set_num(hdr.gid, sizeof(hdr.gid), 0);
+    tar_set_num(hdr.size, sizeof(hdr.size), size);
+    tar_set_num(hdr.mtime, sizeof(hdr.mtime), time(NULL));
+    hdr.typeflag = typeflag;
+    memcpy(hdr.magic, "ustar", 6);
+    memcpy(hdr.version, "00", 2);
+    memset(hdr.chksum, ' ', sizeof(hdr.chksum));
+    for(i = 0; i < sizeof(hdr); i++)
+    {
+        sum += ((unsigned char *)&hdr)[i];
+    }
+    snprintf(hdr.chksum, sizeof(hdr.chksum), "%06o", sum);
+    tar_write(&hdr, sizeof(hdr));
+}
+
+/** Pads the tar archive out to the end of the current block, given the
+    size of the member just written. */
+static void tar_write_padding(sf_count_t size)
+{
+    static const char zeros[TAR_BLOCK_SZ];
+
+    if(size % TAR_BLOCK_SZ)
+    {
+        tar_write(zeros, TAR_BLOCK_SZ - size % TAR_BLOCK_SZ);
+    }
+}
+
+/** Writes the output file just closed (staged in @a state.out_io) to
+    the tar archive on standard output. Names too long for the ustar
+    header are carried in a preceding POSIX extended header. */
+static void tar_write_member(void)
+{
+    /* name_len: Length of output file name */
+    size_t name_len = strlen(state.out_file_name);
+
+    if(name_len > sizeof(((tar_header_t *)NULL)->name))
+    {
+        /* rec: Start of extended header record, "<len> path=<name>\n", where <len> counts itself */
+        /* rec_len: Length of the record */
+        char rec[32];
+        int rec_len = name_len + 7;
+        int digits;
+
+        do
+        {
+            digits = snprintf(NULL, 0, "%d", rec_len);
+            rec_len = digits + name_len + 7;
+        }
+        while(snprintf(NULL, 0, "%d", rec_len) != digits);
+        sprintf(rec, "%d path=", rec_len);
+        tar_write_header("././@PaxHeader", 'x', rec_len);
+        tar_write(rec, strlen(rec));
+        tar_write(state.out_file_name, name_len);
+        tar_write("\n", 1);
+        tar_write_padding(rec_len);
+    }
+    tar_write_header(state.out_file_name, '0', state.out_io.len);
+    if(state.out_io.fd < 0)
+    {
+        tar_write(state.out_io.mem, state.out_io.len);
+    }
+    else
+    {
+        /* The file outgrew the memory limit and was moved to a temporary file */
+        /* buf: Copying buffer */
+        /* ofs: Current offset when copying */
+        unsigned char buf[65536];
+        sf_count_t ofs = 0;
+
+        while(ofs < state.out_io.len)
+        {
+            ssize_t n = pread(state.out_io.fd, buf, sizeof(buf), ofs);
+            if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else if(n <= 0)
+            {
+                error(EXIT_FAILURE, errno, "Unable to read back staged track file `%s'",
+                    state.out_file_name);
+            }
+            tar_write(buf, n);
+            ofs += n;
+        }
+        close(state.out_io.fd);
+    }
+    tar_write_padding(state.out_io.len);
+    if(fflush(stdout) != 0)
+    {
+        error(EXIT_FAILURE, errno, "Unable to write tar archive to %s", stdout_description);
+    }
+}
+
+/** Ends the tar archive on standard output with two zero blocks. */
+static void tar_write_trailer(void)
+{
+    static const char zeros[TAR_BLOCK_SZ * 2];
+
+    tar_write(zeros, sizeof(zeros));
+    if(fflush(stdout) != 0)
+    {
+        error(EXIT_FAILURE, errno, "Unable to write tar archive to %s", stdout_description);
+    }
+}
+
+/** libsndfile virtual I/O callback: returns length of output file. */
+static sf_count_t out_io_get_filelen(void *user_data)
+{
+    return ((out_io_t *)user_data)->len;
+}
+
+/** libsndfile virtual I/O callback: repositions output file. */
+static sf_count_t out_io_seek(sf_count_t offset, int whence, void *user_data)
+{
+    out_io_t *io = user_data;
+
+    switch(whence)
+    {
+        case SEEK_SET:
+            io->pos = offset;
+            break;
+        case SEEK_CUR:
+            io->pos += offset;
+            break;
+        case SEEK_END:
+            io->pos = io->len + offset;
+            break;
+    }
+    return io->pos;
+}
+
+/** libsndfile virtual I/O callback: reads back from output file. */
+static sf_count_t out_io_read(void *ptr, sf_count_t count, void *user_data)
+{
+    out_io_t *io = user_data;
+    sf_count_t done = 0;
+
+    if(io->fd < 0)
+    {
+        done = (io->pos < io->len) ? io->len - io->pos : 0;
+        done = (done < count) ? done : count;
+        memcpy(ptr, io->mem + io->pos, done);
+        io->pos += done;
+        return done;
+    }
+    while(done < count)
+    {
+        ssize_t n = pread(io->fd, (char *)ptr + done, count - done, io->pos + done);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if(n <= 0)
+        {
+            break;
+        }
+        done += n;
+    }
+    io->pos += done;
+    return done;
+}
+
+/** Moves an output file staged in memory for the tar archive into an
+    unlinked temporary file, once it would grow past @a io->mem_max or
+    the staging buffer can't be enlarged. The memory is kept for staging
+    the next track. */
+static void out_io_spill(out_io_t *io)
+{
+    /* done: Number of bytes copied so far */
+    sf_count_t done = 0;
+
+    io->fd = create_temp_file("trackcutter-", NULL);
+    while(done < io->len)
+    {
+        ssize_t n = pwrite(io->fd, io->mem + done, io->len - done, done);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if(n <= 0)
+        {
+            error(EXIT_FAILURE, errno, "Unable to stage track file `%s' in a temporary file",
+                state.out_file_name);
+        }
+        done += n;
+    }
+}
+
+/** Enlarges the staging buffer of @a io to hold at least @a need bytes.
+    It at least doubles, so a run of ever longer tracks costs only a few
+    allocations, and is kept for the tracks that follow. Should the
+    memory not be had, the file is staged in a temporary file instead. */
+static void out_io_grow(out_io_t *io, sf_count_t need)
+{
+    /* sz: New size of the staging buffer */
+    /* mem: Enlarged staging buffer */
+    sf_count_t sz = (io->mem_sz * 2 > need) ? io->mem_sz * 2 : need;
+    unsigned char *mem;
+
+    sz = (sz > OUT_IO_MEM_SZ) ? sz : OUT_IO_MEM_SZ;
+    sz = (sz < io->mem_max) ? sz : io->mem_max;
+    mem = counted_realloc(io->mem, sz);
+    if(!mem)
+    {
+        out_io_spill(io);
+        verbose("Staging `%s' in a temporary file, as %lld bytes of memory couldn't be had",
+            state.out_file_name, (long long)sz);
+        return;
+    }
+    io->mem = mem;
+    io->mem_sz = sz;
+}
+
+/** libsndfile virtual I/O callback: writes to output file, updating its CRC-32. */
+static sf_count_t out_io_write(const void *ptr, sf_count_t count, void *user_data)
+{
+    out_io_t *io = user_data;
+    sf_count_t done = 0;
+
+    if(io->fd < 0 && io->pos + count > io->mem_max)
+    {
+        out_io_spill(io);
+        verbose("Staging `%s' in a temporary file, as it would exceed the memory limit",
+            state.out_file_name);
+    }
+    else if(io->fd < 0 && io->pos + count > io->mem_sz)
+    {
+        out_io_grow(io, io->pos + count);
+    }
+    if(io->fd < 0)
+    {
+        if(io->pos > io->len)
+        {
+            memset(io->mem + io->len, 0, io->pos - io->len);
+        }
+        memcpy(io->mem + io->pos, ptr, count);
+        done = count;
+    }
+    while(done < count)
+    {
+        ssize_t n = pwrite(io->fd, (const char *)ptr + done, count - done, io->pos + done);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if(n <= 0)
+        {
+            break;
+        }
+        done += n;
+    }
+    out_io_digest(io, ptr, io->pos, done);
+    io->pos += done;
+    if(io->pos > io->len)
+    {
+        io->len = io->pos;
+    }
+    return done;
+}
+
+/** libsndfile virtual I/O callback: returns current position in output file. */
+static sf_count_t out_io_tell(void *user_data)
+{
+    return ((out_io_t *)user_data)->pos;
+}
+
+/** Virtual I/O callback table for output files (manifest or tar output only) */
+static SF_VIRTUAL_IO out_io_vtbl =
+{
+    out_io_get_filelen,
+    out_io_seek,
+    out_io_read,
+    out_io_write,
+    out_io_tell,
+};
+
+/** Allocates the header buffer of @a state.out_io up front, so that
+    the main loop needn't allocate it for the first track. The staging
+    buffer (tar output only) is left to out_io_write(), which keeps it
+    from one track to the next. */
+static void init_out_io(void)
+{
+    state.out_io.hdr_buf_sz = OUT_IO_HDR_BUF_SZ;
+    state.out_io.hdr_buf = counted_malloc(OUT_IO_HDR_BUF_SZ);
+    if(!state.out_io.hdr_buf)
+    {
+        error(EXIT_FAILURE, errno, "Unable to allocate memory for output file headers");
+    }
+}
+
+/** Works out the CRC-32 of the output file once libsndfile has closed
+    it. If the encoder went back and rewrote data that had already been
+    digested, the file is read back from disk instead. */
+static uint32_t out_io_final_crc(out_io_t *io)
+{
+    /* buf: Read-back buffer */
+    /* ofs: Current offset when reading back */
+    unsigned char buf[65536];
+    sf_count_t ofs = 0;
+    uint32_t crc = 0;
+
+    if(io->digest_valid && io->digest_end == io->len)
+    {
+        return crc32_combine(crc32_update(0, io->hdr_buf, io->hdr_len), io->crc,
+            io->digest_end - io->hdr_len);
+    }
+    verbose("Output file was rewritten out of order; reading it back to compute CRC-32");
+    if(io->fd < 0)
+    {
+        return crc32_update(0, io->mem, io->len);
+    }
+    while(ofs < io->len)
+    {
+        ssize_t n = pread(io->fd, buf, sizeof(buf), ofs);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if(n <= 0)
+        {
+            error(EXIT_FAILURE, errno, "Unable to read back output file `%s'", state.out_file_name);
+        }
+        crc = crc32_update(crc, buf, n);
+        ofs += n;
+    }
+    return crc;
+}
+
+/** Reads up to @a len bytes from offset @a ofs of the input file, for
+    --copy-frames. Returns the number of bytes read, which is only short
+    at end of file. */
+static size_t copy_read(void *buf, size_t len, sf_count_t ofs)
+{
+    size_t done = 0;
+
+    while(done < len)
+    {
+        ssize_t n = pread(state.copy_fd, (char *)buf + done, len - done, ofs + done);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if(n < 0)
+        {
+            error(EXIT_FAILURE, errno, "Unable to read `%s'", options.in_file_name);
+        }
+        else if(n == 0)
+        {
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+/** Appends a blank entry to @a state.copy_units and returns it. */
+static codec_unit_t *copy_add_unit(void)
+{
+    if(state.copy_unit_cnt == state.copy_unit_alloc)
+    {
+        state.copy_unit_alloc = state.copy_unit_alloc ? state.copy_unit_alloc * 2 : 1024;
+        state.copy_units = counted_realloc(state.copy_units, state.copy_unit_alloc * sizeof(codec_unit_t));
+        if(!state.copy_units)
+        {
+            error(EXIT_FAILURE, errno, "Unable to allocate frame index for `%s'", options.in_file_name);
+        }
+    }
+    memset(&state.copy_units[state.copy_unit_cnt], 0, sizeof(codec_unit_t));
+    return &state.copy_units[state.copy_unit_cnt++];
+}
+
+/** Decodes the header of an MPEG audio frame.
+
+    @param samplerate Receives the sampling rate, in Hz.
+    @param channels Receives the number of channels.
+    @param spf Receives the number of decoded frames per MPEG frame.
+    @param side_ofs Receives the offset of the side information.
+    @param side_len Receives the length of the side information.
+    @return Length of the frame in bytes, or zero if @a h is not the
+    header of a Layer III frame (or uses a free-format bit rate). */
+static int parse_mpeg_header(const unsigned char *h, int *samplerate, int *channels,
+    int *spf, int *side_ofs, int *side_len)
+{
+    /* kbps: Layer III bit rates for MPEG-1, and for MPEG-2/2.5 */
+    /* version: 3 for MPEG-1, 2 for MPEG-2, 0 for MPEG-2.5 */
+    static const int kbps[2][16] =
+    {
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 },
+    };
+    static const int rates[3] = { 44100, 48000, 32000 };
+    int version = (h[1] >> 3) & 3;
+    int rate_idx = (h[2] >> 2) & 3;
+    int bitrate_idx = h[2] >> 4;
+    int lsf = (version != 3);
+
+    if(h[0] != 0xff || (h[1] & 0xe0) != 0xe0 || version == 1 || ((h[1] >> 1) & 3) != 1
+        || rate_idx == 3 || bitrate_idx == 0 || bitrate_idx == 15)
+    {
+        return 0;
+    }
+    *samplerate = rates[rate_idx] >> ((version == 3) ? 0 : (version == 2) ? 1 : 2);
+    *channels = ((h[3] >> 6) == 3) ? 1 : 2;
+    *spf = lsf ? 576 : 1152;
+    *side_ofs = (h[1] & 1) ? 4 : 6;
+    *side_len = lsf ? ((*channels == 1) ? 9 : 17) : ((*channels == 1) ? 17 : 32);
+    return (*spf / 8) * kbps[lsf][bitrate_idx] * 1000 / *samplerate + ((h[2] >> 1) & 1);
+}
+
+/** Builds @a state.copy_units from the frames of an MP3 input file.
+    Tags (ID3, APE) and the Xing/Info/VBRI frame are skipped. If a LAME
+    tag gives the encoder delay, frame positions are adjusted for
+    gapless decoding. */
+static void index_mpeg_frames(void)
+{
+    /* buf: Frame header, side information and any Xing/LAME tag */
+    /* ofs: Byte offset of current frame */
+    /* delay: Number of leading frames dropped by a gapless decoder */
+    /* frame_cnt: Number of audio frames indexed so far */
+    /* data_ofs: Byte offset after any ID3v2 tag */
+    unsigned char buf[256];
+    sf_count_t ofs = 0;
+    sf_count_t data_ofs;
+    sf_count_t delay = 0;
+    sf_count_t frame_cnt = 0;
+    int samplerate = 0;
+    int channels = 0;
+    int spf = 0;
+    size_t got;
+
+    memset(buf, 0, sizeof(buf));
+    if(copy_read(buf, 10, 0) == 10 && memcmp(buf, "ID3", 3) == 0)
+    {
+        ofs = 10 + ((buf[5] & 0x10) ? 10 : 0)
+            + ((buf[6] & 0x7f) << 21 | (buf[7] & 0x7f) << 14 | (buf[8] & 0x7f) << 7 | (buf[9] & 0x7f));
+    }
+    data_ofs = ofs;
+    for(;;)
+    {
+        int cur_samplerate;
+        int cur_channels;
+        int cur_spf;
+        int side_ofs;
+        int side_len;
+        int len;
+        unsigned char last_byte;
+        codec_unit_t *unit;
+
+        memset(buf, 0, sizeof(buf));
+        got = copy_read(buf, sizeof(buf), ofs);
+        if(got < 4)
+        {
+            break;
+        }
+        len = parse_mpeg_header(buf, &cur_samplerate, &cur_channels, &cur_spf, &side_ofs, &side_len);
+        if(!len || (spf && (cur_samplerate != samplerate || cur_spf != spf)))
+        {
+            /* Not the start of a frame of this stream; resynchronise */
+            if(!spf && ofs - data_ofs >= MPEG_SYNC_SEARCH_LEN)
+            {
+                break;
+            }
+            ofs++;
+            continue;
+        }
+        else if(!spf)
+        {
+            /* First frame: make sure it isn't a chance match by checking
+               that another one follows. It may also be an Xing/Info/VBRI
+               tag rather than audio. */
+            unsigned char *xing = buf + side_ofs + side_len;
+            unsigned char next[4];
+            int next_samplerate;
+            int next_spf;
+
+            if(copy_read(next, 4, ofs + len) < 4
+                || !parse_mpeg_header(next, &next_samplerate, &cur_channels, &next_spf, &side_ofs, &side_len)
+                || next_samplerate != cur_samplerate || next_spf != cur_spf)
+            {
+                ofs++;
+                continue;
+            }
+            parse_mpeg_header(buf, &cur_samplerate, &cur_channels, &cur_spf, &side_ofs, &side_len);
+
+            samplerate = cur_samplerate;
+            channels = cur_channels;
+            spf = cur_spf;
+            if(memcmp(xing, "Xing", 4) == 0 || memcmp(xing, "Info", 4) == 0)
+            {
+                unsigned char *lame = xing + 8 + ((xing[7] & 1) ? 4 : 0) + ((xing[7] & 2) ? 4 : 0)
+                    + ((xing[7] & 4) ? 100 : 0) + ((xing[7] & 8) ? 4 : 0);
+                if(lame + 24 <= buf + got && memcmp(lame, "LAME", 4) == 0)
+                {
+                    delay = ((lame[21] << 4) | (lame[22] >> 4)) + MPEG_DECODER_DELAY;
+                    verbose("LAME tag gives encoder delay of %lld frames", delay - MPEG_DECODER_DELAY);
+                }
+                ofs += len;
+                continue;
+            }
+            else if(memcmp(buf + 36, "VBRI", 4) == 0)
+            {
+                ofs += len;
+                continue;
+            }
+        }
+        if(copy_read(&last_byte, 1, ofs + len - 1) < 1)
+        {
+            /* Truncated final frame */
+            break;
+        }
+        unit = copy_add_unit();
+        unit->ofs = ofs;
+        unit->len = len;
+        unit->end_frame_idx = (frame_cnt + 1) * spf - delay;
+        unit->borrowed = (spf == 576) ? buf[side_ofs] : (buf[side_ofs] << 1) | (buf[side_ofs + 1] >> 7);
+        unit->main_data_len = len - side_ofs - side_len;
+        frame_cnt++;
+        ofs += len;
+    }
+    if(!state.copy_unit_cnt)
+    {
+        error(EXIT_FAILURE, 0, "No MP3 frames found in `%s'; --copy-frames supports MP3 and Ogg Vorbis only",
+            options.in_file_name);
+    }
+    else if(samplerate != state.samplerate || channels != state.numchannels)
+    {
+        error(EXIT_FAILURE, 0, "MP3 frames in `%s' are %dHz/%d channels, but libsndfile decodes %dHz/%d channels",
+            options.in_file_name, samplerate, channels, state.samplerate, state.numchannels);
+    }
+}
+
+/** Builds @a state.copy_units from the pages of an Ogg Vorbis input
+    file. The pages carrying the three Vorbis header packets are counted
+    in @a state.copy_hdr_cnt; each output file starts with a copy of them. */
+static void index_ogg_pages(void)
+{
+    /* hdr: Page header, including segment table */
+    /* id: Start of the Vorbis identification header */
+    /* granule: Last valid granule position seen */
+    /* hdr_pkt_cnt: Number of header packets completed so far */
+    unsigned char hdr[27 + 255];
+    unsigned char id[30];
+    sf_count_t ofs = 0;
+    sf_count_t granule = 0;
+    sf_count_t file_len = lseek(state.copy_fd, 0, SEEK_END);
+    uint32_t serial = 0;
+    int hdr_pkt_cnt = 0;
+    int i;
+
+    while(copy_read(hdr, 27, ofs) == 27)
+    {
+        int nsegs = hdr[26];
+        int len = 27 + nsegs;
+        sf_count_t page_granule = (sf_count_t)get_le(hdr + 6, 8);
+        codec_unit_t *unit;
+
+        if(memcmp(hdr, "OggS", 4) != 0 || hdr[4] != 0)
+        {
+            error(EXIT_FAILURE, 0, "`%s': expected an Ogg page at byte offset %lld",
+                options.in_file_name, ofs);
+        }
+        else if(copy_read(hdr + 27, nsegs, ofs + 27) < (size_t)nsegs)
+        {
+            break;
+        }
+        for(i = 0; i < nsegs; i++)
+        {
+            len += hdr[27 + i];
+        }
+        if(ofs + len > file_len)
+        {
+            /* Truncated final page */
+            break;
+        }
+        if(ofs == 0)
+        {
+            memset(id, 0, sizeof(id));
+            copy_read(id, sizeof(id), 27 + nsegs);
+            if(memcmp(id, "\001vorbis", 7) != 0)
+            {
+                error(EXIT_FAILURE, 0, "`%s' is not an Ogg Vorbis file; --copy-frames supports MP3 and Ogg Vorbis only",
+                    options.in_file_name);
+            }
+            else if((int)get_le(id + 12, 4) != state.samplerate || id[11] != state.numchannels)
+            {
+                error(EXIT_FAILURE, 0, "Vorbis stream in `%s' is %dHz/%d channels, but libsndfile decodes %dHz/%d channels",
+                    options.in_file_name, (int)get_le(id + 12, 4), id[11], state.samplerate, state.numchannels);
+            }
+            serial = get_le(hdr + 14, 4);
+            /* The first packet decoded yields no audio; at most half a long block is lost */
+            state.copy_margin = (1 << (id[28] >> 4)) / 2;
+        }
+        else if(get_le(hdr + 14, 4) != serial)
+        {
+            error(EXIT_FAILURE, 0, "`%s' is a chained or multiplexed Ogg file, which --copy-frames doesn't support",
+                options.in_file_name);
+        }
+        unit = copy_add_unit();
+        unit->ofs = ofs;
+        unit->len = len;
+        unit->borrowed = hdr[5] & 1;
+        if(hdr_pkt_cnt < 3)
+        {
+            for(i = 0; i < nsegs; i++)
+            {
+                hdr_pkt_cnt += (hdr[27 + i] < 255);
+            }
+            state.copy_hdr_cnt++;
+        }
+        else
+        {
+            granule = (page_granule >= 0) ? page_granule : granule;
+            unit->end_frame_idx = granule;
+        }
+        ofs += len;
+    }
+    if(state.copy_unit_cnt <= state.copy_hdr_cnt)
+    {
+        error(EXIT_FAILURE, 0, "No audio pages found in `%s'", options.in_file_name);
+    }
+}
+
+/** Opens the input file a second time for --copy-frames, works out its
+    container format, and indexes its frames or pages. */
+static void open_copy_source(void)
+{
+    /* magic: First bytes of the input file */
+    unsigned char magic[4];
+
+    state.copy_fd = open(options.in_file_name, O_RDONLY);
+    if(state.copy_fd < 0)
+    {
+        error(EXIT_FAILURE, errno, "Unable to open `%s'", options.in_file_name);
+    }
+    memset(magic, 0, sizeof(magic));
+    copy_read(magic, sizeof(magic), 0);
+    if(memcmp(magic, "OggS", 4) == 0)
+    {
+        state.copy_container = CCF_OGG_VORBIS;
+        index_ogg_pages();
+        verbose("Indexed %d Ogg pages (%d header pages) in `%s'",
+            state.copy_unit_cnt, state.copy_hdr_cnt, options.in_file_name);
+    }
+    else
+    {
+        state.copy_container = CCF_MPEG;
+        index_mpeg_frames();
+        verbose("Indexed %d MP3 frames in `%s'", state.copy_unit_cnt, options.in_file_name);
+    }
+}
+
+/** Works out the earliest MP3 frame that must be copied for frame @a f
+    to decode properly, given that its main data may begin in the
+    preceding frames (the bit reservoir). */
+static int mpeg_reservoir_start(int f)
+{
+    /* need: Bytes of borrowed main data not yet accounted for */
+    int need = state.copy_units[f].borrowed;
+
+    while(need > 0 && f > 0)
+    {
+        f--;
+        need -= state.copy_units[f].main_data_len;
+    }
+    return f;
+}
+
+/** Updates the CRC of an Ogg page (polynomial 0x04c11db7, unreflected,
+    computed with the checksum field zeroed). */
+static void ogg_page_set_crc(unsigned char *page, int len)
+{
+    static uint32_t table[256];
+    uint32_t crc = 0;
+    int i;
+
+    if(!table[1])
+    {
+        for(i = 0; i < 256; i++)
+        {
+            uint32_t r = (uint32_t)i << 24;
+            int k;
+
+            for(k = 0; k < 8; k++)
+            {
+                r = (r & 0x80000000) ? (r << 1) ^ 0x04c11db7 : r << 1;
+            }
+            table[i] = r;
+        }
+    }
+    memset(page + 22, 0, 4);
+    for(i = 0; i < len; i++)
+    {
+        crc = (crc << 8) ^ table[((crc >> 24) ^ page[i]) & 0xff];
+    }
+    put_le(page + 22, 4, crc);
+}
+
+/** Fills the output file just finished with the compressed units of
+    the input file that cover it, for --copy-frames.
+
+    MP3 output starts one frame early (so the decoder has something to
+    overlap the first frame with) and further back still if that frame
+    borrows from the bit reservoir, and ends on the frame containing the
+    last sample. Ogg Vorbis output starts on a page boundary at least
+    half a long block early, for the same reason; the granule positions
+    are rebased so that decoders drop any excess on the first page, and
+    stop at the exact last sample. */
+static void copy_units_to_out_file(void)
+{
+    /* start, end: Range of decoded frames wanted */
+    /* first, last: Range of units to copy */
+    /* buf: Copy buffer */
+    sf_count_t start = state.cut.track_start;
+    sf_count_t end = state.cut.track_start + state.out_frames_written;
+    codec_unit_t *u = state.copy_units;
+    int first;
+    int last;
+    int i;
+    static unsigned char buf[OGG_MAX_PAGE_SZ];
+
+    if(state.copy_container == CCF_MPEG)
+    {
+        /* ofs: Current position when copying */
+        sf_count_t ofs;
+
+        first = 0;
+        while(first < state.copy_unit_cnt - 1 && u[first].end_frame_idx <= start)
+        {
+            first++;
+        }
+        if(first > 0)
+        {
+            /* Both this frame and the one it overlaps with must decode intact */
+            i = mpeg_reservoir_start(first);
+            first = mpeg_reservoir_start(first - 1);
+            first = (i < first) ? i : first;
+        }
+        last = first;
+        while(last < state.copy_unit_cnt - 1 && u[last].end_frame_idx < end)
+        {
+            last++;
+        }
+        for(ofs = u[first].ofs; ofs < u[last].ofs + u[last].len; )
+        {
+            size_t n = copy_read(buf, (u[last].ofs + u[last].len - ofs < (sf_count_t)sizeof(buf))
+                ? (size_t)(u[last].ofs + u[last].len - ofs) : sizeof(buf), ofs);
+            out_io_write(buf, n, &state.out_io);
+            ofs += n;
+        }
+    }
+    else
+    {
+        /* base: Decoded frame index that becomes granule position zero */
+        /* seq: Page sequence number in output file */
+        sf_count_t base;
+        uint32_t seq = 0;
+
+        first = state.copy_hdr_cnt;
+        for(i = first + 1; i < state.copy_unit_cnt && u[i - 1].end_frame_idx + state.copy_margin <= start; i++)
+        {
+            if(!u[i].borrowed)
+            {
+                first = i;
+            }
+        }
+        last = first;
+        while(last < state.copy_unit_cnt - 1 && u[last].end_frame_idx < end)
+        {
+            last++;
+        }
+        base = (u[first].end_frame_idx < start) ? u[first].end_frame_idx : start;
+        for(i = 0; i <= last; i = (i + 1 == state.copy_hdr_cnt) ? first : i + 1)
+        {
+            copy_read(buf, u[i].len, u[i].ofs);
+            put_le(buf + 18, 4, seq++);
+            if(i == last)
+            {
+                put_le(buf + 6, 8, ((end < u[i].end_frame_idx) ? end : u[i].end_frame_idx) - base);
+                buf[5] |= 4;
+            }
+            else if(i >= state.copy_hdr_cnt)
+            {
+                if((int64_t)get_le(buf + 6, 8) >= 0)
+                {
+                    put_le(buf + 6, 8, u[i].end_frame_idx - base);
+                }
+                buf[5] &= ~4;
+            }
+            ogg_page_set_crc(buf, u[i].len);
+            out_io_write(buf, u[i].len, &state.out_io);
+        }
+    }
+    verbose("Copied %s %d-%d (bytes %lld-%lld) to `%s'",
+        (state.copy_container == CCF_MPEG) ? "MP3 frames" : "Ogg pages",
+        first, last, u[first].ofs, u[last].ofs + u[last].len, state.out_file_name);
+}
+
+/** Returns the sample width of the track files if they hold integer
+    PCM, or zero if their samples are floating point or compressed.
+    Integer samples are quantised here rather than by libsndfile (see
+    #write_out_block), so the manifest digests what's in the file. */
+static int track_sample_bits(void)
+{
+    switch(options.in_sfinfo.format & SF_FORMAT_SUBMASK)
+    {
+        case SF_FORMAT_PCM_S8:
+        case SF_FORMAT_PCM_U8:
+            return 8;
+        case SF_FORMAT_PCM_16:
+            return 16;
+        case SF_FORMAT_PCM_24:
+            return 24;
+        case SF_FORMAT_PCM_32:
+            return 32;
+        default:
+            return 0;
+    }
+}
+
+/** Quantises @a n samples to the sample width of the integer PCM track
+    files, rounding to nearest and clipping to full scale, leaving them
+    in @a state.wr_qbuf left-justified as @c sf_writef_int() takes them.
+    If a manifest is being written, the quantised samples are digested
+    as a reader of the file decodes them, scaled back to full scale 1.0. */
+static void quantise_out_samples(const double *x, size_t n)
+{
+    /* bits: Sample width of the track files */
+    /* scale: Full scale, in steps of the track files' samples */
+    /* unit: Value of one step, left-justified in an int */
+    /* q: Decoded samples awaiting digestion */
+    int bits = track_sample_bits();
+    double scale = ldexp(1.0, bits - 1);
+    double unit = ldexp(1.0, 32 - bits);
+    double q[64];
+    size_t i;
+
+    for(i = 0; i < n; i++)
+    {
+        /* v: Sample in steps of the track files' samples */
+        double v = rint(x[i] * scale);
+
+        if(!(v >= -scale))
+        {
+            v = -scale;
+        }
+        else if(v > scale - 1.0)
+        {
+            v = scale - 1.0;
+        }
+        state.wr_qbuf[i] = (int)(v * unit);
+        /* As sf_readf_double() decodes it; rint() may have left -0.0 */
+        q[i % 64] = state.wr_qbuf[i] / 2147483648.0;
+        if(state.manifest_file && (i % 64 == 63 || i == n - 1))
+        {
+            md5_update_samples(&state.out_pcm_md5, q, i % 64 + 1);
+        }
+    }
+}
+
+/** Digests @a n samples bound for floating-point or compressed track
+    files (if a manifest is being written). Single-precision files keep
+    them rounded to @c float, so that's what is digested; compressed
+    files can't be decoded here, so their samples are digested as they
+    are handed to the encoder. */
+static void digest_out_samples(const double *x, size_t n)
+{
+    /* q: Rounded samples awaiting digestion */
+    double q[64];
+    size_t i;
+
+    if(!state.manifest_file)
+    {
+        return;
+    }
+    if((options.in_sfinfo.format & SF_FORMAT_SUBMASK) != SF_FORMAT_FLOAT)
+    {
+        md5_update_samples(&state.out_pcm_md5, x, n);
+        return;
+    }
+    for(i = 0; i < n; i++)
+    {
+        q[i % 64] = (float)x[i];
+        if(i % 64 == 63 || i == n - 1)
+        {
+            md5_update_samples(&state.out_pcm_md5, q, i % 64 + 1);
+        }
+    }
+}
+
+/** Passes frames straight to libsndfile for the current output file,
+    quantised first if it holds integer PCM, and digests them if a
+    manifest is being written. */
+static void write_out_block(const double *buf, sf_count_t num_frames)
+{
+    /* t0: Start of write being timed (--profile only) */
+    /* n: Number of frames quantised at a time */
+    int64_t t0 = prof_event_begin(PST_WRITE);
+    sf_count_t n;
+
+    if(!state.wr_qbuf)
+    {
+        digest_out_samples(buf, num_frames * state.numchannels);
+        if(sf_writef_double(state.out_file, buf, num_frames) < num_frames)
+        {
+            error(EXIT_FAILURE, 0, "Unable to write to output file `%s': %s",
+                state.out_file_name, sf_strerror(state.out_file));
+        }
+    }
+    for(; state.wr_qbuf && num_frames > 0; num_frames -= n, buf += n * state.numchannels)
+    {
+        n = (num_frames < options.write_block_len) ? num_frames : options.write_block_len;
+        quantise_out_samples(buf, n * state.numchannels);
+        if(sf_writef_int(state.out_file, state.wr_qbuf, n) < n)
+        {
+            error(EXIT_FAILURE, 0, "Unable to write to output file `%s': %s",
+                state.out_file_name, sf_strerror(state.out_file));
+        }
+    }
+    prof_event_end(PST_WRITE, t0);
+}
+
+/** Writes out any frames held back in the write buffer. */
+static void flush_out_frames(void)
+{
+    if(state.wr_len > 0)
+    {
+        write_out_block(state.wr_buf, state.wr_len);
+        state.wr_len = 0;
+    }
+}
+
+/** Drops the frames before @a lo from the `--output-filter=dc' window sum. */
+static void dc_drop_frames(sf_count_t lo)
+{
+    /* x: Frame being dropped */
+    /* c: Current channel during loop iteration */
+    const double *x;
+    int c;
+
+    for(; state.dc_lo < lo; state.dc_lo++)
+    {
+        x = state.dc_buf + (state.dc_lo % state.dc_buf_len) * state.numchannels;
+        for(c = 0; c < state.numchannels; c++)
+        {
+            state.dc_sum[c] -= x[c];
+        }
+    }
+}
+
+/** Puts the next frame waiting in the `--output-filter=dc' ring into the
+    write buffer, less the mean of the frames around it: those within
+    half the window either side, short of the ends of the track file,
+    and flushes the write buffer once it's full. */
+static void dc_emit_frame(void)
+{
+    /* lo: First frame of the window */
+    /* x: Frame being written */
+    /* y: Where it goes in the write buffer */
+    /* n: Number of frames in the window */
+    /* c: Current channel during loop iteration */
+    sf_count_t lo = state.dc_out - state.dc_half_len;
+    const double *x = state.dc_buf + (state.dc_out % state.dc_buf_len) * state.numchannels;
+    double *y = state.wr_buf + state.wr_len * state.numchannels;
+    double n;
+    int c;
+
+    dc_drop_frames(lo > 0 ? lo : 0);
+    n = (double)(state.dc_in - state.dc_lo);
+    for(c = 0; c < state.numchannels; c++)
+    {
+        y[c] = x[c] - state.dc_sum[c] / n;
+    }
+    state.wr_len++;
+    state.dc_out++;
+    if(state.wr_len == options.write_block_len)
+    {
+        flush_out_frames();
+    }
+}
+
+/** Takes frames into the `--output-filter=dc' ring, writing out each
+    earlier frame whose window they complete. Output lags input by half
+    the window, which is the lookahead held in the ring; the filtered
+    frames are written a block at a time, straight into the write buffer. */
+static void dc_take_frames(const double *buf, sf_count_t num_frames)
+{
+    /* x: Slot in the ring for the incoming frame */
+    /* c: Current channel during loop iteration */
+    double *x;
+    int c;
+
+    for(; num_frames > 0; num_frames--, buf += state.numchannels)
+    {
+        if(state.dc_in - state.dc_lo == state.dc_buf_len)
+        {
+            /* The oldest frame leaves the window, and its slot */
+            dc_drop_frames(state.dc_lo + 1);
+        }
+        x = state.dc_buf + (state.dc_in % state.dc_buf_len) * state.numchannels;
+        for(c = 0; c < state.numchannels; c++)
+        {
+            x[c] = buf[c];
+            state.dc_sum[c] += buf[c];
+        }
+        state.dc_in++;
+        if(state.dc_in - state.dc_out > state.dc_half_len)
+        {
+            dc_emit_frame();
+        }
+    }
+}
+
+/** Writes out the frames of the current track file still waiting in
+    the `--output-filter=dc' ring, their windows cut short by the end of
+    the file, and empties it for the next. */
+static void dc_drain_frames(void)
+{
+    while(state.dc_out < state.dc_in)
+    {
+        dc_emit_frame();
+    }
+    state.dc_in = 0;
+    state.dc_out = 0;
+    state.dc_lo = 0;
+    memset(state.dc_sum, 0, sizeof(state.dc_sum));
+}
+
+/** Writes frames to the current output file. They're held back until
+    a whole block (#options_t::write_block_len) has been gathered, as
+    libsndfile makes a system call for every write; runs of frames that
+    long or longer are written directly. With `--output-filter=dc', the
+    frames pass through #dc_take_frames first. */
+static void write_out_frames(const double *buf, sf_count_t num_frames)
+{
+    state.out_frames_written += num_frames;
+    if(options.copy_frames)
+    {
+        /* Just keep count; the compressed data is copied in by close_out_file() */
+        return;
+    }
+    if(state.dc_buf)
+    {
+        dc_take_frames(buf, num_frames);
+        return;
+    }
+    if(state.wr_len + num_frames > options.write_block_len)
+    {
+        flush_out_frames();
+    }
+    if(num_frames >= options.write_block_len)
+    {
+        write_out_block(buf, num_frames);
+    }
+    else
+    {
+        memcpy(state.wr_buf + state.wr_len * state.numchannels, buf, num_frames * state.frame_sz);
+        state.wr_len += num_frames;
+        if(state.wr_len == options.write_block_len)
+        {
+            flush_out_frames();
+        }
+    }
+}
+
+/** Writes @a num_frames frames of digital silence to the current
+    output file, straight into the write buffer. */
+static void write_out_silence(sf_count_t num_frames)
+{
+    /* n: Number of frames added to the write buffer at a time */
+    sf_count_t n;
+
+    for(; num_frames > 0; num_frames -= n)
+    {
+        n = options.write_block_len - state.wr_len;
+        n = (n < num_frames) ? n : num_frames;
+        memset(state.wr_buf + state.wr_len * state.numchannels, 0, n * state.frame_sz);
+        state.wr_len += n;
+        state.out_frames_written += n;
+        if(state.wr_len == options.write_block_len)
+        {
+            flush_out_frames();
+        }
+    }
+}
+
+/** Appends frames of the gap between tracks to the pre-gap ring (if
+    --pre-gap was given), overwriting the oldest once it's full. */
+static void gap_buf_add(const double *buf, int num_frames)
+{
+    /* n: Number of frames copied at a time, up to the end of the ring */
+    int n;
+
+    if(!state.gap_buf)
+    {
+        return;
+    }
+    if(num_frames > state.gap_buf_len)
+    {
+        buf += (num_frames - state.gap_buf_len) * state.numchannels;
+        num_frames = state.gap_buf_len;
+    }
+    for(; num_frames > 0; num_frames -= n, buf += n * state.numchannels)
+    {
+        n = state.gap_buf_len - state.gap_buf_pos;
+        n = (n < num_frames) ? n : num_frames;
+        memcpy(state.gap_buf + state.gap_buf_pos * state.numchannels, buf, n * state.frame_sz);
+        state.gap_buf_pos = (state.gap_buf_pos + n) % state.gap_buf_len;
+        state.gap_buf_cnt = (state.gap_buf_cnt + n < state.gap_buf_len)
+            ? state.gap_buf_cnt + n : state.gap_buf_len;
+    }
+}
+
+/** Writes the pre-gap to the start of the current output file (if
+    --pre-gap was given): as much of the gap before the track as the
+    ring holds, preceded by digital silence for the rest (as when the
+    track starts near the beginning of the recording). Empties the ring. */
+static void gap_buf_commit(void)
+{
+    /* oldest: Index of the oldest frame in the ring */
+    /* run: Number of frames from @a oldest to the end of the ring */
+    int oldest, run;
+
+    if(!state.gap_buf)
+    {
+        return;
+    }
+    oldest = (state.gap_buf_pos - state.gap_buf_cnt + state.gap_buf_len) % state.gap_buf_len;
+    run = state.gap_buf_len - oldest;
+    write_out_silence(state.gap_buf_len - state.gap_buf_cnt);
+    if(state.gap_buf_cnt > run)
+    {
+        write_out_frames(state.gap_buf + oldest * state.numchannels, run);
+        write_out_frames(state.gap_buf, state.gap_buf_cnt - run);
+    }
+    else
+    {
+        write_out_frames(state.gap_buf + oldest * state.numchannels, state.gap_buf_cnt);
+    }
+    state.gap_buf_cnt = 0;
+}
+
+/** Returns the central frame in the main buffer as it's to be written
+    to track files: as the detector sees it, or as read if
+    --output-filter asks for other processing. */
+static const double *output_frame(void)
+{
+    return state.raw_buf ? state.raw_buf + (state.main_buf_cen - state.main_buf) : state.main_buf_cen;
+}
+
+/** Appends central frame in main buffer to lead-in buffer */
+static void leadin_buf_add(void)
+{
+    if(options.cut_point_action == CPA_EXTRACT_TRACK)
+    {
+        if(state.leadin_buf_end < state.leadin_buf_edge)
+        {
+            memcpy(state.leadin_buf_end, output_frame(), state.frame_sz);
+            state.leadin_buf_end += state.numchannels;
+        }
+        else
+        {
+            error(0, 0, "warning: lead-in buffer is overflowing");
+        }
+    }
+}
+
+/** Commits contents of the lead-in buffer to the current output file */
+static void leadin_buf_commit(void)
+{
+    if(options.cut_point_action == CPA_EXTRACT_TRACK)
+    {
+        int num_frames = (state.leadin_buf_end - state.leadin_buf) / state.numchannels;
+        int64_t t0 = trace_begin();
+        write_out_frames(state.leadin_buf, num_frames);
+        trace_end("flush_leadin", "io", t0, "frames", num_frames);
+    }
+}
+
+/** Purges the lead-in buffer (when a stint of non-silence after a long
+    gap of silence is found to be an audio glitch instead). */
+static void leadin_buf_purge(void)
+{
+    if(options.cut_point_action == CPA_EXTRACT_TRACK)
+    {
+        state.leadin_buf_end = state.leadin_buf;
+    }
+}
+
+/** Works out which slice of the input recording this shard covers, and
+    stores its bounds in @a state.shard_slice_start and @a
+    state.shard_slice_end. The input must be seekable and of known
+    length. Terminates program with an error message otherwise.
+
+    @return Frame index where processing should commence. This lies
+    #SHARD_PREROLL_PERIOD ahead of the slice (plus an RMS window),
+    so the filter state has settled by the time the slice begins. The
+    end of the recording is left alone, so the last shard pads out its
+    tail exactly as a single run would. */
+static sf_count_t locate_shard(void)
+{
+    /* range_end: End of the frame range to divide between shards */
+    /* range_len: Length of the frame range to divide between shards */
+    /* preroll: Number of frames processed ahead of the slice */
+    sf_count_t range_end;
+    sf_count_t range_len;
+    sf_count_t preroll;
+
+    if(!options.in_sfinfo.seekable || options.in_sfinfo.frames <= 0
+        || options.in_sfinfo.frames == SF_COUNT_MAX)
+    {
+        error(EXIT_FAILURE, 0, "Shard mode needs a seekable input file of known length; `%s' isn't",
+            options.in_file_name);
+    }
+    range_end = (options.end_frame_idx < options.in_sfinfo.frames)
+        ? options.end_frame_idx
+        : options.in_sfinfo.frames;
+    range_len = range_end - options.start_frame_idx;
+    if(range_len < options.shard_cnt)
+    {
+        error(EXIT_FAILURE, 0, "Input `%s' is too short to divide into %d shards",
+            options.in_file_name, options.shard_cnt);
+    }
+    state.shard_slice_start = options.start_frame_idx
+        + range_len * (options.shard_idx - 1) / options.shard_cnt;
+    state.shard_slice_end = options.start_frame_idx
+        + range_len * options.shard_idx / options.shard_cnt;
+    preroll = (sf_count_t)state.samplerate * (SHARD_PREROLL_PERIOD + RMS_WINDOW_PERIOD) / 1000;
+    verbose("Shard %d/%d covers frames %lld-%lld",
+        options.shard_idx, options.shard_cnt, state.shard_slice_start,
+        options.shard_idx < options.shard_cnt ? state.shard_slice_end : range_end);
+    return (state.shard_slice_start - preroll > options.start_frame_idx)
+        ? state.shard_slice_start - preroll
+        : options.start_frame_idx;
+}
+
+/** Converts the time range given (if any) to a frame range, now that
+    the sampling rate is known. */
+static void translate_time_range(void)
+{
+    if(options.time_range_given)
+    {
+        options.start_frame_idx = (sf_count_t)(options.start_time * (double)state.samplerate);
+        options.end_frame_idx = (options.end_time < INFINITY)
+            ? (sf_count_t)(options.end_time * (double)state.samplerate)
+            : SF_COUNT_MAX;
+        verbose("Translated time range %.5f-%.5f to frame indices %lld-%lld",
+            options.start_time, options.end_time, options.start_frame_idx, options.end_frame_idx);
+    }
+}
+
+/** Opens the input recording file, and seeks to the starting position if necessary. */
+static void open_input_file(void)
+{
+    /* first_frame_idx: Frame index where processing commences */
+    sf_count_t first_frame_idx;
+
+    if(options.in_mem)
+    {
+        /* Frames are taken straight from memory; see #fetch_next_frame */
+    }
+    else if(options.in_file_name)
+    {
+        state.in_file = sf_open(options.in_file_name, SFM_READ, &options.in_sfinfo);
+        if(!state.in_file)
+        {
+            error(EXIT_FAILURE, 0, "Unable to open `%s': %s", 
+                options.in_file_name, sf_strerror(NULL));
+        }
+    }
+    else
+    {
+        options.in_file_name = stdin_description;
+        state.in_file = sf_open_fd(STDIN_FILENO, SFM_READ, &options.in_sfinfo, TRUE);
+        if(!state.in_file)
+        {
+            error(EXIT_FAILURE, 0, "Unable to identify file structure on standard input: %s", 
+                sf_strerror(NULL));
+        }
+    }
+    verbose("Opened input file `%s'", options.in_file_name);
+    state.samplerate = options.in_sfinfo.samplerate;
+    state.numchannels = options.in_sfinfo.channels;
+    state.frame_sz = sizeof(double) * state.numchannels;
+    verbose("libsndfile file format code: %#08x", options.in_sfinfo.format);
+    verbose("Sampling rate: %dHz", options.in_sfinfo.samplerate);
+    verbose("Number of channels: %d", options.in_sfinfo.channels);
+    if(options.in_sfinfo.frames < SF_COUNT_MAX)
+    {
+        verbose("Length: %lld frames", (long long)options.in_sfinfo.frames);
+    }
+    translate_time_range();
+    first_frame_idx = options.shard_cnt ? locate_shard() : options.start_frame_idx;
+    if(options.in_mem)
+    {
+        state.in_mem_pos = (first_frame_idx < options.in_sfinfo.frames)
+            ? first_frame_idx : options.in_sfinfo.frames;
+    }
+    else if(first_frame_idx > 0)
+    {
+        /* Reposition input file to starting frame if not zero */
+        if(sf_seek(state.in_file, first_frame_idx, SEEK_SET) < 0)
+        {
+            error(EXIT_FAILURE, 0, "Unable to reposition input to frame %lld: %s",
+                first_frame_idx, sf_strerror(state.in_file));
+        }
+        verbose("Repositioned input to frame %lld", first_frame_idx);
+    }
+    state.cur_frame_pos = first_frame_idx;
+    state.frames_remaining = options.end_frame_idx - first_frame_idx;
+}
+
+/** Opens the input files given in batch mode, one per channel. All of
+    them must be mono, and share the same sampling rate. */
+static void open_batch_input_files(void)
+{
+    /* c: Current channel (input file) */
+    /* sf_info: Attributes of current input file */
+    int c;
+    SF_INFO sf_info;
+
+    state.numchannels = options.batch_file_cnt;
+    state.frame_sz = sizeof(double) * state.numchannels;
+    for(c = 0; c < state.numchannels; c++)
+    {
+        lane_t *lane = &state.lanes[c];
+
+        lane->file_name = options.batch_file_names[c];
+        memset(&sf_info, 0, sizeof(sf_info));
+        lane->file = sf_open(lane->file_name, SFM_READ, &sf_info);
+        if(!lane->file)
+        {
+            error(EXIT_FAILURE, 0, "Unable to open `%s': %s", lane->file_name, sf_strerror(NULL));
+        }
+        else if(sf_info.channels != 1)
+        {
+            error(EXIT_FAILURE, 0, "`%s' has %d channels; only mono files can be processed with `--batch'",
+                lane->file_name, sf_info.channels);
+        }
+        else if(c > 0 && sf_info.samplerate != state.samplerate)
+        {
+            error(EXIT_FAILURE, 0, "`%s' is sampled at %dHz, but `%s' is sampled at %dHz",
+                lane->file_name, sf_info.samplerate, state.lanes[0].file_name, state.samplerate);
+        }
+        state.samplerate = sf_info.samplerate;
+        if(c == 0)
+        {
+            translate_time_range();
+        }
+        if(options.start_frame_idx > 0 && sf_seek(lane->file, options.start_frame_idx, SEEK_SET) < 0)
+        {
+            error(EXIT_FAILURE, 0, "Unable to reposition `%s' to frame %lld: %s",
+                lane->file_name, options.start_frame_idx, sf_strerror(lane->file));
+        }
+        lane->rd_buf = counted_malloc(sizeof(double) * LANE_RD_BUF_LEN);
+        if(!lane->rd_buf)
+        {
+            error(EXIT_FAILURE, errno, "Unable to allocate read buffer for `%s'", lane->file_name);
+        }
+        lane->frames_remaining = options.end_frame_idx - options.start_frame_idx;
+        lane->active = TRUE;
+        lane->cut.context = CCTX_SILENCE;
+        lane->cut.track_num = 1;
+        lane->cuts = open_memstream(&lane->cuts_buf, &lane->cuts_buf_sz);
+        verbose("Opened input file `%s' as channel %d", lane->file_name, c);
+    }
+    verbose("Sampling rate: %dHz", state.samplerate);
+    state.cur_frame_pos = options.start_frame_idx;
+    state.frames_remaining = options.end_frame_idx - options.start_frame_idx;
+}
+
+/** Opens the track names file given, and skips through leading entries if needed. */
+static void open_track_names_file(void)
+{
+    if(strcmp(options.track_names_file_name, stdin_file_name) != 0)
+    {
+        state.track_names_file = fopen(options.track_names_file_name, "r");
+        if(!state.track_names_file)
+        {
+            error(EXIT_FAILURE, errno, "Unable to open track names file `%s'",
+                options.track_names_file_name);
+        }
+    }
+    else
+    {
+        state.track_names_file = stdin;
+        options.track_names_file_name = stdin_description;
+    }
+    verbose("Opened track names file `%s'", options.track_names_file_name);
+
+    /* Need to consume lines if starting from track > 1 */
+    for(state.cut.track_num = 1; 
+        state.cut.track_num < options.track_num_start && !feof(state.track_names_file); 
+        state.cut.track_num++)
+    {
+        int x = fgetc(state.track_names_file);
+        while(x != '\n' && x != EOF)
+        {
+            x = fgetc(state.track_names_file);
+        }
+        if(ferror(state.track_names_file))
+        {
+            error(EXIT_FAILURE, errno, "Error while reading track names file `%s'", 
+                options.track_names_file_name);
+        }
+    }
+    if(feof(state.track_names_file))
+    {
+        /* If we've already exhausted all the track names before
+           we start, then close off the input file and pretend
+           we never heard of it. All further tracks will be numbered only. */
+        fclose(state.track_names_file);
+        state.cut.track_num = options.track_num_start;
+        state.track_names_file = NULL;
+    }
+}
+
+/** Creates cuts log file */
+static void create_cuts_file(void)
+{
+    if(options.cuts_file_name && strcmp(options.cuts_file_name, stdout_file_name) != 0)
+    {
+        state.cuts_file = fopen(options.cuts_file_name, "w");
+        if(!state.cuts_file)
+        {
+            error(EXIT_FAILURE, errno, "Unable to create cuts file `%s'",
+                options.cuts_file_name);
+        }
+    }
+    else
+    {
+        state.cuts_file = stdout;
+        options.cuts_file_name = stdout_description;
+    }
+    if(options.shard_cnt)
+    {
+        /* Partial-state files can run to many lines; no need to flush each one */
+        print_shard_header();
+    }
+    else
+    {
+        setvbuf(state.cuts_file, NULL, _IOLBF, BUFSIZ);
+        if(!options.batch)
+        {
+            /* In batch mode, a header is printed above each file's entries instead */
+            print_cuts_header();
+        }
+    }
+    verbose("Opened cuts file `%s'", options.cuts_file_name);
+}
+
+/** Retrieves next track name into @a state.cur_track_name. @a
+    state.cur_track_name will be set to @c NULL if no track name is
+    available. */
+static void fetch_next_track_name(void)
+{
+    if(state.track_names_file)
+    {
+        /* name_sz: Allocation size of name buffer before reading */
+        /* name_len: Length of name returned by getline() */
+        size_t name_sz = state.cur_track_name_sz;
+        int name_len = getline(&state.cur_track_name, &state.cur_track_name_sz, state.track_names_file);
+        
+        alloc_cnt += state.cur_track_name_sz != name_sz;
+        if(name_len > 0)
+        {
+            while(name_len > 0 && isspace(state.cur_track_name[name_len - 1]))
+            {
+                /* Trim trailing whitespace, including terminating newline. */
+                name_len--;
+            }
+            state.cur_track_name[name_len] = 0;
+        }
+        else if(feof(state.track_names_file))
+        {
+            /* No more names left - close track name file, rest of tracks shall be numbered. */
+            fclose(state.track_names_file);
+            state.track_names_file = NULL;
+            if(state.cur_track_name)
+            {
+                free(state.cur_track_name);
+                state.cur_track_name = NULL;
+                state.cur_track_name_sz = 0;
+            }
+        }
+        else if(ferror(state.track_names_file))
+        {
+            error(EXIT_FAILURE, errno, "Unable to read track names file `%s'",
+                options.track_names_file_name);
+        }
+    }
+}
+
+/** Creates a new output file for the current track */
+static void create_new_out_file(void)
+{
+    /* sf_info: Used for specifying parameters of output file */
+    /* extension: File extension used for output file (minus leading period) */
+    /* name_sz: Space needed for the output file name */
+    SF_INFO sf_info;
+    const char *extension = NULL;
+    size_t name_sz;
+
+    fetch_next_track_name();
+    sf_info.format = options.out_sfinfo_format
+        ? options.out_sfinfo_format
+        : options.in_sfinfo.format;
+    sf_info.format = (sf_info.format & SF_FORMAT_TYPEMASK)
+        | (options.in_sfinfo.format & (SF_FORMAT_SUBMASK | SF_FORMAT_ENDMASK));
+    if(options.copy_frames)
+    {
+        /* Tracks are copied out of the input file, so keep its format */
+        extension = (state.copy_container == CCF_MPEG) ? "mp3" : "ogg";
+    }
+    else
+    {
+        /* This is silly. There should be an easier way of obtaining an extension from an SF_FORMAT_xxx value.*/
+        int cur_format;
+        int num_formats;
+    
+        sf_command(NULL, SFC_GET_FORMAT_MAJOR_COUNT, &num_formats, sizeof(int));
+        for(cur_format = 0; cur_format <= num_formats; cur_format++)
+        {
+            SF_FORMAT_INFO sf_format_info;
+            sf_format_info.format = cur_format;
+            if(sf_command(NULL, SFC_GET_FORMAT_MAJOR, &sf_format_info, sizeof(SF_FORMAT_INFO)) == 0
+                && (sf_format_info.format & SF_FORMAT_TYPEMASK) == (sf_info.format & SF_FORMAT_TYPEMASK))
+            {
+                extension = sf_format_info.extension;
+            }
+        }
+        if(!extension)
+        {
+            error(EXIT_FAILURE, 0, "Cannot determine extension for libsndfile filetype %#08x",
+                options.in_sfinfo.format);
+        }
+    }
+    
+    name_sz = ((state.cur_track_name && state.cur_track_name[0]) ? strlen(state.cur_track_name) : 8)
+        + strlen(extension) + 2;
+    if(name_sz > state.out_file_name_buf_sz)
+    {
+        state.out_file_name_buf_sz = name_sz * 2;
+        state.out_file_name_buf = counted_realloc(state.out_file_name_buf, state.out_file_name_buf_sz);
+        if(!state.out_file_name_buf)
+        {
+            error(EXIT_FAILURE, errno, "Unable to allocate memory for output file name");
+        }
+    }
+    state.out_file_name = state.out_file_name_buf;
+    if(state.cur_track_name && state.cur_track_name[0])
+    {
+        sprintf(state.out_file_name, "%s.%s", state.cur_track_name, extension);
+    }
+    else
+    {
+        sprintf(state.out_file_name, "%08d.%s", state.cut.track_num, extension);
+    }
+    sf_info.samplerate = state.samplerate;
+    sf_info.channels = state.numchannels;
+    state.out_frames_written = 0;
+    if(state.manifest_file || options.tar_output || options.copy_frames)
+    {
+        /* Route writes through out_io_write() so the file can be digested
+           on the fly, or staged in memory for the tar archive */
+        if(options.tar_output)
+        {
+            state.out_io.fd = -1;
+        }
+        else
+        {
+            state.out_io.fd = open(state.out_file_name, O_RDWR | O_CREAT | O_TRUNC, 0666);
+            if(state.out_io.fd < 0)
+            {
+                error(EXIT_FAILURE, errno, "Unable to create new track file `%s'", state.out_file_name);
+            }
+        }
+        state.out_io.pos = state.out_io.len = state.out_io.hdr_len = 0;
+        state.out_io.hdr_sealed = FALSE;
+        state.out_io.digest_valid = TRUE;
+        if(!options.copy_frames)
+        {
+            state.out_file = sf_open_virtual(&out_io_vtbl, SFM_WRITE, &sf_info, &state.out_io);
+        }
+        state.out_io.hdr_sealed = TRUE;
+        state.out_io.digest_end = state.out_io.hdr_len;
+        state.out_io.crc = 0;
+        md5_init(&state.out_pcm_md5);
+    }
+    else
+    {
+        state.out_file = sf_open(state.out_file_name, SFM_WRITE, &sf_info);
+    }
+    if(!state.out_file && !options.copy_frames)
+    {
+        error(EXIT_FAILURE, 0, "Unable to create new track file `%s': %s",
+            state.out_file_name, sf_strerror(NULL));
+    }
+    gap_buf_commit();
+    leadin_buf_commit();
+    leadin_buf_purge();
+    if(options.verbose)
+    {
+        char cur_track_start_s[TIMECODE_STR_SZ];
+        verbose("Creating `%s' starting @ frame index %lld (%s)",
+            state.out_file_name, state.cut.track_start, 
+            render_frame_idx_as_timecode(cur_track_start_s, state.cut.track_start));
+    }
+}
+
+/** Writes the manifest entry for the output file that has just been
+    closed: the digest of the samples written, and the CRC-32 and size
+    of the encoded file. */
+static void print_manifest_entry(void)
+{
+    char pcm_md5_s[MD5_STR_SZ];
+
+    fprintf(state.manifest_file, "%10d  %14lld  %32s  %08x  %14lld  %s\n",
+        state.cut.track_num, state.out_frames_written,
+        md5_final(&state.out_pcm_md5, pcm_md5_s), out_io_final_crc(&state.out_io),
+        state.out_io.len, state.out_file_name);
+    if(ferror(state.manifest_file))
+    {
+        error(EXIT_FAILURE, errno, "Unable to write entry to manifest file `%s'",
+            options.manifest_file_name);
+    }
+}
+
+/** Creates the checksum manifest file, if requested. */
+static void create_manifest_file(void)
+{
+    if(strcmp(options.manifest_file_name, stdout_file_name) != 0)
+    {
+        state.manifest_file = fopen(options.manifest_file_name, "w");
+        if(!state.manifest_file)
+        {
+            error(EXIT_FAILURE, errno, "Unable to create manifest file `%s'",
+                options.manifest_file_name);
+        }
+    }
+    else
+    {
+        state.manifest_file = stdout;
+        options.manifest_file_name = stdout_description;
+    }
+    setvbuf(state.manifest_file, NULL, _IOLBF, BUFSIZ);
+    if(!options.no_cuts_file_header)
+    {
+        fprintf(state.manifest_file, "%10s  %14s  %-32s  %-8s  %14s  %s\n", "track_num",
+            "frames", "pcm_md5", "file_crc32", "file_bytes", "file_name");
+    }
+    verbose("Opened manifest file `%s'", options.manifest_file_name);
+}
+
+/** Prepares for writing the --metrics file on exit. The directory it's
+    to go in is opened now, before any change of working directory, so
+    that the file can be created and renamed relative to it later on. */
+static void init_metrics(void)
+{
+    /* dir_name, base_name: Copies of the file name, for dirname() and basename() to modify */
+    char *dir_name = counted_strdup(options.metrics_file_name);
+    char *base_name = counted_strdup(options.metrics_file_name);
+
+    if(!dir_name || !base_name)
+    {
+        error(EXIT_FAILURE, errno, "Unable to allocate memory for metrics file name");
+    }
+    state.metrics_dir_fd = open(dirname(dir_name), O_RDONLY | O_DIRECTORY);
+    if(state.metrics_dir_fd < 0)
+    {
+        error(EXIT_FAILURE, errno, "Unable to open directory of metrics file `%s'",
+            options.metrics_file_name);
+    }
+    state.metrics_base_name = counted_strdup(basename(base_name));
+    if(!state.metrics_base_name)
+    {
+        error(EXIT_FAILURE, errno, "Unable to allocate memory for metrics file name");
+    }
+    free(dir_name);
+    free(base_name);
+}
+
+/** Closes the current track output file */
+static void close_out_file(void)
+{
+    if(state.out_file_name)
+    {
+        /* t0: Start of whole close, for --trace */
+        /* t1: Start of flushing or archiving the file, for --trace */
+        int64_t t0 = trace_begin();
+        int64_t t1;
+
+        if(options.verbose)
+        {
+            sf_count_t duration = state.cur_frame_pos - state.cut.track_start;
+            char cur_track_end_s[TIMECODE_STR_SZ];
+            char duration_s[TIMECODE_STR_SZ];
+            verbose("Completed `%s' ending @ frame index %lld (%s), duration %lld frames (%s)",
+                state.out_file_name, state.cur_frame_pos,
+                render_frame_idx_as_timecode(cur_track_end_s, state.cur_frame_pos),
+                duration,
+                render_frame_idx_as_timecode(duration_s, duration));
+        }
+        t1 = trace_begin();
+        if(options.copy_frames)
+        {
+            copy_units_to_out_file();
+        }
+        else
+        {
+            if(state.dc_buf)
+            {
+                dc_drain_frames();
+            }
+            write_out_silence(state.post_gap_len);
+            if(options.cd_frames)
+            {
+                write_out_silence((CD_FRAME_LEN - state.out_frames_written % CD_FRAME_LEN) % CD_FRAME_LEN);
+            }
+            flush_out_frames();
+            sf_close(state.out_file);
+            state.out_file = NULL;
+        }
+        trace_end("flush", "io", t1, "frames", state.out_frames_written);
+        if(options.profile)
+        {
+            /* st: Attributes of the completed track file */
+            struct stat st;
+
+            if(options.tar_output)
+            {
+                state.prof.out_bytes += state.out_io.len;
+            }
+            else if(stat(state.out_file_name, &st) == 0)
+            {
+                state.prof.out_bytes += st.st_size;
+            }
+        }
+        if(state.manifest_file)
+        {
+            print_manifest_entry();
+        }
+        if(options.tar_output)
+        {
+            t1 = trace_begin();
+            tar_write_member();
+            trace_end("tar_write_member", "io", t1, "bytes", state.out_io.len);
+        }
+        else if(state.manifest_file || options.copy_frames)
+        {
+            close(state.out_io.fd);
+        }
+        state.out_file_name = NULL;
+        trace_end("close_out_file", "track", t0, "track", state.cut.track_num);
+    }
+}
+
+/** Force conclusion of current track (when EOF is encountered, etc)
+
+    @param context Cut context the track is being ended from; there's
+    only a track to end in #CCTX_TRACK or #CCTX_TRACK_ENDING. */
+static void force_end_of_track(cut_context_t context)
+{
+    /* t0: Start of track event being timed (--profile only) */
+    /* in_track: Set if a track is actually being finished */
+    int64_t t0 = prof_event_begin(PST_TRACK_CLOSE);
+    int in_track = (options.cut_point_action == CPA_EXTRACT_TRACK)
+        ? state.out_file_name != NULL
+        : context == CCTX_TRACK || context == CCTX_TRACK_ENDING;
+
+    if(options.cut_point_action == CPA_LOG_POINT)
+    {
+        if(in_track)
+        {
+            print_track_cut();
+        }
+    }
+    else if(options.cut_point_action == CPA_EXTRACT_TRACK)
+    {
+        close_out_file();
+    }
+    /* FIXME: Find out why the track name is sometimes re-used if we run out of names. */
+    if(state.cur_track_name)
+    {
+        state.cur_track_name[0] = 0;
+    }
+    prof_event_end(PST_TRACK_CLOSE, t0);
+    if(options.profile && in_track)
+    {
+        prof_add_track_latency();
+    }
+}
+
+/** Commit current frame to output file or cutting sheet, depending on cutting mode. */
+static void commit_current_frame(void)
+{
+    if(options.cut_point_action == CPA_LOG_POINT)
+    {
+        /* This block intentionally left blank */
+    }
+    else if(options.cut_point_action == CPA_EXTRACT_TRACK)
+    {
+        write_out_frames(output_frame(), 1);
+    }
+}
+
+/** Moves the --exempt cursor on to the current frame, once it has
+    reached @a state.exempt_edge. Windows already passed are stepped
+    over, so the cost is constant per frame when amortised over the
+    recording. */
+static void exempt_step(void)
+{
+    /* win: Window the current frame is in, or the next one after it */
+    exempt_win_t *win;
+
+    while(state.exempt_cur < state.exempt_win_cnt
+        && state.exempt_wins[state.exempt_cur].end <= state.cur_frame_pos)
+    {
+        state.exempt_cur++;
+    }
+    if(state.exempt_cur == state.exempt_win_cnt)
+    {
+        state.exempt_on = FALSE;
+        state.exempt_edge = SF_COUNT_MAX;
+        return;
+    }
+    win = &state.exempt_wins[state.exempt_cur];
+    state.exempt_on = state.cur_frame_pos >= win->start;
+    state.exempt_edge = state.exempt_on ? win->end : win->start;
+}
+
+/** Takes the energy of the hop ending at the current frame into the
+    --adaptive-floor tracker, and sets the threshold @a state.n_x_nf_sq
+    from it. The energy is that of the loudest channel over the RMS
+    window, as signal in any channel counts. The floor is the least
+    such energy over the last #FLOOR_SUBWIN_CNT sub-windows (the
+    "minimum statistics" of the recording), which follows hiss that
+    drifts over minutes without being lifted by the music in between
+    gaps. The cost is constant per hop. */
+static void track_noise_floor(void)
+{
+    /* e: Energy of the hop */
+    /* floor: Least energy within the window */
+    /* c: Current channel in iterative loops */
+    /* i: Index into state.floor_sub_min */
+    double e = 0.0;
+    double floor;
+    int c;
+    int i;
+
+    state.floor_hop_left = state.rms_window_len;
+    for(c = 0; c < state.numchannels; c++)
+    {
+        if(state.x_sq_ttl[c] > e)
+        {
+            e = state.x_sq_ttl[c];
+        }
+    }
+    if(e < state.floor_sub_min[state.floor_sub_idx])
+    {
+        state.floor_sub_min[state.floor_sub_idx] = e;
+    }
+    if(--state.floor_sub_left == 0)
+    {
+        /* Start a new sub-window in place of the oldest */
+        state.floor_sub_left = state.floor_sub_len;
+        state.floor_sub_idx = (state.floor_sub_idx + 1) % FLOOR_SUBWIN_CNT;
+        state.floor_sub_min[state.floor_sub_idx] = INFINITY;
+        state.floor_old_min = INFINITY;
+        for(i = 0; i < FLOOR_SUBWIN_CNT; i++)
+        {
+            if(state.floor_sub_min[i] < state.floor_old_min)
+            {
+                state.floor_old_min = state.floor_sub_min[i];
+            }
+        }
+    }
+    floor = state.floor_sub_min[state.floor_sub_idx];
+    if(state.floor_old_min < floor)
+    {
+        floor = state.floor_old_min;
+    }
+    if(floor < state.floor_lowest)
+    {
+        floor = state.floor_lowest;
+    }
+    state.n_x_nf_sq = floor * state.floor_ratio;
+    if(options.verbose && state.floor_sub_left == state.floor_sub_len)
+    {
+        char cur_pos_time_s[TIMECODE_STR_SZ];
+        verbose("Noise floor at %s is %.2f dBFS",
+            render_frame_idx_as_timecode(cur_pos_time_s, state.cur_frame_pos),
+            10.0 * log10(state.n_x_nf_sq / (double)state.rms_window_len));
+    }
+}
+
+/** Steps the track-cutting state machine of one stream of audio over
+    the current frame. This is the decision itself, shared by the single
+    recording and the files of a --batch run; what is done with the frame
+    is up to the caller, as told by the result.
+
+    @param cs Track-cutting state of the stream.
+    @param sig Set if the current frame of the stream counts as signal.
+    @return What the frame turned out to be. */
+static cut_event_t step_cut_context(cut_stream_t *cs, int sig)
+{
+    /* ev: Return result */
+    cut_event_t ev = CEV_GAP;
+
+    switch(cs->context)
+    {
+        case CCTX_SILENCE:
+            if(sig)
+            {
+                cs->context = CCTX_TRACK_STARTING;
+                cs->time_to_live = state.min_signal_len - 1;
+                cs->track_start = state.cur_frame_pos;
+                ev = CEV_SIGNAL;
+            }
+            break;
+        case CCTX_TRACK_STARTING:
+            if(!sig)
+            {
+                /* The glitch was part of the gap after all */
+                cs->context = CCTX_SILENCE;
+                ev = CEV_FALSE_START;
+            }
+            else if(cs->time_to_live > 0)
+            {
+                cs->time_to_live--;
+                ev = CEV_LEADIN;
+            }
+            /* We've found the start of a track */
+            else
+            {
+                cs->context = CCTX_TRACK;
+                ev = CEV_TRACK_START;
+            }
+            break;
+        case CCTX_TRACK_ENDING:
+            ev = CEV_TRACK;
+            if(sig)
+            {
+                cs->context = CCTX_TRACK;
+            }
+            else if(cs->time_to_live > 0)
+            {
+                cs->time_to_live--;
+            }
+            /* We've found the end of a track */
+            else
+            {
+                cs->context = CCTX_SILENCE;
+                ev = CEV_TRACK_END;
+            }
+            break;
+        case CCTX_TRACK:
+            ev = CEV_TRACK;
+            if(!sig && state.cur_frame_pos >= cs->track_start + state.min_track_len)
+            {
+                cs->context = CCTX_TRACK_ENDING;
+                cs->time_to_live = state.min_silence_len;
+            }
+            break;
+    }
+    return ev;
+}
+
+/** Reports a false positive in verbose mode: signal in the gap between
+    tracks that didn't last long enough to start one.
+
+    @param cs Track-cutting state of the stream, just back in silence.
+    @param file_name Name of the input file in --batch mode, otherwise @c NULL. */
+static void report_false_positive(const cut_stream_t *cs, const char *file_name)
+{
+    if(options.verbose)
+    {
+        char cur_track_start_time_s[TIMECODE_STR_SZ];
+        char cur_pos_time_s[TIMECODE_STR_SZ];
+        verbose("False positive of %lld frames (%dms) between frame range %lld-%lld (%s-%s)%s%s%s",
+            state.cur_frame_pos - cs->track_start,
+            (int)(((state.cur_frame_pos - cs->track_start) * 1000) / state.samplerate),
+            cs->track_start, state.cur_frame_pos,
+            render_frame_idx_as_timecode(cur_track_start_time_s, cs->track_start),
+            render_frame_idx_as_timecode(cur_pos_time_s, state.cur_frame_pos),
+            file_name ? " in `" : "", file_name ? file_name : "", file_name ? "'" : "");
+    }
+}
+
+/** In cutting mode, makes a decision on the cutting context state,
+    based on the RMS level of the current frame, and buffers, writes or
+    logs the frame accordingly. Frames within --exempt windows always
+    count as signal. */
+static void update_context(void)
+{
+    /* sig: Set if the current frame counts as signal */
+    int sig;
+
+    if(state.cur_frame_pos >= state.exempt_edge)
+    {
+        exempt_step();
+    }
+    if(--state.floor_hop_left == 0)
+    {
+        track_noise_floor();
+    }
+    sig = state.exempt_on || we_have_signal();
+    switch(step_cut_context(&state.cut, sig))
+    {
+        case CEV_GAP:
+            gap_buf_add(output_frame(), 1);
+            break;
+        case CEV_SIGNAL:
+            leadin_buf_add();
+            if(options.profile)
+            {
+                state.prof.track_start_ns = prof_clock();
+            }
+            break;
+        case CEV_LEADIN:
+            leadin_buf_add();
+            break;
+        case CEV_FALSE_START:
+            gap_buf_add(state.leadin_buf, (state.leadin_buf_end - state.leadin_buf) / state.numchannels);
+            gap_buf_add(output_frame(), 1);
+            leadin_buf_purge();
+            state.prof.false_positives++;
+            report_false_positive(&state.cut, NULL);
+            break;
+        case CEV_TRACK_START:
+        {
+            /* t0: Start of track event being timed (--profile only) */
+            int64_t t0 = prof_event_begin(PST_TRACK_OPEN);
+
+            if(options.cut_point_action == CPA_LOG_POINT)
+            {
+                fetch_next_track_name();
+            }
+            else if(options.cut_point_action == CPA_EXTRACT_TRACK)
+            {
+                /* t1: Start of span, for --trace */
+                int64_t t1 = trace_begin();
+
+                create_new_out_file();
+                trace_end("create_new_out_file", "track", t1, "track", state.cut.track_num);
+            }
+            prof_event_end(PST_TRACK_OPEN, t0);
+            commit_current_frame();
+            break;
+        }
+        case CEV_TRACK:
+            commit_current_frame();
+            break;
+        case CEV_TRACK_END:
+            commit_current_frame();
+            force_end_of_track(CCTX_TRACK_ENDING);
+            state.cut.track_num++;
+            break;
+    }
+}
+
+/** Returns the arena space taken by the buffers of a memory plan, with
+    the given read block, write block and --trace ring lengths (each zero
+    if not needed): the RMS window queues, the lead-in buffer, pre-gap
+    ring and --output-filter buffers if tracks are being written, and
+    those. */
+static sf_count_t plan_arena_bytes(int read_len, int write_len, int ring_len)
+{
+    /* extract: Set if track files are being written */
+    /* leadin_len: Length of the lead-in buffer, in frames */
+    /* gap_len: Length of the pre-gap ring, in frames */
+    /* raw_len: Length of the unfiltered copy of the main buffer, in frames */
+    /* dc_len: Length of the output DC removal ring, in frames */
+    /* qbuf_bytes: Size of the quantised copy of the write block */
+    int extract = options.task == TCT_CUTTING && options.cut_point_action == CPA_EXTRACT_TRACK;
+    int leadin_len = extract ? state.samplerate * options.min_signal_period / 1000 : 0;
+    int gap_len = extract ? (sf_count_t)state.samplerate * options.pre_gap_period / 1000 : 0;
+    int raw_len = (extract && options.output_filter != OFM_SAME) ? state.rms_window_len : 0;
+    int dc_len = (extract && options.output_filter == OFM_DC)
+        ? 2 * (state.samplerate * OUTPUT_DC_WINDOW_PERIOD / 2000) + 1 : 0;
+    sf_count_t qbuf_bytes = track_sample_bits()
+        ? (sf_count_t)write_len * state.numchannels * sizeof(int) : 0;
+
+    return 2 * arena_round((sf_count_t)state.rms_window_len * state.frame_sz)
+        + arena_round((sf_count_t)leadin_len * state.frame_sz)
+        + arena_round((sf_count_t)gap_len * state.frame_sz)
+        + arena_round((sf_count_t)raw_len * state.frame_sz)
+        + arena_round((sf_count_t)dc_len * state.frame_sz)
+        + arena_round((sf_count_t)read_len * state.frame_sz)
+        + arena_round((sf_count_t)write_len * state.frame_sz)
+        + arena_round(qbuf_bytes)
+        + arena_round((sf_count_t)ring_len * sizeof(trace_event_t));
+}
+
+/** Sizes the buffers that can be resized so that all of them fit
+    within --memory-limit, refusing to start if even the smallest sizes
+    won't fit, and then maps the arena that holds them. The RMS window
+    queues, the lead-in buffer, the pre-gap ring and the --output-filter
+    buffers are fixed by the window period, the minimum signal period,
+    --pre-gap and --output-filter, as are the batch read buffers and the
+    --copy-frames index (already built, and kept outside the arena). The
+    read and write blocks and the --trace ring are halved, largest
+    first, until everything fits or they reach their minimum sizes.
+    Whatever is left may be used for staging track files in memory for
+    tar output, beyond which they're moved to a temporary file. Memory
+    used by libsndfile and the C library isn't counted.
+
+    Without a limit, the buffers keep their usual sizes. */
+static void plan_memory(void)
+{
+    /* extract: Set if track files are being written */
+    /* read_len, write_len, ring_len: Planned lengths of the resizable
+       buffers (zero if not needed), in frames or events */
+    /* read_min, write_min, ring_min: Smallest lengths they may take */
+    /* leadin_bytes: Size of the lead-in buffer */
+    /* gap_bytes: Size of the pre-gap ring */
+    /* filter_bytes: Size of the --output-filter buffers */
+    /* other_bytes: Size of the fixed buffers outside the arena */
+    /* total: Memory taken by the plan */
+    int extract = options.task == TCT_CUTTING && options.cut_point_action == CPA_EXTRACT_TRACK;
+    int read_len = (options.batch || options.in_mem) ? 0 : options.read_block_len;
+    int write_len = (extract && !options.copy_frames) ? options.write_block_len : 0;
+    int ring_len = options.trace_file_name ? TRACE_RING_LEN : 0;
+    int read_min = read_len ? 1 : 0;
+    int write_min = write_len ? 1 : 0;
+    int ring_min = ring_len ? TRACE_MIN_RING_LEN : 0;
+    sf_count_t leadin_bytes = extract
+        ? (sf_count_t)(state.samplerate * options.min_signal_period / 1000) * state.frame_sz : 0;
+    sf_count_t gap_bytes = extract
+        ? (sf_count_t)state.samplerate * options.pre_gap_period / 1000 * state.frame_sz : 0;
+    sf_count_t filter_bytes = (extract && options.output_filter != OFM_SAME)
+        ? (sf_count_t)state.rms_window_len * state.frame_sz : 0;
+    sf_count_t other_bytes = (sf_count_t)state.copy_unit_alloc * sizeof(codec_unit_t);
+    sf_count_t total;
+
+    if(extract && options.output_filter == OFM_DC)
+    {
+        filter_bytes += (sf_count_t)(2 * (state.samplerate * OUTPUT_DC_WINDOW_PERIOD / 2000) + 1)
+            * state.frame_sz;
+    }
+    if(options.batch)
+    {
+        other_bytes += (sf_count_t)state.numchannels * LANE_RD_BUF_LEN * sizeof(double);
+    }
+    state.out_io.mem_max = SF_COUNT_MAX;
+    if(options.memory_limit)
+    {
+        total = plan_arena_bytes(read_min, write_min, ring_min) + other_bytes;
+        if(total > options.memory_limit)
+        {
+            error(EXIT_FAILURE, 0, "Memory limit of %lld bytes is too small; at least %lld bytes "
+                "are needed, %lld of them for the lead-in buffer (see `--min-signal-period'), "
+                "%lld for the pre-gap (see `--pre-gap') and %lld for the output filter "
+                "(see `--output-filter')",
+                (long long)options.memory_limit, (long long)total,
+                (long long)leadin_bytes, (long long)gap_bytes, (long long)filter_bytes);
+        }
+        while(plan_arena_bytes(read_len, write_len, ring_len) + other_bytes > options.memory_limit)
+        {
+            /* read_bytes, write_bytes, ring_bytes: Sizes of the buffers that can still shrink */
+            sf_count_t read_bytes = (read_len > read_min) ? (sf_count_t)read_len * state.frame_sz : 0;
+            sf_count_t write_bytes = (write_len > write_min) ? (sf_count_t)write_len * state.frame_sz : 0;
+            sf_count_t ring_bytes = (ring_len > ring_min) ? (sf_count_t)ring_len * sizeof(trace_event_t) : 0;
+
+            /* Halve the largest of them */
+            if(read_bytes >= write_bytes && read_bytes >= ring_bytes)
+            {
+                read_len /= 2;
+            }
+            else if(write_bytes >= ring_bytes)
+            {
+                write_len /= 2;
+            }
+            else
+            {
+                ring_len /= 2;
+            }
+        }
+    }
+    init_arena(plan_arena_bytes(read_len, write_len, ring_len),
+        options.memory_limit ? options.memory_limit - other_bytes : 0);
+    if(options.memory_limit)
+    {
+        total = state.arena.size + other_bytes;
+        if(options.tar_output)
+        {
+            state.out_io.mem_max = options.memory_limit - total;
+        }
+        verbose("Memory plan, within limit of %lld bytes:", (long long)options.memory_limit);
+        verbose("  RMS window queues: %lld bytes", 2LL * state.rms_window_len * state.frame_sz);
+        verbose("  lead-in buffer: %lld bytes", (long long)leadin_bytes);
+        verbose("  pre-gap ring: %lld bytes", (long long)gap_bytes);
+        verbose("  output filter: %lld bytes", (long long)filter_bytes);
+        verbose("  read block: %lld bytes (%d frames)", (long long)read_len * state.frame_sz, read_len);
+        verbose("  write block: %lld bytes (%d frames)", (long long)write_len * state.frame_sz, write_len);
+        verbose("  trace ring: %lld bytes (%d events)",
+            (long long)(ring_len * sizeof(trace_event_t)), ring_len);
+        verbose("  other buffers: %lld bytes", (long long)other_bytes);
+        if(options.tar_output)
+        {
+            verbose("  tar staging: up to %lld bytes per track file, then a temporary file",
+                (long long)state.out_io.mem_max);
+        }
+        verbose("  total: %lld bytes", (long long)total);
+    }
+    options.read_block_len = read_len ? read_len : options.read_block_len;
+    options.write_block_len = write_len ? write_len : options.write_block_len;
+    state.trace.ring_len = ring_len;
+}
+
+/** Comparison function for sorting exempt windows by start through @c qsort(). */
+static int compare_exempt_wins(const void *a, const void *b)
+{
+    /* wa,wb: Windows being compared */
+    const exempt_win_t *wa = a;
+    const exempt_win_t *wb = b;
+
+    return (wa->start > wb->start) - (wa->start < wb->start);
+}
+
+/** Reads the time ranges listed in the --exempt file into @a
+    state.exempt_wins, as frame indices in order, with overlapping and
+    adjoining ranges joined up. Each line holds one time range in the
+    form taken by --time-range; blank lines and anything after a `#'
+    are ignored. Terminates program with an error message if the file
+    can't be read or is malformed. */
+static void load_exempt_file(void)
+{
+    /* file: Handle of exemption file */
+    /* line: Current line of the file */
+    /* line_num: Number of current line, counting from 1 */
+    /* alloc: Allocated number of entries in state.exempt_wins */
+    /* i, j: Indices into state.exempt_wins when joining windows */
+    FILE *file = fopen(options.exempt_file_name, "r");
+    char line[EXEMPT_LINE_SZ];
+    int line_num = 0;
+    int alloc = 0;
+    int i, j;
+
+    if(!file)
+    {
+        error(EXIT_FAILURE, errno, "Unable to open exemption file `%s'", options.exempt_file_name);
+    }
+    while(fgets(line, sizeof(line), file))
+    {
+        /* hyphen_ptr: Address of hyphen separating the timecodes */
+        /* t0, t1: Start and end of range, in seconds */
+        char *hyphen_ptr;
+        double t0 = 0.0;
+        double t1 = INFINITY;
+
+        line_num++;
+        if(!strchr(line, '\n') && !feof(file))
+        {
+            error(EXIT_FAILURE, 0, "Line %d of exemption file `%s' is too long",
+                line_num, options.exempt_file_name);
+        }
+        line[strcspn(line, "#\r\n")] = 0;
+        if(line[strspn(line, " \t")] == 0)
+        {
+            continue;
+        }
+        hyphen_ptr = strchr(line, '-');
+        if(!hyphen_ptr || hyphen_ptr != strrchr(line, '-'))
+        {
+            error(EXIT_FAILURE, 0, "Line %d of exemption file `%s' isn't two timecodes separated by a hyphen",
+                line_num, options.exempt_file_name);
+        }
+        *hyphen_ptr = 0;
+        if(!scan_time_code(line, 0.0, &t0) || !scan_time_code(hyphen_ptr + 1, INFINITY, &t1) || t1 < t0)
+        {
+            error(EXIT_FAILURE, 0, "Line %d of exemption file `%s' has a malformed time range",
+                line_num, options.exempt_file_name);
+        }
+        if(state.exempt_win_cnt == alloc)
+        {
+            alloc = alloc ? alloc * 2 : 64;
+            state.exempt_wins = counted_realloc(state.exempt_wins, sizeof(exempt_win_t) * alloc);
+            if(!state.exempt_wins)
+            {
+                error(EXIT_FAILURE, errno, "Unable to allocate memory for exempt windows");
+            }
+        }
+        state.exempt_wins[state.exempt_win_cnt].start = (sf_count_t)(t0 * (double)state.samplerate);
+        state.exempt_wins[state.exempt_win_cnt].end = (t1 < INFINITY)
+            ? (sf_count_t)(t1 * (double)state.samplerate) : SF_COUNT_MAX;
+        state.exempt_win_cnt++;
+    }
+    if(ferror(file))
+    {
+        error(EXIT_FAILURE, errno, "Error while reading exemption file `%s'", options.exempt_file_name);
+    }
+    fclose(file);
+
+    qsort(state.exempt_wins, state.exempt_win_cnt, sizeof(exempt_win_t), compare_exempt_wins);
+    for(i = 0, j = -1; i < state.exempt_win_cnt; i++)
+    {
+        if(state.exempt_wins[i].end <= state.exempt_wins[i].start)
+        {
+            continue;
+        }
+        else if(j >= 0 && state.exempt_wins[i].start <= state.exempt_wins[j].end)
+        {
+            if(state.exempt_wins[i].end > state.exempt_wins[j].end)
+            {
+                state.exempt_wins[j].end = state.exempt_wins[i].end;
+            }
+        }
+        else
+        {
+            state.exempt_wins[++j] = state.exempt_wins[i];
+        }
+    }
+    verbose("Read %d exempt windows from `%s'; %d after joining",
+        state.exempt_win_cnt, options.exempt_file_name, j + 1);
+    state.exempt_win_cnt = j + 1;
+}
+
+/** Sets up the --exempt windows (if given), and the cursor that
+    #update_context moves through them. */
+static void init_exemption(void)
+{
+    state.exempt_cur = 0;
+    state.exempt_on = FALSE;
+    state.exempt_edge = SF_COUNT_MAX;
+    if(options.exempt_file_name)
+    {
+        load_exempt_file();
+        if(state.exempt_win_cnt > 0)
+        {
+            state.exempt_edge = state.exempt_wins[0].start;
+        }
+    }
+}
+
+/** Sets up the --adaptive-floor tracker (if enabled). Every sub-window
+    starts off as if its least energy gave the --noise-floor threshold,
+    so the floor starts out there and is tracked from the recording once
+    the window has passed. */
+static void init_floor_tracker(void)
+{
+    /* seed: Energy the window starts off with */
+    /* x_lowest: #FLOOR_MIN_DBFS as a linear level */
+    /* i: Index into state.floor_sub_min */
+    double seed;
+    double x_lowest;
+    int i;
+
+    state.floor_hop_left = SF_COUNT_MAX;
+    if(options.adaptive_floor_margin <= 0.0)
+    {
+        return;
+    }
+    state.floor_ratio = pow(10.0, options.adaptive_floor_margin / 10.0);
+    x_lowest = pow(10.0, FLOOR_MIN_DBFS / 20.0);
+    state.floor_lowest = x_lowest * x_lowest * (double)state.rms_window_len;
+    seed = state.n_x_nf_sq / state.floor_ratio;
+    for(i = 0; i < FLOOR_SUBWIN_CNT; i++)
+    {
+        state.floor_sub_min[i] = seed;
+    }
+    state.floor_old_min = seed;
+    state.floor_sub_idx = 0;
+    state.floor_sub_len = (int)((sf_count_t)options.floor_window * state.samplerate
+        / state.rms_window_len / FLOOR_SUBWIN_CNT);
+    if(state.floor_sub_len < 1)
+    {
+        state.floor_sub_len = 1;
+    }
+    state.floor_sub_left = state.floor_sub_len;
+    state.floor_hop_left = state.rms_window_len;
+    verbose("Tracking noise floor %.2f dB above the least energy over %d sub-windows of %d hops",
+        options.adaptive_floor_margin, FLOOR_SUBWIN_CNT, state.floor_sub_len);
+}
+
+/** Works out the track-cutting thresholds, in frames and as a sum of
+    squares over the RMS window, from the options. */
+static void init_detector(void)
+{
+    /* x_nf: Noise floor as a linear level */
+    double x_nf = exp2(options.noise_floor_dbfs / (20.0 * log10(2)));
+
+    verbose("x_nf = %lf", x_nf);
+    state.n_x_nf_sq = x_nf * x_nf * (double)state.rms_window_len;
+    verbose("n(x_nf)^2 = %lf", state.n_x_nf_sq);
+    state.min_silence_len = state.samplerate * options.min_silence_period / 1000;
+    state.min_signal_len = state.samplerate * options.min_signal_period / 1000;
+    state.min_track_len = state.samplerate * options.min_track_length;
+    verbose("Minimum silence period is %d frames", state.min_silence_len);
+    verbose("Minimum signal period is %d frames", state.min_signal_len);
+    verbose("Minimum track length is %d frames", state.min_track_len);
+    init_floor_tracker();
+    init_exemption();
+}
+
+/** Sets the analysis statistics to their starting values. */
+static void init_analysis(void)
+{
+    /* c: Current channel in iterative loops */
+    int c;
+
+    for(c = 0; c < state.numchannels; c++)
+    {
+        state.min_rms[c] = INFINITY;
+        state.pos_peak[c] = -INFINITY;
+        state.neg_peak[c] = INFINITY;
+    }
+}
+
+/** This function must be called before entering #cutter_loop or #analyser_loop. */
+static void init_state(void)
+{
+    /* c: Current channel in iterative loops */
+    /* dt: small-delta-t, interval between frames (in seconds). */
+    /* tau: Time constant of the high-pass filter (in seconds) */
+    /* t0: Start of span, for --trace */
+    int c;
+    double dt;
+    double tau;
+    int64_t t0;
+    
+    memset(&state, 0, sizeof(state));
+    state.cut.track_num = 1;
+    if(options.profile)
+    {
+        if(options.profile_counters)
+        {
+            perf_open_counters();
+        }
+        state.prof.track_latency_alloc = PROFILE_TRACK_LATENCY_LEN;
+        state.prof.track_latency = counted_malloc(sizeof(double) * PROFILE_TRACK_LATENCY_LEN);
+        if(!state.prof.track_latency)
+        {
+            error(EXIT_FAILURE, errno, "Unable to allocate memory for profile");
+        }
+        prof_calibrate();
+        if(state.prof.perf_cnt)
+        {
+            perf_read_counters(state.prof.perf_start);
+        }
+        state.prof.start_ns = prof_clock();
+    }
+    if(options.metrics_file_name)
+    {
+        init_metrics();
+    }
+
+    if(options.verbose)
+    {
+        char sf_ver_str[128];
+        sf_command(NULL, SFC_GET_LIB_VERSION, sf_ver_str, sizeof(sf_ver_str));
+        verbose("libsndfile version: %s", sf_ver_str);
+    }
+    
+    if(options.batch)
+    {
+        open_batch_input_files();
+    }
+    else
+    {
+        open_input_file();
+    }
+    if(options.profile && strcmp(stdin_description, options.in_file_name) != 0)
+    {
+        /* st: Attributes of the input file, looked up before any chdir() */
+        struct stat st;
+
+        if(stat(options.in_file_name, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            state.prof.in_file_bytes = st.st_size;
+        }
+    }
+    if(options.copy_frames)
+    {
+        open_copy_source();
+    }
+    state.rms_window_len = state.samplerate * RMS_WINDOW_PERIOD / 1000;
+    verbose("RMS window is %d frames", state.rms_window_len);
+    plan_memory();
+    if(options.trace_file_name)
+    {
+        init_trace();
+    }
+    if(options.energy_map_file_name)
+    {
+        init_energy_map();
+    }
+    if(options.decision_trace_file_name)
+    {
+        init_decision_trace();
+    }
+    state.sq_buf = arena_alloc((sf_count_t)state.rms_window_len * state.frame_sz);
+    state.sq_buf_edge = state.sq_buf + state.rms_window_len * state.numchannels;
+    state.sq_buf_cen = state.sq_buf + (state.rms_window_len / 2) * state.numchannels;
+    state.main_buf = arena_alloc((sf_count_t)state.rms_window_len * state.frame_sz);
+    state.main_buf_edge = state.main_buf + state.rms_window_len * state.numchannels;
+    state.main_buf_cen = state.main_buf + (state.rms_window_len / 2) * state.numchannels;
+    state.ra_frame_cnt = (state.main_buf_edge - state.main_buf_cen) / state.numchannels; 
+    verbose("Read-ahead period is %d frames", state.ra_frame_cnt);
+    if(options.output_filter != OFM_SAME)
+    {
+        state.raw_buf = arena_alloc((sf_count_t)state.rms_window_len * state.frame_sz);
+    }
+    if(!options.batch && !options.in_mem)
+    {
+        state.rd_buf = arena_alloc((sf_count_t)options.read_block_len * state.frame_sz);
+        verbose("Read block is %d frames", options.read_block_len);
+    }
+    if(options.high_pass_corner >= state.samplerate / 2.0)
+    {
+        error(EXIT_FAILURE, 0, "High-pass corner frequency of %gHz must be below half the "
+            "sampling rate of `%s' (%dHz)", options.high_pass_corner, options.in_file_name, state.samplerate);
+    }
+    dt = 1.0 / (double)state.samplerate;
+    tau = 1.0 / (2.0 * M_PI * options.high_pass_corner);
+    state.alpha = tau / (tau + dt);
+    verbose("HPF alpha = %lf", state.alpha);
+    
+    /* Slurp initial half-buffer of frames and prepare RMS buffer and
+       filter state. The assertion can be made at this point that no
+       wrapping in the queues occur, so we can treat the queues as
+       flat arrays. */
+    t0 = trace_begin();
+    if(options.batch)
+    {
+        for(c = 0; c < state.numchannels; c++)
+        {
+            sf_count_t i;
+
+            for(i = 0; i < state.ra_frame_cnt
+                && lane_read_sample(&state.lanes[c], &state.main_buf_cen[i * state.numchannels + c]); i++)
+            {
+            }
+        }
+    }
+    else if(options.in_mem)
+    {
+        /* n: Number of frames available for the read-ahead */
+        sf_count_t n = options.in_sfinfo.frames - state.in_mem_pos;
+
+        n = (n < state.ra_frame_cnt) ? n : state.ra_frame_cnt;
+        memcpy(state.main_buf_cen, options.in_mem + state.in_mem_pos * state.numchannels,
+            n * state.frame_sz);
+        state.in_mem_pos += n;
+    }
+    else if(sf_readf_double(state.in_file, state.main_buf_cen, state.ra_frame_cnt) < 0)
+    {
+        error(EXIT_FAILURE, 0, "Cannot read leading part of `%s': %s",
+            options.in_file_name, sf_strerror(state.in_file));
+    }
+    state.frames_read_ttl = state.ra_frame_cnt;
+    trace_end("read_ahead", "io", t0, "frames", state.ra_frame_cnt);
+    t0 = trace_begin();
+    /* Temporarily borrow the head pointer as a loop counter, since
+       filter_new_frame() expects it to point to the newest frame. */
+    state.main_buf_head = state.main_buf_cen;
+    state.sq_buf_head = state.sq_buf_cen;  
+    while(state.main_buf_head < state.main_buf_edge)
+    {
+        filter_new_frame();
+        state.main_buf_head += state.numchannels;
+        state.sq_buf_head += state.numchannels;
+    }
+    trace_end("prime_filter", "dsp", t0, "frames", state.ra_frame_cnt);
+    state.main_buf_head = state.main_buf_edge - state.numchannels;
+    state.main_buf_tail = state.main_buf;
+    state.sq_buf_head = state.sq_buf_edge - state.numchannels;
+    state.sq_buf_tail = state.sq_buf;
+    /* main_buf[] has been DC corrected (and HP-filtered if enabled) */
+    /* sq_buf[] is now populated */
+    /* x_sq_ttl[] is now available */
+    
+    if(options.task == TCT_CUTTING)
+    {
+        init_detector();
+        if(options.cut_point_action == CPA_EXTRACT_TRACK)
+        {
+            state.leadin_buf_len = state.min_signal_len;
+            state.leadin_buf = arena_alloc((sf_count_t)state.leadin_buf_len * state.frame_sz);
+            state.leadin_buf_edge = state.leadin_buf + state.numchannels * state.leadin_buf_len;
+            state.leadin_buf_end = state.leadin_buf;
+            verbose("Lead-in buffer is %d frames", state.leadin_buf_len);
+            state.gap_buf_len = (sf_count_t)state.samplerate * options.pre_gap_period / 1000;
+            if(state.gap_buf_len > 0)
+            {
+                state.gap_buf = arena_alloc((sf_count_t)state.gap_buf_len * state.frame_sz);
+                verbose("Pre-gap is %d frames", state.gap_buf_len);
+            }
+            state.post_gap_len = (sf_count_t)state.samplerate * options.post_gap_period / 1000;
+            if(state.post_gap_len > 0)
+            {
+                verbose("Post-gap is %d frames", state.post_gap_len);
+            }
+            if(options.output_filter == OFM_DC)
+            {
+                state.dc_half_len = state.samplerate * OUTPUT_DC_WINDOW_PERIOD / 2000;
+                state.dc_buf_len = 2 * state.dc_half_len + 1;
+                state.dc_buf = arena_alloc((sf_count_t)state.dc_buf_len * state.frame_sz);
+                verbose("Output DC window is %d frames", state.dc_buf_len);
+            }
+            if(options.cd_frames && state.samplerate != 44100)
+            {
+                error(0, 0, "warning: CD frames are %d samples at 44100Hz, but `%s' is sampled at %dHz",
+                    CD_FRAME_LEN, options.in_file_name, state.samplerate);
+            }
+            state.out_file_name_buf_sz = OUT_FILE_NAME_BUF_SZ;
+            state.out_file_name_buf = counted_malloc(OUT_FILE_NAME_BUF_SZ);
+            if(!state.out_file_name_buf)
+            {
+                error(EXIT_FAILURE, errno, "Unable to allocate memory for output file name");
+            }
+            if(options.manifest_file_name || options.tar_output || options.copy_frames)
+            {
+                init_out_io();
+            }
+            if(!options.copy_frames)
+            {
+                state.wr_buf = arena_alloc((sf_count_t)options.write_block_len * state.frame_sz);
+                if(track_sample_bits())
+                {
+                    state.wr_qbuf = arena_alloc((sf_count_t)options.write_block_len
+                        * state.numchannels * sizeof(int));
+                }
+                verbose("Write block is %d frames", options.write_block_len);
+            }
+        }
+        if(options.track_names_file_name && !options.shard_cnt)
+        {
+            open_track_names_file();
+        }
+        
+        if(options.cut_point_action == CPA_LOG_POINT)
+        {
+            create_cuts_file();
+        }
+        else if(options.cut_point_action == CPA_EXTRACT_TRACK)
+        {
+            if(options.manifest_file_name)
+            {
+                create_manifest_file();
+            }
+            if(options.tar_output)
+            {
+                verbose("Writing tracks to %s as a tar archive", stdout_description);
+            }
+            else
+            {
+                /* Changing the working directory means that we no longer
+                   have to worry about path separators in track file names.
+                   This is only possible once we've finished setting up all
+                   other input/output files. */
+                if(chdir(options.track_directory) < 0)
+                {
+                    error(EXIT_FAILURE, errno, "Unable to change to track directory `%s'",
+                        options.track_directory);
+                }
+                verbose("Changed working directory to `%s'", options.track_directory);
+            }
+        }
+        
+        state.cut.context = CCTX_SILENCE;
+    }
+    else if(options.task == TCT_ANALYSIS)
+    {
+        init_analysis();
+        if(options.shard_cnt)
+        {
+            create_cuts_file();
+        }
+    }
+    if(!options.in_mem)
+    {
+        /* Not wanted by the library interface, which leaves standard
+           error and SIGUSR1 to the host program */
+        init_progress();
+    }
+}
+
+/** Main cutter loop.
+
+    @param next_frame Function that advances to the next frame, with the
+    same semantics as #fetch_next_frame (which is passed in normally;
+    --merge passes #merge_next_frame instead). */
+static void cutter_loop(int (*next_frame)(void))
+{
+    /* loop_t0: Clock reading at start of loop (--profile only) */
+    /* loop_allocs: Heap allocations made before the loop */
+    int64_t loop_t0 = options.profile ? prof_clock() : 0;
+    unsigned long loop_allocs = alloc_cnt;
+
+    if(state.trace.ring)
+    {
+        trace_end_block();
+    }
+    do
+    {
+        /* t0: Start of stage being timed (--profile only) */
+        /* prev: Cut context before this frame (--trace and --decision-trace only) */
+        int64_t t0;
+        cut_context_t prev = state.cut.context;
+
+        prof_next_frame();
+        t0 = prof_stage_begin(PST_DETECT);
+        update_context();
+        prof_stage_end(PST_DETECT, t0);
+        if(state.trace.ring && state.cut.context != prev)
+        {
+            trace_cut_context(prev);
+        }
+        energy_map_next_frame();
+        decision_trace_next_frame(prev);
+        trace_next_frame();
+        progress_next_frame();
+    }
+    while(next_frame() && state.cut.track_num <= options.track_num_end);
+    if(options.profile)
+    {
+        state.prof.loop_ns = prof_clock() - loop_t0;
+        state.prof.loop_allocs = alloc_cnt - loop_allocs;
+    }
+    if(state.trace.ring)
+    {
+        trace_end_block();
+    }
+
+    if(state.frames_remaining == 0)
+    {
+        if(options.verbose)
+        {
+            char cur_time_s[TIMECODE_STR_SZ];
+            verbose("End of input reached at frame %lld (%s). Exiting.",
+                state.cur_frame_pos, 
+                render_frame_idx_as_timecode(cur_time_s, state.cur_frame_pos));
+        }
+        force_end_of_track(state.cut.context);
+    }
+    else if(state.cut.track_num > options.track_num_end)
+    {
+        verbose("No more tracks remaining. Exiting.");
+    }
+    finish_progress();
+}
+
+/** Batch mode equivalent of #update_context, for one input file, given
+    whether its channel of the current frame counts as signal. */
+static void update_lane_context(lane_t *lane, int have_signal)
+{
+    switch(step_cut_context(&lane->cut, have_signal))
+    {
+        case CEV_FALSE_START:
+            report_false_positive(&lane->cut, lane->file_name);
+            break;
+        case CEV_TRACK_END:
+            print_cut_entry(lane->cuts, lane->cut.track_num, lane->cut.track_start,
+                state.cur_frame_pos, NULL);
+            lane->cut.track_num++;
+            break;
+        default:
+            break;
+    }
+}
+
+/** Batch mode cutter loop. The signal test for every input file is
+    done in one pass over the frame; the state machine is only stepped
+    for files that are still being processed. --exempt windows apply to
+    every file alike. Cut points are collected
+    per file and written out at the end, one table per file. */
+static void batch_loop(void)
+{
+    /* c: Current channel (input file) */
+    int c;
+
+    do
+    {
+        /* sig: Bit mask of channels that are above the noise floor */
+        unsigned sig = 0;
+
+        if(state.cur_frame_pos >= state.exempt_edge)
+        {
+            exempt_step();
+        }
+        for(c = 0; c < state.numchannels; c++)
+        {
+            sig |= (unsigned)(state.n_x_nf_sq < state.x_sq_ttl[c]) << c;
+        }
+        for(c = 0; c < state.numchannels; c++)
+        {
+            if(state.lanes[c].active)
+            {
+                update_lane_context(&state.lanes[c], state.exempt_on || ((sig >> c) & 1));
+            }
+        }
+        progress_next_frame();
+    }
+    while(batch_next_frame());
+    finish_progress();
+
+    for(c = 0; c < state.numchannels; c++)
+    {
+        lane_t *lane = &state.lanes[c];
+
+        fclose(lane->cuts);
+        fprintf(state.cuts_file, "%s==> %s <==\n", c ? "\n" : "", lane->file_name);
+        print_cuts_header();
+        fwrite(lane->cuts_buf, 1, lane->cuts_buf_sz, state.cuts_file);
+        if(ferror(state.cuts_file))
+        {
+            error(EXIT_FAILURE, errno, "Unable to write entries to cuts file `%s'",
+                options.cuts_file_name);
+        }
+        free(lane->cuts_buf);
+        sf_close(lane->file);
     }
 }
-    
-/** Retrieves another frame from the input file, and places it into the
-    head of the main buffer. The tail entry in the buffer will be
-    discarded. The @a sq_buf buffer will be updated accordingly, and the
-    incoming frame will be filtered through the high-pass filter if
-    enabled. If analysis mode is selected, the statistics will be
-    updated as well.
 
-    @return @c TRUE if more frames remaining in the input stream; @c
-    FALSE otherwise (any further attempts to call this function will
-    only produce padded-out silence). */
-static int fetch_next_frame(void)
+/** Prints analysis page header, customising it based on number of channels. */
+static void print_analysis_header(void)
 {
-    /* eof: Return result, set flag if no more frames left to process. */
-    /* rdcnt: Number of frames successfully read (1 if OK, 0 if EOF or -1 if error) */
-    int eof = FALSE;
-    int rdcnt;
+    printf("%-20s", "statistic");
+    if(state.numchannels == 1)
+    {
+        printf("mono_channel\n");
+    }
+    else if(state.numchannels == 2)
+    {
+        printf("%20s%20s\n", "left_channel", "right_channel");
+    }
+    else
+    {
+        int c;
+        for(c = 0; c < state.numchannels; c++)
+        {
+            printf("channel_%-6d", c);
+        }
+        printf("\n");
+    }
+}
 
-    /* Replace tail frame in buffer with new incoming frame */
-    if(!state.in_eof && state.frames_remaining > 0)
+static void print_analysis_row(const char *header, const char *format, double *fields)
+{
+    int c;
+
+    printf("%20s", header);
+    for(c = 0; c < state.numchannels; c++)
     {
-        /* Attempt to read next frame */
-        state.frames_remaining--;
-        rdcnt = sf_readf_double(state.in_file, state.main_buf_tail, 1);
-        if(rdcnt < 0)
+        char s[21];
+        snprintf(s, 21, format, fields[c]);
+        printf("%20s", s);
+    }
+    printf("\n");
+}
+
+/** Converts a sample level into a decibel full-scale amount (dbFS).
+
+    @param x Sample level to compute; should be in range [-1.0, +1.0].
+    @return dbFS power level (will be negative); negative infinity will
+    be returned if @a x is zero. */
+static double level_to_dbfs(double x)
+{
+    return (x != 0.0)
+        ? log2(fabs(x)) * (20.0 * log10(2))
+        : -INFINITY;
+}
+
+/** Returns the DC offset of channel @a c: the mean level of the frames
+    read, after --dc-offset correction. It's zero with --high-pass,
+    which removes DC offset before analysis. The result is reproducible
+    to the bit however the frames were divided between shards, and
+    within 2^-24 of full scale of the exact mean (see #DC_ACC_SCALE). */
+static double estimate_dc_offset(int c)
+{
+    return state.frames_read_ttl
+        ? (double)state.dc_acc[c] / DC_ACC_SCALE / (double)state.frames_read_ttl : 0.0;
+}
+
+/** Prints analysis page to standard output */
+static void print_analysis(void)
+{
+    int c;
+    double dc_offset[MAX_CHANNELS];
+    double dc_offset_dbfs[MAX_CHANNELS];
+    double avg_rms[MAX_CHANNELS];
+    double min_rms_dbfs[MAX_CHANNELS];
+    double max_rms_dbfs[MAX_CHANNELS];
+    double avg_rms_dbfs[MAX_CHANNELS];
+    double peak_dbfs[MAX_CHANNELS];
+
+    for(c = 0; c < state.numchannels; c++)
+    {
+        dc_offset[c] = estimate_dc_offset(c);
+        dc_offset_dbfs[c] = level_to_dbfs(dc_offset[c]);
+        avg_rms[c] = state.rms_ttl[c] / (double)state.frames_proc_ttl;
+        min_rms_dbfs[c] = level_to_dbfs(state.min_rms[c]);
+        max_rms_dbfs[c] = level_to_dbfs(state.max_rms[c]);
+        avg_rms_dbfs[c] = level_to_dbfs(avg_rms[c]);
+        peak_dbfs[c] = fmax(level_to_dbfs(state.pos_peak[c]), level_to_dbfs(state.neg_peak[c]));
+    }
+
+    print_analysis_header();
+    print_analysis_row("positive_peak", "  %+1.16f", state.pos_peak);
+    print_analysis_row("negative_peak", "  %+1.16f", state.neg_peak);
+    print_analysis_row("peak_dbfs", "  %+3.14f", peak_dbfs);
+    print_analysis_row("min_rms", "  %+1.16f", state.min_rms);
+    print_analysis_row("max_rms", "  %+1.16f", state.max_rms);
+    print_analysis_row("avg_rms", "  %+1.16f", avg_rms);
+    print_analysis_row("min_rms_dbfs", "  %+3.14f", min_rms_dbfs);
+    print_analysis_row("max_rms_dbfs", "  %+3.14f", max_rms_dbfs);
+    print_analysis_row("avg_rms_dbfs", "  %+3.14f", avg_rms_dbfs);
+    print_analysis_row("dc_offset", "  %+1.16f", dc_offset);
+    print_analysis_row("dc_offset_dbfs", "  %+3.14f", dc_offset_dbfs);
+    {
+        char s[MAX_CHANNELS * 16];
+        char *s_end;
+        int c;
+        
+        s_end = s + sprintf(s, "%+f", -dc_offset[0]);
+        for(c = 1; c < state.numchannels; c++)
         {
-            error(EXIT_FAILURE, errno, "Error while reading input file `%s'",
-                options.in_file_name);
+            s_end += sprintf(s_end, ",%+f", -dc_offset[c]);
         }
-        else if(rdcnt == 0)
+        printf("%20s  --dc-offset=%s\n", "fix_dc_offset_arg", s);
+    }
+}
+
+/** Comparison function for qsort(), for sorting doubles in ascending order */
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/** Returns the @a p-th percentile (nearest rank) of @a n sorted values in @a x */
+static double percentile(const double *x, int n, double p)
+{
+    /* rank: 1-based rank of the percentile */
+    int rank = (int)ceil(p / 100.0 * n);
+    return x[(rank > 0) ? rank - 1 : 0];
+}
+
+/** Prints one row of the hardware counter table in the --profile report.
+
+    @param name Name of stage
+    @param ctr Events counted, indexed by #perf_counter_t
+    @param scale Factor to scale @a ctr by (for sampled stages) */
+static void print_profile_counters(const char *name, const uint64_t *ctr, double scale)
+{
+    /* per_frame: Events per frame, indexed by #perf_counter_t */
+    /* have: Set for each counter that's available */
+    double per_frame[PCT_COUNT];
+    int have[PCT_COUNT];
+    int i;
+    int k;
+
+    memset(have, 0, sizeof(have));
+    for(i = 0; i < state.prof.perf_cnt; i++)
+    {
+        have[state.prof.perf_kind[i]] = TRUE;
+    }
+    for(k = 0; k < PCT_COUNT; k++)
+    {
+        per_frame[k] = state.prof.frames ? (double)ctr[k] * scale / (double)state.prof.frames : 0.0;
+    }
+    fprintf(stderr, "%-20s", name);
+    for(k = 0; k < PCT_COUNT; k++)
+    {
+        if(k == PCT_CACHE_MISSES)
         {
-            /* End of input file; pad out buffer with zero-silence frames. */
-            state.in_eof = TRUE;
-            if(state.ra_frame_cnt < state.frames_remaining)
+            /* Instructions per cycle goes between the two pairs */
+            if(have[PCT_CYCLES] && have[PCT_INSTRUCTIONS] && per_frame[PCT_CYCLES] > 0.0)
             {
-                state.frames_remaining = state.ra_frame_cnt;
+                fprintf(stderr, "%8.2f", per_frame[PCT_INSTRUCTIONS] / per_frame[PCT_CYCLES]);
             }
-            memset(state.main_buf_tail, 0, state.frame_sz);
+            else
+            {
+                fprintf(stderr, "%8s", "-");
+            }
+        }
+        if(have[k])
+        {
+            fprintf(stderr, "%14.2f", per_frame[k]);
         }
         else
         {
-            state.frames_read_ttl++;
+            fprintf(stderr, "%14s", "-");
         }
     }
-    else
+    fprintf(stderr, "\n");
+}
+
+/** Prints one row of the stage table in the --profile report. */
+static void print_profile_stage(const char *name, double ns, double total_ns)
+{
+    fprintf(stderr, "%-20s%14.6f%10.1f%14.1f\n", name, ns / 1e9, 100.0 * ns / total_ns,
+        state.prof.frames ? ns / (double)state.prof.frames : 0.0);
+}
+
+/** Returns the name of processing stage @a stage, as reported. */
+static const char *prof_stage_name(prof_stage_t stage)
+{
+    static const char *stage_s[] =
+        { "decode", "filter", "detect", "write", "track_open", "track_close" };
+
+    return (stage == PST_DETECT && options.task == TCT_ANALYSIS) ? "analysis" : stage_s[stage];
+}
+
+/** Works out the figures for the --profile report and --metrics from
+    the timings and counters collected.
+
+    Filtering and detection were only timed on a sample of frames, so
+    their totals are scaled up by the sampling ratio. Reading the clock
+    slows down the frames being timed a little (beyond the cost of the
+    reading itself, which is already deducted), so if the estimates add
+    up to more than the main loop was measured to take, less the stages
+    timed exactly, they're scaled back in proportion. Time in the main loop not accounted for by any stage is
+    "loop_other"; time outside it (opening files, the initial
+    read-ahead) is "setup". */
+static void summarise_profile(prof_summary_t *sum)
+{
+    /* sampled_ns: Sum of the sampled stages */
+    /* avail_ns: Time in the main loop outside the exactly-timed events */
+    /* usage: Resource usage of this process, for peak RSS */
+    double sampled_ns = 0.0;
+    double avail_ns = (double)state.prof.loop_ns;
+    struct rusage usage;
+    int i;
+
+    sum->scale = state.prof.sampled_frames
+        ? (double)state.prof.frames / (double)state.prof.sampled_frames : 0.0;
+    sum->total_ns = (double)(prof_clock() - state.prof.start_ns);
+    for(i = 0; i < PST_COUNT; i++)
     {
-        /* Pad out EOF overshoot with silence */
-        memset(state.main_buf_tail, 0, state.frame_sz);
-        if(state.frames_remaining > 0)
+        if(prof_stage_sampled(i))
         {
-            state.frames_remaining--;
+            sum->stage_ns[i] = (double)state.prof.stage_ns[i] * sum->scale;
+            sampled_ns += sum->stage_ns[i];
         }
         else
         {
-            eof = TRUE;
+            sum->stage_ns[i] = (double)state.prof.stage_ns[i];
+            avail_ns -= sum->stage_ns[i];
         }
     }
-    
-    state.cur_frame_pos++;
-    advance_buf_ptrs();
-    filter_new_frame();
-    return !eof;
+    if(sampled_ns > avail_ns && sampled_ns > 0.0)
+    {
+        for(i = 0; i < PST_COUNT; i++)
+        {
+            if(prof_stage_sampled(i))
+            {
+                sum->stage_ns[i] *= avail_ns / sampled_ns;
+            }
+        }
+        sampled_ns = avail_ns;
+    }
+    sum->other_ns = avail_ns - sampled_ns;
+    sum->setup_ns = sum->total_ns - (double)state.prof.loop_ns;
+    sum->in_bytes = (double)state.prof.in_file_bytes;
+    if(options.in_sfinfo.frames > 0 && options.in_sfinfo.frames != SF_COUNT_MAX)
+    {
+        sum->in_bytes = sum->in_bytes * (double)state.frames_read_ttl / (double)options.in_sfinfo.frames;
+    }
+    getrusage(RUSAGE_SELF, &usage);
+    sum->peak_rss_kib = usage.ru_maxrss;
 }
 
-/** Appends central frame in main buffer to lead-in buffer */
-static void leadin_buf_add(void)
+/** Prints the --profile report to standard error. */
+static void print_profile(void)
 {
-    if(options.cut_point_action == CPA_EXTRACT_TRACK)
+    /* sum: Figures worked out from the profile */
+    prof_summary_t sum;
+    double secs;
+    int i;
+
+    summarise_profile(&sum);
+    secs = sum.total_ns / 1e9;
+
+    fprintf(stderr, "\nProfile (filter and %s are estimated from 1 frame in %d):\n",
+        prof_stage_name(PST_DETECT), PROFILE_SAMPLE_PERIOD);
+    fprintf(stderr, "%-20s%14s%10s%14s\n", "stage", "seconds", "percent", "ns_per_frame");
+    for(i = 0; i < PST_COUNT; i++)
     {
-        if(state.leadin_buf_end < state.leadin_buf_edge)
+        print_profile_stage(prof_stage_name(i), sum.stage_ns[i], sum.total_ns);
+    }
+    print_profile_stage("loop_other", sum.other_ns, sum.total_ns);
+    print_profile_stage("setup", sum.setup_ns, sum.total_ns);
+    print_profile_stage("total", sum.total_ns, sum.total_ns);
+
+    if(state.prof.perf_cnt)
+    {
+        /* ctr: Counter readings now, then events counted over the whole run */
+        uint64_t ctr[PCT_COUNT];
+
+        fprintf(stderr, "\nHardware counters per frame%s:\n", state.prof.perf_multiplexed
+            ? " (counters were shared with other processes, so may be understated)" : "");
+        fprintf(stderr, "%-20s%14s%14s%8s%14s%14s\n", "stage",
+            "cycles", "instructions", "ipc", "cache_misses", "branch_misses");
+        for(i = 0; i < PST_COUNT; i++)
         {
-            memcpy(state.leadin_buf_end, state.main_buf_cen, state.frame_sz);
-            state.leadin_buf_end += state.numchannels;
+            print_profile_counters(prof_stage_name(i), state.prof.stage_ctr[i],
+                prof_stage_sampled(i) ? sum.scale : 1.0);
         }
-        else
+        perf_read_counters(ctr);
+        for(i = 0; i < PCT_COUNT; i++)
         {
-            error(0, 0, "warning: lead-in buffer is overflowing");
+            ctr[i] -= state.prof.perf_start[i];
         }
+        print_profile_counters("total", ctr, 1.0);
+    }
+
+    fprintf(stderr, "\n%-20s%14s\n", "counter", "value");
+    fprintf(stderr, "%-20s%14lld\n", "frames", (long long)state.prof.frames);
+    fprintf(stderr, "%-20s%14.0f\n", "input_bytes", sum.in_bytes);
+    fprintf(stderr, "%-20s%14lld\n", "output_bytes", (long long)state.prof.out_bytes);
+    fprintf(stderr, "%-20s%14d\n", "tracks", state.prof.tracks);
+    fprintf(stderr, "%-20s%14d\n", "false_positives", state.prof.false_positives);
+    fprintf(stderr, "%-20s%14.0f\n", "frames_per_sec", state.prof.frames / secs);
+    fprintf(stderr, "%-20s%14.2f\n", "input_mb_per_sec", sum.in_bytes / secs / 1e6);
+    fprintf(stderr, "%-20s%14.2f\n", "realtime_factor",
+        (double)state.prof.frames / (double)state.samplerate / secs);
+    fprintf(stderr, "%-20s%14ld\n", "peak_rss_kib", sum.peak_rss_kib);
+    fprintf(stderr, "%-20s%14lld\n", "window_buf_bytes",
+        2LL * state.rms_window_len * state.frame_sz);
+    fprintf(stderr, "%-20s%14lld\n", "leadin_buf_bytes",
+        (long long)state.leadin_buf_len * state.frame_sz);
+    fprintf(stderr, "%-20s%14lld\n", "arena_bytes", (long long)state.arena.size);
+    fprintf(stderr, "%-20s%14lu\n", "heap_allocations", alloc_cnt);
+    fprintf(stderr, "%-20s%14lu\n", "loop_allocations", state.prof.loop_allocs);
+    if(state.prof.tracks > 0)
+    {
+        qsort(state.prof.track_latency, state.prof.tracks, sizeof(double), compare_doubles);
+        fprintf(stderr, "%-20s%14.6f\n", "track_latency_p50",
+            percentile(state.prof.track_latency, state.prof.tracks, 50.0));
+        fprintf(stderr, "%-20s%14.6f\n", "track_latency_p90",
+            percentile(state.prof.track_latency, state.prof.tracks, 90.0));
+        fprintf(stderr, "%-20s%14.6f\n", "track_latency_p99",
+            percentile(state.prof.track_latency, state.prof.tracks, 99.0));
+        fprintf(stderr, "%-20s%14.6f\n", "track_latency_max",
+            state.prof.track_latency[state.prof.tracks - 1]);
     }
 }
 
-/** Commits contents of the lead-in buffer to the current output file */
-static void leadin_buf_commit(void)
+/** Writes @a s to @a file as a Prometheus label value. */
+static void write_prom_label_value(FILE *file, const char *s)
 {
-    if(options.cut_point_action == CPA_EXTRACT_TRACK)
+    fputc('"', file);
+    for(; *s; s++)
     {
-        int num_frames = (state.leadin_buf_end - state.leadin_buf) / state.numchannels;
-        if(sf_writef_double(state.out_file, state.leadin_buf, num_frames) < num_frames)
+        if(*s == '"' || *s == '\\')
         {
-            error(EXIT_FAILURE, 0, "Unable to write to output file `%s': %s",
-                state.out_file_name, sf_strerror(state.out_file));
+            fprintf(file, "\\%c", *s);
+        }
+        else if(*s == '\n')
+        {
+            fputs("\\n", file);
+        }
+        else
+        {
+            fputc(*s, file);
         }
     }
+    fputc('"', file);
 }
 
-/** Purges the lead-in buffer (when a stint of non-silence after a long
-    gap of silence is found to be an audio glitch instead). */
-static void leadin_buf_purge(void)
+/** Writes the run metrics for --metrics to @a file, as JSON or in the
+    Prometheus text exposition format. */
+static void print_metrics(FILE *file, int prom)
 {
-    if(options.cut_point_action == CPA_EXTRACT_TRACK)
+    /* sum: Figures worked out from the profile */
+    /* secs: Wall-clock duration of the run */
+    /* task_s: Name of the task carried out */
+    /* metrics: Scalar figures, named as in the JSON (and, with a
+       prefix, in Prometheus) */
+    prof_summary_t sum;
+    double secs;
+    const char *task_s = (options.task == TCT_ANALYSIS) ? "analyse" : "cut";
+    int i;
+
+    summarise_profile(&sum);
+    secs = sum.total_ns / 1e9;
     {
-        state.leadin_buf_end = state.leadin_buf;
+        const struct
+        {
+            const char *name;
+            const char *help;
+            double value;
+        } metrics[] =
+        {
+            { "duration_seconds", "Wall-clock time taken by the run", secs },
+            { "frames", "Frames processed", (double)state.prof.frames },
+            { "frames_per_second", "Frames processed per second", state.prof.frames / secs },
+            { "realtime_factor", "Seconds of audio processed per second",
+                (double)state.prof.frames / (double)state.samplerate / secs },
+            { "input_bytes", "Bytes of input consumed", floor(sum.in_bytes) },
+            { "output_bytes", "Bytes of track files written", (double)state.prof.out_bytes },
+            { "tracks", "Tracks completed", (double)state.prof.tracks },
+            { "false_positives", "Track starts abandoned as glitches", (double)state.prof.false_positives },
+            { "peak_rss_bytes", "Peak resident set size", sum.peak_rss_kib * 1024.0 },
+            { "end_time_seconds", "Time the run finished, in seconds since the epoch", (double)time(NULL) },
+        };
+        const int metric_cnt = sizeof(metrics) / sizeof(metrics[0]);
+
+        if(prom)
+        {
+            fprintf(file, "# HELP trackcutter_run_info Version, task and input of the run\n");
+            fprintf(file, "# TYPE trackcutter_run_info gauge\n");
+            fprintf(file, "trackcutter_run_info{version=\"%s\",task=\"%s\",input=", VERSION, task_s);
+            write_prom_label_value(file, options.in_file_name);
+            fprintf(file, "} 1\n");
+            for(i = 0; i < metric_cnt; i++)
+            {
+                fprintf(file, "# HELP trackcutter_%s %s\n", metrics[i].name, metrics[i].help);
+                fprintf(file, "# TYPE trackcutter_%s gauge\n", metrics[i].name);
+                fprintf(file, "trackcutter_%s %.15g\n", metrics[i].name, metrics[i].value);
+            }
+            fprintf(file, "# HELP trackcutter_stage_seconds Time spent in each stage of processing\n");
+            fprintf(file, "# TYPE trackcutter_stage_seconds gauge\n");
+            for(i = 0; i < PST_COUNT; i++)
+            {
+                fprintf(file, "trackcutter_stage_seconds{stage=\"%s\"} %.9f\n",
+                    prof_stage_name(i), sum.stage_ns[i] / 1e9);
+            }
+            fprintf(file, "trackcutter_stage_seconds{stage=\"loop_other\"} %.9f\n", sum.other_ns / 1e9);
+            fprintf(file, "trackcutter_stage_seconds{stage=\"setup\"} %.9f\n", sum.setup_ns / 1e9);
+        }
+        else
+        {
+            fprintf(file, "{\n  \"version\": \"%s\",\n  \"task\": \"%s\",\n  \"input\": ", VERSION, task_s);
+            write_json_string(file, options.in_file_name);
+            fprintf(file, ",\n");
+            for(i = 0; i < metric_cnt; i++)
+            {
+                fprintf(file, "  \"%s\": %.15g,\n", metrics[i].name, metrics[i].value);
+            }
+            fprintf(file, "  \"stage_seconds\": {\n");
+            for(i = 0; i < PST_COUNT; i++)
+            {
+                fprintf(file, "    \"%s\": %.9f,\n", prof_stage_name(i), sum.stage_ns[i] / 1e9);
+            }
+            fprintf(file, "    \"loop_other\": %.9f,\n", sum.other_ns / 1e9);
+            fprintf(file, "    \"setup\": %.9f\n  }\n}\n", sum.setup_ns / 1e9);
+        }
     }
 }
 
-/** Opens the input recording file, and seeks to the starting position if necessary. */
-static void open_input_file(void)
+/** Writes the --metrics file. It's written under a temporary name in
+    the same directory first, then renamed over the final name, so that
+    anything collecting it never sees a partly written file. The format
+    is chosen by the file name: Prometheus text format (as read by the
+    node_exporter textfile collector) if it ends in ".prom", otherwise
+    JSON. */
+static void write_metrics_file(void)
 {
-    if(options.in_file_name)
+    /* tmp_name: Temporary name to write the file under */
+    /* name_len: Length of the final file name */
+    /* fd, file: The temporary file */
+    size_t name_len = strlen(state.metrics_base_name);
+    char *tmp_name = counted_malloc(name_len + 32);
+    int fd;
+    FILE *file;
+
+    if(!tmp_name)
     {
-        state.in_file = sf_open(options.in_file_name, SFM_READ, &options.in_sfinfo);
-        if(!state.in_file)
-        {
-            error(EXIT_FAILURE, 0, "Unable to open `%s': %s", 
-                options.in_file_name, sf_strerror(NULL));
-        }
+        error(EXIT_FAILURE, errno, "Unable to allocate memory for metrics file name");
     }
-    else
+    snprintf(tmp_name, name_len + 32, ".%s.%ld.tmp", state.metrics_base_name, (long)getpid());
+    fd = openat(state.metrics_dir_fd, tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0 || !(file = fdopen(fd, "w")))
     {
-        options.in_file_name = stdin_description;
-        state.in_file = sf_open_fd(STDIN_FILENO, SFM_READ, &options.in_sfinfo, TRUE);
-        if(!state.in_file)
-        {
-            error(EXIT_FAILURE, 0, "Unable to identify file structure on standard input: %s", 
-                sf_strerror(NULL));
-        }
+        error(EXIT_FAILURE, errno, "Unable to create metrics file `%s'", options.metrics_file_name);
     }
-    verbose("Opened input file `%s'", options.in_file_name);
-    state.samplerate = options.in_sfinfo.samplerate;
-    state.numchannels = options.in_sfinfo.channels;
-    state.frame_sz = sizeof(double) * state.numchannels;
-    verbose("libsndfile file format code: %#08x", options.in_sfinfo.format);
-    verbose("Sampling rate: %dHz", options.in_sfinfo.samplerate);
-    verbose("Number of channels: %d", options.in_sfinfo.channels);
-    if(options.time_range_given)
+    print_metrics(file, name_len > 5 && strcmp(state.metrics_base_name + name_len - 5, ".prom") == 0);
+    if(fflush(file) != 0 || fsync(fd) < 0 || fclose(file) != 0
+        || renameat(state.metrics_dir_fd, tmp_name, state.metrics_dir_fd, state.metrics_base_name) < 0)
     {
-        /* Convert time range to frame range, now that sample rate is known. */
-        options.start_frame_idx = (sf_count_t)(options.start_time * (double)state.samplerate);
-        options.end_frame_idx = (options.end_time < INFINITY)
-            ? (sf_count_t)(options.end_time * (double)state.samplerate)
-            : SF_COUNT_MAX;
-        verbose("Translated time range %.5f-%.5f to frame indices %lld-%lld",
-            options.start_time, options.end_time, options.start_frame_idx, options.end_frame_idx);
+        /* err: Cause of failure, before unlinkat() has a chance to change it */
+        int err = errno;
+
+        unlinkat(state.metrics_dir_fd, tmp_name, 0);
+        error(EXIT_FAILURE, err, "Unable to write metrics file `%s'", options.metrics_file_name);
+    }
+    verbose("Wrote run metrics to `%s'", options.metrics_file_name);
+    close(state.metrics_dir_fd);
+    free(tmp_name);
+}
+
+/** Main analyser loop */
+static void analyser_loop(void)
+{
+    /* loop_t0: Clock reading at start of loop (--profile only) */
+    /* loop_allocs: Heap allocations made before the loop */
+    int64_t loop_t0 = options.profile ? prof_clock() : 0;
+    unsigned long loop_allocs = alloc_cnt;
+
+    if(state.trace.ring)
+    {
+        trace_end_block();
+    }
+    do
+    {
+        /* t0: Start of stage being timed (--profile only) */
+        int64_t t0;
+
+        prof_next_frame();
+        t0 = prof_stage_begin(PST_DETECT);
+        analyse_new_frame();
+        prof_stage_end(PST_DETECT, t0);
+        energy_map_next_frame();
+        trace_next_frame();
+        progress_next_frame();
+    }
+    while(fetch_next_frame());
+    if(options.profile)
+    {
+        state.prof.loop_ns = prof_clock() - loop_t0;
+        state.prof.loop_allocs = alloc_cnt - loop_allocs;
     }
-    if(options.start_frame_idx > 0)
+    if(state.trace.ring)
     {
-        /* Reposition input file to starting frame if not zero */
-        if(sf_seek(state.in_file, options.start_frame_idx, SEEK_SET) < 0)
-        {
-            error(EXIT_FAILURE, 0, "Unable to reposition input to frame %lld: %s",
-                options.start_frame_idx, sf_strerror(state.in_file));
-        }
-        verbose("Repositioned input to frame %lld", options.start_frame_idx);
+        trace_end_block();
     }
-    state.cur_frame_pos = options.start_frame_idx;
-    state.frames_remaining = options.end_frame_idx - options.start_frame_idx;
+    finish_progress();
+    
+    print_analysis();
 }
 
-/** Opens the track names file given, and skips through leading entries if needed. */
-static void open_track_names_file(void)
+/** Main loop in shard mode. Runs the same per-frame processing as
+    #cutter_loop or #analyser_loop, but only accounts for the frames in
+    this shard's slice, and writes the outcome to a partial-state file
+    rather than printing a report. In cutting mode, the signal decision
+    for each frame is recorded as run descriptors; the state machine
+    itself is run by --merge over the runs of all shards. In analysis
+    mode, the statistics are accumulated over the slice only.
+
+    Statistics that are accumulated as each frame enters the head of the
+    buffers (rather than the centre) are reset one frame before the
+    slice begins, so that every frame of the recording is accounted for
+    by exactly one shard. */
+static void shard_loop(void)
 {
-    if(strcmp(options.track_names_file_name, stdin_file_name) != 0)
+    /* last: Set if this is the final shard, which runs to the end of input */
+    /* c: Current channel in iterative loops */
+    int last = options.shard_idx == options.shard_cnt;
+    int c;
+
+    do
     {
-        state.track_names_file = fopen(options.track_names_file_name, "r");
-        if(!state.track_names_file)
+        if(state.cur_frame_pos + 1 == state.shard_slice_start)
         {
-            error(EXIT_FAILURE, errno, "Unable to open track names file `%s'",
-                options.track_names_file_name);
+            state.frames_read_ttl = 0;
+            state.frames_proc_ttl = 0;
+            for(c = 0; c < state.numchannels; c++)
+            {
+                state.dc_acc[c] = 0;
+            }
+        }
+        else if(state.cur_frame_pos >= state.shard_slice_start)
+        {
+            if(options.task == TCT_CUTTING)
+            {
+                record_shard_decision();
+            }
+            else if(options.task == TCT_ANALYSIS)
+            {
+                analyse_new_frame();
+            }
         }
+        progress_next_frame();
     }
-    else
+    while((last || state.cur_frame_pos + 1 < state.shard_slice_end) && fetch_next_frame());
+
+    finish_progress();
+    if(last)
     {
-        state.track_names_file = stdin;
-        options.track_names_file_name = stdin_description;
+        state.shard_slice_end = state.cur_frame_pos;
     }
-    verbose("Opened track names file `%s'", options.track_names_file_name);
+    print_shard_trailer();
+    verbose("Wrote partial state for frames %lld-%lld to `%s'",
+        state.shard_slice_start, state.shard_slice_end, options.cuts_file_name);
+}
 
-    /* Need to consume lines if starting from track > 1 */
-    for(state.cur_track_num = 1; 
-        state.cur_track_num < options.track_num_start && !feof(state.track_names_file); 
-        state.cur_track_num++)
+/** Reads the next line of a shard partial-state file into @a line,
+    skipping blank lines and comments. Terminates program with an error
+    message if the file can't be read or the line is too long.
+
+    @return @c TRUE if a line was read; @c FALSE at end of file. */
+static int read_shard_line(shard_file_t *sf, char *line)
+{
+    do
     {
-        int x = fgetc(state.track_names_file);
-        while(x != '\n' && x != EOF)
+        if(!fgets(line, SHARD_LINE_SZ, sf->file))
         {
-            x = fgetc(state.track_names_file);
+            if(ferror(sf->file))
+            {
+                error(EXIT_FAILURE, errno, "Error while reading partial-state file `%s'",
+                    sf->file_name);
+            }
+            return FALSE;
         }
-        if(ferror(state.track_names_file))
+        if(!strchr(line, '\n') && !feof(sf->file))
         {
-            error(EXIT_FAILURE, errno, "Error while reading track names file `%s'", 
-                options.track_names_file_name);
+            error(EXIT_FAILURE, 0, "Line too long in partial-state file `%s'", sf->file_name);
         }
     }
-    if(feof(state.track_names_file))
-    {
-        /* If we've already exhausted all the track names before
-           we start, then close off the input file and pretend
-           we never heard of it. All further tracks will be numbered only. */
-        fclose(state.track_names_file);
-        state.cur_track_num = options.track_num_start;
-        state.track_names_file = NULL;
-    }
+    while(line[strspn(line, " \t\r\n")] == 0 || line[0] == '#');
+    return TRUE;
 }
 
-/** Creates cuts log file */
-static void create_cuts_file(void)
+/** Opens a shard partial-state file and parses its header, up to and
+    including the @c slice_start line. Terminates program with an error
+    message if the file is malformed. */
+static void read_shard_header(shard_file_t *sf)
 {
-    if(options.cuts_file_name && strcmp(options.cuts_file_name, stdout_file_name) != 0)
+    /* line: Current line of the file */
+    /* key: Keyword at start of current line */
+    /* version: File format version */
+    /* task_s: Task name given in file */
+    char line[SHARD_LINE_SZ];
+    char key[32];
+    int version = 0;
+    char task_s[16];
+
+    if(strcmp(sf->file_name, stdin_file_name) != 0)
     {
-        state.cuts_file = fopen(options.cuts_file_name, "w");
-        if(!state.cuts_file)
+        sf->file = fopen(sf->file_name, "r");
+        if(!sf->file)
         {
-            error(EXIT_FAILURE, errno, "Unable to create cuts file `%s'",
-                options.cuts_file_name);
+            error(EXIT_FAILURE, errno, "Unable to open partial-state file `%s'", sf->file_name);
         }
     }
     else
     {
-        state.cuts_file = stdout;
-        options.cuts_file_name = stdout_description;
+        sf->file = stdin;
+        sf->file_name = stdin_description;
     }
-    setvbuf(state.cuts_file, NULL, _IOLBF, BUFSIZ);
-    print_cuts_header();
-    verbose("Opened cuts file `%s'", options.cuts_file_name);
-}
 
-/** Retrieves next track name into @a state.cur_track_name. @a
-    state.cur_track_name will be set to @c NULL if no track name is
-    available. */
-static void fetch_next_track_name(void)
-{
-    if(state.track_names_file)
+    if(!read_shard_line(sf, line) || sscanf(line, "trackcutter-shard %d", &version) != 1)
     {
-        /* name_len: Length of name returned by getline() */
-        int name_len = getline(&state.cur_track_name, &state.cur_track_name_sz, state.track_names_file);
-        
-        if(name_len > 0)
+        error(EXIT_FAILURE, 0, "`%s' is not a trackcutter partial-state file", sf->file_name);
+    }
+    else if(version != SHARD_FILE_VERSION)
+    {
+        error(EXIT_FAILURE, 0, "Partial-state file `%s' has unsupported version %d",
+            sf->file_name, version);
+    }
+    sf->slice_start = -1;
+    sf->task = TCT_MERGE;
+    while(sf->slice_start < 0)
+    {
+        /* ok: Set if the line was parsed successfully */
+        int ok;
+
+        if(!read_shard_line(sf, line) || sscanf(line, "%31s", key) != 1)
         {
-            while(name_len > 0 && isspace(state.cur_track_name[name_len - 1]))
-            {
-                /* Trim trailing whitespace, including terminating newline. */
-                name_len--;
-            }
-            state.cur_track_name[name_len] = 0;
+            error(EXIT_FAILURE, 0, "Premature end of header in partial-state file `%s'",
+                sf->file_name);
         }
-        else if(feof(state.track_names_file))
+        if(strcmp(key, "shard") == 0)
         {
-            /* No more names left - close track name file, rest of tracks shall be numbered. */
-            fclose(state.track_names_file);
-            state.track_names_file = NULL;
-            if(state.cur_track_name)
-            {
-                free(state.cur_track_name);
-                state.cur_track_name = NULL;
-                state.cur_track_name_sz = 0;
-            }
+            ok = sscanf(line, "%*s %d %d", &sf->shard_idx, &sf->shard_cnt) == 2;
         }
-        else if(ferror(state.track_names_file))
+        else if(strcmp(key, "task") == 0)
         {
-            error(EXIT_FAILURE, errno, "Unable to read track names file `%s'",
-                options.track_names_file_name);
+            ok = sscanf(line, "%*s %15s", task_s) == 1;
+            sf->task = (strcmp(task_s, "cutting") == 0) ? TCT_CUTTING
+                : (strcmp(task_s, "analysis") == 0) ? TCT_ANALYSIS
+                : TCT_MERGE;
+            ok = ok && sf->task != TCT_MERGE;
+        }
+        else if(strcmp(key, "samplerate") == 0)
+        {
+            ok = sscanf(line, "%*s %d", &sf->samplerate) == 1 && sf->samplerate > 0;
+        }
+        else if(strcmp(key, "channels") == 0)
+        {
+            ok = sscanf(line, "%*s %d", &sf->numchannels) == 1
+                && sf->numchannels > 0 && sf->numchannels <= MAX_CHANNELS;
+        }
+        else if(strcmp(key, "frame_range") == 0)
+        {
+            ok = sscanf(line, "%*s %lld %lld", &sf->start_frame_idx, &sf->end_frame_idx) == 2;
+        }
+        else if(strcmp(key, "min_signal_len") == 0)
+        {
+            ok = sscanf(line, "%*s %d", &sf->min_signal_len) == 1;
+        }
+        else if(strcmp(key, "min_silence_len") == 0)
+        {
+            ok = sscanf(line, "%*s %d", &sf->min_silence_len) == 1;
+        }
+        else if(strcmp(key, "min_track_len") == 0)
+        {
+            ok = sscanf(line, "%*s %d", &sf->min_track_len) == 1;
+        }
+        else if(strcmp(key, "slice_start") == 0)
+        {
+            ok = sscanf(line, "%*s %lld", &sf->slice_start) == 1 && sf->slice_start >= 0;
+        }
+        else
+        {
+            /* Unknown keywords are skipped, for the benefit of later versions */
+            ok = TRUE;
         }
+        if(!ok)
+        {
+            error(EXIT_FAILURE, 0, "Malformed `%s' entry in partial-state file `%s'",
+                key, sf->file_name);
+        }
+    }
+    if(sf->task == TCT_MERGE || sf->shard_cnt <= 0 || !sf->samplerate || !sf->numchannels)
+    {
+        error(EXIT_FAILURE, 0, "Incomplete header in partial-state file `%s'", sf->file_name);
     }
 }
 
-/** Creates a new output file for the current track */
-static void create_new_out_file(void)
+/** Comparison function for sorting partial-state files by shard number through @c qsort(). */
+static int compare_shard_files(const void *a, const void *b)
 {
-    /* sf_info: Used for specifying parameters of output file */
-    /* extension: File extension used for output file (minus leading period) */
-    SF_INFO sf_info;
-    const char *extension = NULL;
+    return ((const shard_file_t *)a)->shard_idx - ((const shard_file_t *)b)->shard_idx;
+}
 
-    fetch_next_track_name();
-    sf_info.format = options.out_sfinfo_format
-        ? options.out_sfinfo_format
-        : options.in_sfinfo.format;
-    sf_info.format = (sf_info.format & SF_FORMAT_TYPEMASK)
-        | (options.in_sfinfo.format & (SF_FORMAT_SUBMASK | SF_FORMAT_ENDMASK));
+/** Reads the @c slice_end entry that terminates the runs of a shard's
+    partial-state file, and checks that it is where the previous shard
+    left off. Terminates program with an error message otherwise.
+
+    @param sf Partial-state file
+    @param line Line already read from @a sf, that should contain the entry.
+    @param frame_idx Frame index where the shard should end. */
+static void check_shard_slice_end(shard_file_t *sf, const char *line, sf_count_t frame_idx)
+{
+    /* slice_end: Frame index given in the slice_end entry */
+    sf_count_t slice_end;
+
+    if(sscanf(line, "slice_end %lld", &slice_end) != 1)
     {
-        /* This is silly. There should be an easier way of obtaining an extension from an SF_FORMAT_xxx value.*/
-        int cur_format;
-        int num_formats;
-    
-        sf_command(NULL, SFC_GET_FORMAT_MAJOR_COUNT, &num_formats, sizeof(int));
-        for(cur_format = 0; cur_format <= num_formats; cur_format++)
-        {
-            SF_FORMAT_INFO sf_format_info;
-            sf_format_info.format = cur_format;
-            if(sf_command(NULL, SFC_GET_FORMAT_MAJOR, &sf_format_info, sizeof(SF_FORMAT_INFO)) == 0
-                && (sf_format_info.format & SF_FORMAT_TYPEMASK) == (sf_info.format & SF_FORMAT_TYPEMASK))
-            {
-                extension = sf_format_info.extension;
-            }
-        }
-        if(!extension)
-        {
-            error(EXIT_FAILURE, 0, "Cannot determine extension for libsndfile filetype %#08x",
-                options.in_sfinfo.format);
-        }
+        error(EXIT_FAILURE, 0, "Malformed entry in partial-state file `%s': %s",
+            sf->file_name, line);
     }
-    
-    if(state.cur_track_name && state.cur_track_name[0])
+    else if(slice_end != frame_idx)
     {
-        state.out_file_name = malloc(strlen(state.cur_track_name) + strlen(extension) + 2);
-        sprintf(state.out_file_name, "%s.%s", state.cur_track_name, extension);
+        error(EXIT_FAILURE, 0, "Partial-state file `%s' is inconsistent: slice ends at frame %lld, expected %lld",
+            sf->file_name, slice_end, frame_idx);
     }
-    else
+}
+
+/** Reads the next run descriptor from the shard partial-state files,
+    moving on to the next file once the current one is exhausted.
+
+    @return @c FALSE once the runs of the final shard are exhausted;
+    @c TRUE otherwise (@a state.merge_run_left may still be zero if a
+    file boundary was crossed). */
+static int merge_read_run(void)
+{
+    /* sf: Partial-state file of shard currently being replayed */
+    /* line: Current line of the file */
+    /* sig: Signal decision of run */
+    /* len: Length of run in frames */
+    shard_file_t *sf = &state.merge_files[state.merge_cur];
+    char line[SHARD_LINE_SZ];
+    int sig;
+    sf_count_t len;
+
+    if(!read_shard_line(sf, line))
     {
-        state.out_file_name = malloc(strlen(extension) + 10);
-        sprintf(state.out_file_name, "%08d.%s", state.cur_track_num, extension);
+        error(EXIT_FAILURE, 0, "Premature end of partial-state file `%s'", sf->file_name);
     }
-    sf_info.samplerate = state.samplerate;
-    sf_info.channels = state.numchannels;
-    state.out_file = sf_open(state.out_file_name, SFM_WRITE, &sf_info);
-    if(!state.out_file)
+    if(sscanf(line, "run %d %lld", &sig, &len) == 2 && len > 0)
     {
-        error(EXIT_FAILURE, 0, "Unable to create new track file `%s': %s",
-            state.out_file_name, sf_strerror(NULL));
+        /* The decision is fed to we_have_signal() through a unit
+           threshold, so update_context() runs unmodified. */
+        state.x_sq_ttl[0] = sig ? 1.0 : 0.0;
+        state.merge_run_left = len;
+        return TRUE;
     }
-    leadin_buf_commit();
-    leadin_buf_purge();
-    if(options.verbose)
+    check_shard_slice_end(sf, line, state.cur_frame_pos);
+    if(sf->file != stdin)
     {
-        char cur_track_start_s[TIMECODE_STR_SZ];
-        verbose("Creating `%s' starting @ frame index %lld (%s)",
-            state.out_file_name, state.cur_track_start, 
-            render_frame_idx_as_timecode(cur_track_start_s, state.cur_track_start));
+        fclose(sf->file);
+    }
+    state.merge_cur++;
+    if(state.merge_cur == options.merge_file_cnt)
+    {
+        return FALSE;
+    }
+    else if(state.merge_files[state.merge_cur].slice_start != state.cur_frame_pos)
+    {
+        error(EXIT_FAILURE, 0, "Partial-state file `%s' doesn't follow on from `%s'",
+            state.merge_files[state.merge_cur].file_name, sf->file_name);
     }
+    return TRUE;
 }
 
-/** Closes the current track output file */
-static void close_out_file(void)
+/** Loads the signal decision recorded for the current frame in --merge mode.
+
+    @return @c TRUE if a decision was available; @c FALSE if the runs of
+    all shards have been exhausted. */
+static int merge_load_decision(void)
 {
-    if(state.out_file)
+    while(state.merge_run_left == 0)
     {
-        if(options.verbose)
+        if(!merge_read_run())
         {
-            sf_count_t duration = state.cur_frame_pos - state.cur_track_start;
-            char cur_track_end_s[TIMECODE_STR_SZ];
-            char duration_s[TIMECODE_STR_SZ];
-            verbose("Completed `%s' ending @ frame index %lld (%s), duration %lld frames (%s)",
-                state.out_file_name, state.cur_frame_pos,
-                render_frame_idx_as_timecode(cur_track_end_s, state.cur_frame_pos),
-                duration,
-                render_frame_idx_as_timecode(duration_s, duration));
+            state.frames_remaining = 0;
+            return FALSE;
         }
-        sf_close(state.out_file);
-        state.out_file = NULL;
-        free(state.out_file_name);
-        state.out_file_name = NULL;
     }
+    state.merge_run_left--;
+    return TRUE;
 }
 
-/** Force conclusion of current track (when EOF is encountered, etc) */
-static void force_end_of_track(void)
+/** Passes over the rest of the --exempt window the current frame is
+    in, in --merge mode, while a track is under way. Such frames count
+    as signal whatever was recorded for them, so they can't change the
+    cut context, and the recorded runs are skipped in whole blocks.
+
+    @return @c TRUE if more frames remain after the window; @c FALSE
+    otherwise. */
+static int merge_skip_exempt(void)
 {
-    if(options.cut_point_action == CPA_LOG_POINT)
+    /* n: Frames of the window yet to be passed over */
+    sf_count_t n = state.exempt_edge - state.cur_frame_pos;
+
+    while(n > 0)
     {
-        if(state.cut_context == CCTX_TRACK || state.cut_context == CCTX_TRACK_ENDING)
+        /* step: Frames passed over from the current run */
+        sf_count_t step;
+
+        if(state.merge_run_left == 0)
         {
-            print_track_cut();
+            if(!merge_read_run())
+            {
+                state.frames_remaining = 0;
+                return FALSE;
+            }
+            continue;
         }
+        step = (n < state.merge_run_left) ? n : state.merge_run_left;
+        state.merge_run_left -= step;
+        state.cur_frame_pos += step;
+        n -= step;
     }
-    else if(options.cut_point_action == CPA_EXTRACT_TRACK)
-    {
-        close_out_file();
-    }
-    /* FIXME: Find out why the track name is sometimes re-used if we run out of names. */
-    if(state.cur_track_name)
+    return merge_load_decision();
+}
+
+/** Counterpart to #fetch_next_frame used in --merge mode; advances to
+    the next frame and loads the signal decision the covering shard
+    recorded for it, instead of reading and filtering audio.
+
+    @return @c TRUE if more frames remain; @c FALSE otherwise. */
+static int merge_next_frame(void)
+{
+    state.cur_frame_pos++;
+    if(state.exempt_on && state.cut.context == CCTX_TRACK && state.cur_frame_pos < state.exempt_edge)
     {
-        state.cur_track_name[0] = 0;
+        return merge_skip_exempt();
     }
+    return merge_load_decision();
 }
 
-/** Commit current frame to output file or cutting sheet, depending on cutting mode. */
-static void commit_current_frame(void)
+/** Combines the statistics of every shard's partial-state file in
+    --merge mode, as if a single analysis run had accumulated them. */
+static void merge_analysis(void)
 {
-    if(options.cut_point_action == CPA_LOG_POINT)
+    /* i: Index of shard */
+    /* c: Current channel in iterative loops */
+    int i;
+    int c;
+
+    for(c = 0; c < state.numchannels; c++)
     {
-        /* This block intentionally left blank */
+        state.min_rms[c] = INFINITY;
+        state.max_rms[c] = 0.0;
+        state.pos_peak[c] = -INFINITY;
+        state.neg_peak[c] = INFINITY;
     }
-    else if(options.cut_point_action == CPA_EXTRACT_TRACK)
+    state.cur_frame_pos = state.merge_files[0].slice_start;
+    for(i = 0; i < options.merge_file_cnt; i++)
     {
-        if(sf_writef_double(state.out_file, state.main_buf_cen, 1) < 1)
+        /* sf: Partial-state file of current shard */
+        /* line: Current line of the file */
+        /* key: Keyword at start of current line */
+        /* fields: Per-channel values parsed from current line */
+        /* n: Number of channels parsed from current line */
+        shard_file_t *sf = &state.merge_files[i];
+        char line[SHARD_LINE_SZ];
+        char key[32];
+        double fields[MAX_CHANNELS];
+        sf_count_t n;
+
+        if(sf->slice_start != state.cur_frame_pos)
         {
-            error(EXIT_FAILURE, 0, "Unable to write to output file `%s': %s",
-                state.out_file_name, sf_strerror(state.out_file));
+            error(EXIT_FAILURE, 0, "Partial-state file `%s' doesn't follow on from the previous shard",
+                sf->file_name);
         }
-    }
-}
+        if(!read_shard_line(sf, line) || sscanf(line, "slice_end %lld", &state.cur_frame_pos) != 1)
+        {
+            error(EXIT_FAILURE, 0, "Missing slice end in partial-state file `%s'", sf->file_name);
+        }
+        while(read_shard_line(sf, line) && sscanf(line, "%31s", key) == 1 && strcmp(key, "end") != 0)
+        {
+            /* ofs: Offset into line of next field to parse */
+            /* len: Number of characters parsed */
+            int ofs = strlen(key);
+            int len;
 
-/** In cutting mode, makes a decision on the cutting context state,
-    based on the RMS level of the current frame. */
-static void update_context(void)
-{
-    switch(state.cut_context)
-    {
-        case CCTX_SILENCE:
-            if(we_have_signal())
+            if(strcmp(key, "frames_read_ttl") == 0 && sscanf(line + ofs, "%lld", &n) == 1)
             {
-                state.cut_context = CCTX_TRACK_STARTING;
-                state.time_to_live = state.min_signal_len - 1;
-                state.cur_track_start = state.cur_frame_pos;
-                leadin_buf_add();
+                state.frames_read_ttl += n;
+                continue;
             }
-            break;
-        case CCTX_TRACK_STARTING:
-            if(!we_have_signal())
+            else if(strcmp(key, "frames_proc_ttl") == 0 && sscanf(line + ofs, "%lld", &n) == 1)
+            {
+                state.frames_proc_ttl += n;
+                continue;
+            }
+            else if(strcmp(key, "dc_acc") == 0)
             {
-                leadin_buf_purge();
-                state.cut_context = CCTX_SILENCE;
-                if(options.verbose)
+                for(c = 0; c < state.numchannels; c++)
                 {
-                    char cur_track_start_time_s[TIMECODE_STR_SZ];
-                    char cur_pos_time_s[TIMECODE_STR_SZ];
-                    verbose("False positive of %lld frames (%dms) between frame range %lld-%lld (%s-%s)",
-                        state.cur_frame_pos - state.cur_track_start,
-                        (int)(((state.cur_frame_pos - state.cur_track_start) * 1000) / state.samplerate),
-                        state.cur_track_start, state.cur_frame_pos,
-                        render_frame_idx_as_timecode(cur_track_start_time_s, state.cur_track_start),
-                        render_frame_idx_as_timecode(cur_pos_time_s, state.cur_frame_pos));
+                    if(sscanf(line + ofs, "%lld%n", &n, &len) != 1)
+                    {
+                        error(EXIT_FAILURE, 0, "Malformed `%s' entry in partial-state file `%s'",
+                            key, sf->file_name);
+                    }
+                    state.dc_acc[c] += n;
+                    ofs += len;
                 }
+                continue;
             }
-            else if(state.time_to_live > 0)
+            for(c = 0; c < state.numchannels; c++)
             {
-                leadin_buf_add();
-                state.time_to_live--;
+                if(sscanf(line + ofs, "%lf%n", &fields[c], &len) != 1)
+                {
+                    error(EXIT_FAILURE, 0, "Malformed `%s' entry in partial-state file `%s'",
+                        key, sf->file_name);
+                }
+                ofs += len;
             }
-            /* We've found the start of a track */
-            else
+            for(c = 0; c < state.numchannels; c++)
             {
-                state.cut_context = CCTX_TRACK;
-                if(options.cut_point_action == CPA_LOG_POINT)
+                if(strcmp(key, "rms_ttl") == 0)
                 {
-                    fetch_next_track_name();
+                    state.rms_ttl[c] += fields[c];
                 }
-                else if(options.cut_point_action == CPA_EXTRACT_TRACK)
+                else if(strcmp(key, "min_rms") == 0)
                 {
-                    create_new_out_file();
+                    state.min_rms[c] = fmin(state.min_rms[c], fields[c]);
+                }
+                else if(strcmp(key, "max_rms") == 0)
+                {
+                    state.max_rms[c] = fmax(state.max_rms[c], fields[c]);
+                }
+                else if(strcmp(key, "pos_peak") == 0)
+                {
+                    state.pos_peak[c] = fmax(state.pos_peak[c], fields[c]);
+                }
+                else if(strcmp(key, "neg_peak") == 0)
+                {
+                    state.neg_peak[c] = fmin(state.neg_peak[c], fields[c]);
                 }
-                commit_current_frame();
-            }
-            break;
-        case CCTX_TRACK_ENDING:
-            commit_current_frame();
-            if(we_have_signal())
-            {
-                state.cut_context = CCTX_TRACK;
-            }
-            else if(state.time_to_live > 0)
-            {
-                state.time_to_live--;
-            }
-            /* We've found the end of a track */
-            else
-            {
-                force_end_of_track();
-                state.cut_context = CCTX_SILENCE;
-                state.cur_track_num++;
-            }
-            break;
-        case CCTX_TRACK:
-            commit_current_frame();
-            if(!we_have_signal() && state.cur_frame_pos >= state.cur_track_start + state.min_track_len)
-            {
-                state.cut_context = CCTX_TRACK_ENDING;
-                state.time_to_live = state.min_silence_len;
             }
-            break;
+        }
+        if(sf->file != stdin)
+        {
+            fclose(sf->file);
+        }
     }
 }
 
-/** This function must be called before entering #cutter_loop or #analyser_loop. */
-static void init_state(void)
+/** Prepares for --merge mode: reads the headers of all the partial-state
+    files, checks that they form a complete set of shards from the same
+    run, and sets up the program state from them. */
+static void init_merge_state(void)
 {
-    /* c: Current channel in iterative loops */
-    /* dt: small-delta-t, interval between frames (in seconds). */
-    int c;
-    double dt;
-    
-    memset(&state, 0, sizeof(state));
-    state.cur_track_num = 1;
+    /* i: Index of partial-state file */
+    /* first: Partial-state file of first shard */
+    int i;
+    shard_file_t *first;
 
-    if(options.verbose)
-    {
-        char sf_ver_str[128];
-        sf_command(NULL, SFC_GET_LIB_VERSION, sf_ver_str, sizeof(sf_ver_str));
-        verbose("libsndfile version: %s", sf_ver_str);
-    }
-    
-    open_input_file();
-    state.rms_window_len = state.samplerate * RMS_WINDOW_PERIOD / 1000;
-    verbose("RMS window is %d frames", state.rms_window_len);
-    state.sq_buf = calloc(state.rms_window_len, state.frame_sz);
-    state.sq_buf_edge = state.sq_buf + state.rms_window_len * state.numchannels;
-    state.sq_buf_cen = state.sq_buf + (state.rms_window_len / 2) * state.numchannels;
-    state.main_buf = calloc(state.rms_window_len, state.frame_sz);
-    state.main_buf_edge = state.main_buf + state.rms_window_len * state.numchannels;
-    state.main_buf_cen = state.main_buf + (state.rms_window_len / 2) * state.numchannels;
-    state.ra_frame_cnt = (state.main_buf_edge - state.main_buf_cen) / state.numchannels; 
-    verbose("Read-ahead period is %d frames", state.ra_frame_cnt);
-    dt = 1.0 / (double)state.samplerate;
-    state.alpha = HIGH_PASS_TAU / (HIGH_PASS_TAU + dt);
-    verbose("HPF alpha = %lf", state.alpha);
-    
-    /* Slurp initial half-buffer of frames and prepare RMS buffer and
-       filter state. The assertion can be made at this point that no
-       wrapping in the queues occur, so we can treat the queues as
-       flat arrays. */
-    if(sf_readf_double(state.in_file, state.main_buf_cen, state.ra_frame_cnt) < 0)
+    memset(&state, 0, sizeof(state));
+    state.cut.track_num = 1;
+    state.merge_files = counted_calloc(options.merge_file_cnt, sizeof(shard_file_t));
+    if(!state.merge_files)
     {
-        error(EXIT_FAILURE, 0, "Cannot read leading part of `%s': %s",
-            options.in_file_name, sf_strerror(state.in_file));
+        error(EXIT_FAILURE, errno, "Unable to allocate memory for partial-state files");
     }
-    state.frames_read_ttl = state.ra_frame_cnt;
-    /* Temporarily borrow the head pointer as a loop counter, since
-       filter_new_frame() expects it to point to the newest frame. */
-    state.main_buf_head = state.main_buf_cen;
-    state.sq_buf_head = state.sq_buf_cen;  
-    while(state.main_buf_head < state.main_buf_edge)
+    for(i = 0; i < options.merge_file_cnt; i++)
     {
-        filter_new_frame();
-        state.main_buf_head += state.numchannels;
-        state.sq_buf_head += state.numchannels;
+        state.merge_files[i].file_name = options.merge_file_names[i];
+        read_shard_header(&state.merge_files[i]);
+        verbose("Opened partial-state file `%s' (shard %d/%d)",
+            state.merge_files[i].file_name, state.merge_files[i].shard_idx,
+            state.merge_files[i].shard_cnt);
     }
-    state.main_buf_head = state.main_buf_edge - state.numchannels;
-    state.main_buf_tail = state.main_buf;
-    state.sq_buf_head = state.sq_buf_edge - state.numchannels;
-    state.sq_buf_tail = state.sq_buf;
-    /* main_buf[] has been DC corrected (and HP-filtered if enabled) */
-    /* sq_buf[] is now populated */
-    /* x_sq_ttl[] is now available */
-    
-    if(options.task == TCT_CUTTING)
+    qsort(state.merge_files, options.merge_file_cnt, sizeof(shard_file_t), compare_shard_files);
+    first = &state.merge_files[0];
+    for(i = 0; i < options.merge_file_cnt; i++)
     {
-        double x_nf = exp2(options.noise_floor_dbfs / (20.0 * log10(2)));
-        verbose("x_nf = %lf", x_nf);
-        state.n_x_nf_sq = x_nf * x_nf * (double)state.rms_window_len;
-        verbose("n(x_nf)^2 = %lf", state.n_x_nf_sq);
-        state.min_silence_len = state.samplerate * options.min_silence_period / 1000;
-        state.min_signal_len = state.samplerate * options.min_signal_period / 1000;
-        state.min_track_len = state.samplerate * options.min_track_length;
-        verbose("Minimum silence period is %d frames", state.min_silence_len);
-        verbose("Minimum signal period is %d frames", state.min_signal_len);
-        verbose("Minimum track length is %d frames", state.min_track_len);
-        if(options.cut_point_action == CPA_EXTRACT_TRACK)
-        {
-            state.leadin_buf_len = state.min_signal_len;
-            state.leadin_buf = malloc(sizeof(double) * state.numchannels * state.leadin_buf_len);
-            state.leadin_buf_edge = state.leadin_buf + state.numchannels * state.leadin_buf_len;
-            state.leadin_buf_end = state.leadin_buf;
-            verbose("Lead-in buffer is %d frames", state.leadin_buf_len);
-        }
-        if(options.track_names_file_name)
+        /* sf: Partial-state file being checked against the first */
+        shard_file_t *sf = &state.merge_files[i];
+
+        if(sf->shard_cnt != options.merge_file_cnt || sf->shard_idx != i + 1)
         {
-            open_track_names_file();
+            error(EXIT_FAILURE, 0, "Expected shard %d/%d, but `%s' is shard %d/%d",
+                i + 1, options.merge_file_cnt, sf->file_name, sf->shard_idx, sf->shard_cnt);
         }
-        
-        if(options.cut_point_action == CPA_LOG_POINT)
+        else if(sf->task != first->task
+            || sf->samplerate != first->samplerate
+            || sf->numchannels != first->numchannels
+            || sf->start_frame_idx != first->start_frame_idx
+            || sf->end_frame_idx != first->end_frame_idx
+            || sf->min_signal_len != first->min_signal_len
+            || sf->min_silence_len != first->min_silence_len
+            || sf->min_track_len != first->min_track_len)
         {
-            create_cuts_file();
+            error(EXIT_FAILURE, 0, "Partial-state files `%s' and `%s' come from runs with different parameters",
+                first->file_name, sf->file_name);
         }
-        else if(options.cut_point_action == CPA_EXTRACT_TRACK)
+    }
+
+    state.samplerate = first->samplerate;
+    state.numchannels = first->numchannels;
+    state.min_signal_len = first->min_signal_len;
+    state.min_silence_len = first->min_silence_len;
+    state.min_track_len = first->min_track_len;
+    state.frames_remaining = SF_COUNT_MAX;
+    state.cur_frame_pos = first->slice_start;
+    if(first->task == TCT_CUTTING)
+    {
+        /* we_have_signal() compares x_sq_ttl[] against this unit threshold */
+        state.n_x_nf_sq = 0.5;
+        init_exemption();
+        if(options.track_names_file_name)
         {
-            /* Changing the working directory means that we no longer
-               have to worry about path separators in track file names.
-               This is only possible once we've finished setting up all
-               other input/output files. */
-            if(chdir(options.track_directory) < 0)
-            {
-                error(EXIT_FAILURE, errno, "Unable to change to track directory `%s'",
-                    options.track_directory);
-            }
-            verbose("Changed working directory to `%s'", options.track_directory);
+            open_track_names_file();
         }
-        
-        state.cut_context = CCTX_SILENCE;
+        create_cuts_file();
+        state.cut.context = CCTX_SILENCE;
     }
-    else if(options.task == TCT_ANALYSIS)
+    else if(options.exempt_file_name)
     {
-        for(c = 0; c < state.numchannels; c++)
+        error(EXIT_FAILURE, 0, "Option `--exempt' only works in cutting mode, but the shards were analysed");
+    }
+    init_progress();
+}
+
+/** Main loop in --merge mode; replays the recorded decisions through
+    the track cutting state machine, or combines the recorded statistics,
+    depending on the task the shards were run in. */
+static void merge_loop(void)
+{
+    if(state.merge_files[0].task == TCT_CUTTING)
+    {
+        if(merge_load_decision())
         {
-            state.min_rms[c] = INFINITY;
-            state.pos_peak[c] = -INFINITY;
-            state.neg_peak[c] = INFINITY;
+            cutter_loop(merge_next_frame);
         }
     }
+    else
+    {
+        merge_analysis();
+        print_analysis();
+    }
 }
 
-/** Main cutter loop. */
-static void cutter_loop(void)
+/** Works out the name of the wisdom file: the one given with --wisdom,
+    otherwise #WISDOM_FILE_NAME in the home directory.
+
+    @return Newly allocated file name, or @c NULL if there's no home
+    directory to look in. */
+static char *wisdom_file_path(void)
 {
-    do
+    /* home: Home directory */
+    /* path: Return result */
+    const char *home = getenv("HOME");
+    char *path;
+
+    if(options.wisdom_file_name)
     {
-        update_context();
+        path = counted_strdup(options.wisdom_file_name);
     }
-    while(fetch_next_frame() && state.cur_track_num <= options.track_num_end);
-
-    if(state.frames_remaining == 0)
+    else if(home && *home)
     {
-        if(options.verbose)
+        path = counted_malloc(strlen(home) + sizeof(WISDOM_FILE_NAME) + 1);
+        if(path)
         {
-            char cur_time_s[TIMECODE_STR_SZ];
-            verbose("End of input reached at frame %lld (%s). Exiting.",
-                state.cur_frame_pos, 
-                render_frame_idx_as_timecode(cur_time_s, state.cur_frame_pos));
+            sprintf(path, "%s/%s", home, WISDOM_FILE_NAME);
         }
-        force_end_of_track();
     }
-    else if(state.cur_track_num > options.track_num_end)
+    else
     {
-        verbose("No more tracks remaining. Exiting.");
+        return NULL;
+    }
+    if(!path)
+    {
+        error(EXIT_FAILURE, errno, "Unable to allocate memory for wisdom file name");
     }
+    return path;
 }
 
-/** Prints analysis page header, customising it based on number of channels. */
-static void print_analysis_header(void)
+/** Loads the block lengths chosen by --tune from the wisdom file, if
+    there is one. Wisdom is only advice: without it the defaults stand,
+    and if it can't be read or makes no sense, a warning is given and
+    the defaults stand. The file holds lines of the form "NAME VALUE";
+    blank lines, comments (starting with `#') and names that aren't
+    recognised are skipped, so that wisdom written by a later version
+    can still be read. */
+static void load_wisdom(void)
 {
-    printf("%-20s", "statistic");
-    if(state.numchannels == 1)
+    /* path: Name of the wisdom file */
+    /* line: Line buffer */
+    /* name, value: Fields of the current line */
+    /* version: Wisdom file version; zero if not yet seen */
+    /* read_len, write_len: Block lengths given in the file; zero if not given */
+    char *path = wisdom_file_path();
+    FILE *file;
+    char line[WISDOM_LINE_SZ];
+    char name[WISDOM_LINE_SZ];
+    long value;
+    long version = 0;
+    long read_len = 0;
+    long write_len = 0;
+
+    if(!path)
     {
-        printf("mono_channel\n");
+        return;
     }
-    else if(state.numchannels == 2)
+    file = fopen(path, "r");
+    if(!file)
     {
-        printf("%20s%20s\n", "left_channel", "right_channel");
+        if(errno != ENOENT || options.wisdom_file_name)
+        {
+            error(0, errno, "warning: unable to read wisdom file `%s'; using defaults", path);
+        }
+        free(path);
+        return;
     }
-    else
+    while(fgets(line, sizeof(line), file))
     {
-        int c;
-        for(c = 0; c < state.numchannels; c++)
+        if(line[0] == '#' || line[strspn(line, " \t\r\n")] == 0)
         {
-            printf("channel_%-6d", c);
+            continue;
+        }
+        else if(sscanf(line, "%s %ld", name, &value) != 2)
+        {
+            version = -1;
+            break;
+        }
+        else if(strcmp(name, "version") == 0)
+        {
+            version = value;
+        }
+        else if(strcmp(name, "read_block_frames") == 0)
+        {
+            read_len = value;
+        }
+        else if(strcmp(name, "write_block_frames") == 0)
+        {
+            write_len = value;
         }
-        printf("\n");
     }
+    if(ferror(file))
+    {
+        error(0, errno, "warning: unable to read wisdom file `%s'; using defaults", path);
+    }
+    else if(version != WISDOM_FILE_VERSION || read_len < 0 || read_len > MAX_BLOCK_LEN
+        || write_len < 0 || write_len > MAX_BLOCK_LEN)
+    {
+        error(0, 0, "warning: wisdom file `%s' isn't valid; using defaults (run `%s --tune' to replace it)",
+            path, program_invocation_short_name);
+    }
+    else
+    {
+        options.read_block_len = read_len ? read_len : options.read_block_len;
+        options.write_block_len = write_len ? write_len : options.write_block_len;
+        verbose("Loaded wisdom from `%s'", path);
+    }
+    fclose(file);
+    free(path);
 }
 
-static void print_analysis_row(const char *header, const char *format, double *fields)
-{
-    int c;
+/** Times writing the synthetic recording for --tune to @a path, @a
+    block_len frames at a time. The frames are gathered into blocks one
+    at a time, as #write_out_frames does.
 
-    printf("%20s", header);
-    for(c = 0; c < state.numchannels; c++)
+    @param src Source frames, as many as the longest block length in
+    #tune_block_lens, repeated as needed
+
+    @return Time taken, in nanoseconds. */
+static int64_t tune_write(const char *path, const double *src, double *buf, int block_len)
+{
+    /* frames: Number of frames to write */
+    /* buf_len: Number of frames gathered into @a buf */
+    /* t0: Clock reading at start */
+    sf_count_t frames = (sf_count_t)TUNE_PERIOD * TUNE_SAMPLERATE;
+    sf_count_t i;
+    int buf_len = 0;
+    int64_t t0 = prof_clock();
+    SF_INFO sfinfo;
+    SNDFILE *file;
+
+    memset(&sfinfo, 0, sizeof(sfinfo));
+    sfinfo.samplerate = TUNE_SAMPLERATE;
+    sfinfo.channels = TUNE_CHANNELS;
+    sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+    file = sf_open(path, SFM_WRITE, &sfinfo);
+    if(!file)
     {
-        char s[21];
-        snprintf(s, 21, format, fields[c]);
-        printf("%20s", s);
+        error(EXIT_FAILURE, 0, "Unable to create `%s': %s", path, sf_strerror(NULL));
     }
-    printf("\n");
+    for(i = 0; i < frames; i++)
+    {
+        memcpy(buf + buf_len * TUNE_CHANNELS,
+            src + (i % tune_block_lens[TUNE_BLOCK_LEN_CNT - 1]) * TUNE_CHANNELS,
+            sizeof(double) * TUNE_CHANNELS);
+        if(++buf_len == block_len || i + 1 == frames)
+        {
+            if(sf_writef_double(file, buf, buf_len) < buf_len)
+            {
+                error(EXIT_FAILURE, 0, "Unable to write to `%s': %s", path, sf_strerror(file));
+            }
+            buf_len = 0;
+        }
+    }
+    sf_close(file);
+    return prof_clock() - t0;
 }
 
-/** Converts a sample level into a decibel full-scale amount (dbFS).
+/** Times reading the synthetic recording for --tune back from @a path,
+    @a block_len frames at a time. The frames are then taken from the
+    block one at a time, as #fetch_next_frame does.
 
-    @param x Sample level to compute; should be in range [-1.0, +1.0].
-    @return dbFS power level (will be negative); negative infinity will
-    be returned if @a x is zero. */
-static double level_to_dbfs(double x)
+    @return Time taken, in nanoseconds. */
+static int64_t tune_read(const char *path, double *buf, int block_len)
 {
-    return (x != 0.0)
-        ? log2(fabs(x)) * (20.0 * log10(2))
-        : -INFINITY;
+    /* frame: Destination for each frame */
+    /* rdcnt: Number of frames read into @a buf */
+    /* t0: Clock reading at start */
+    double frame[TUNE_CHANNELS];
+    sf_count_t rdcnt;
+    sf_count_t i;
+    int64_t t0 = prof_clock();
+    SF_INFO sfinfo;
+    SNDFILE *file;
+
+    memset(&sfinfo, 0, sizeof(sfinfo));
+    file = sf_open(path, SFM_READ, &sfinfo);
+    if(!file)
+    {
+        error(EXIT_FAILURE, 0, "Unable to open `%s': %s", path, sf_strerror(NULL));
+    }
+    while((rdcnt = sf_readf_double(file, buf, block_len)) > 0)
+    {
+        for(i = 0; i < rdcnt; i++)
+        {
+            memcpy(frame, buf + i * TUNE_CHANNELS, sizeof(frame));
+        }
+    }
+    if(rdcnt < 0)
+    {
+        error(EXIT_FAILURE, 0, "Error while reading `%s': %s", path, sf_strerror(file));
+    }
+    sf_close(file);
+    return prof_clock() - t0;
 }
 
-/** Prints analysis page to standard output */
-static void print_analysis(void)
+/** Returns the shortest block length from #tune_block_lens that took
+    no more than #TUNE_TOLERANCE longer than the fastest, given the time
+    each took. */
+static int tune_choose(const int64_t *ns)
 {
-    int c;
-    double dc_offset[MAX_CHANNELS];
-    double dc_offset_dbfs[MAX_CHANNELS];
-    double avg_rms[MAX_CHANNELS];
-    double min_rms_dbfs[MAX_CHANNELS];
-    double max_rms_dbfs[MAX_CHANNELS];
-    double avg_rms_dbfs[MAX_CHANNELS];
-    double peak_dbfs[MAX_CHANNELS];
+    /* best: Index of the fastest block length */
+    int best = 0;
+    int i;
 
-    for(c = 0; c < state.numchannels; c++)
+    for(i = 1; i < TUNE_BLOCK_LEN_CNT; i++)
+    {
+        best = (ns[i] < ns[best]) ? i : best;
+    }
+    for(i = 0; i < best && ns[i] > ns[best] * (1.0 + TUNE_TOLERANCE); i++)
     {
-        dc_offset[c] = state.hpf_rej_ttl[c] / (double)state.frames_read_ttl;
-        dc_offset_dbfs[c] = level_to_dbfs(dc_offset[c]);
-        avg_rms[c] = state.rms_ttl[c] / (double)state.frames_proc_ttl;
-        min_rms_dbfs[c] = level_to_dbfs(state.min_rms[c]);
-        max_rms_dbfs[c] = level_to_dbfs(state.max_rms[c]);
-        avg_rms_dbfs[c] = level_to_dbfs(avg_rms[c]);
-        peak_dbfs[c] = fmax(level_to_dbfs(state.pos_peak[c]), level_to_dbfs(state.neg_peak[c]));
     }
+    return tune_block_lens[i];
+}
 
-    print_analysis_header();
-    print_analysis_row("positive_peak", "  %+1.16f", state.pos_peak);
-    print_analysis_row("negative_peak", "  %+1.16f", state.neg_peak);
-    print_analysis_row("peak_dbfs", "  %+3.14f", peak_dbfs);
-    print_analysis_row("min_rms", "  %+1.16f", state.min_rms);
-    print_analysis_row("max_rms", "  %+1.16f", state.max_rms);
-    print_analysis_row("avg_rms", "  %+1.16f", avg_rms);
-    print_analysis_row("min_rms_dbfs", "  %+3.14f", min_rms_dbfs);
-    print_analysis_row("max_rms_dbfs", "  %+3.14f", max_rms_dbfs);
-    print_analysis_row("avg_rms_dbfs", "  %+3.14f", avg_rms_dbfs);
-    print_analysis_row("dc_offset", "  %+1.16f", dc_offset);
-    print_analysis_row("dc_offset_dbfs", "  %+3.14f", dc_offset_dbfs);
+/** Performs --tune: times reading and writing a synthetic recording
+    (#TUNE_PERIOD seconds of 16-bit stereo WAV, in a temporary file) in
+    blocks of each length in #tune_block_lens, and writes the best to
+    the wisdom file. libsndfile makes a system call for every read or
+    write, so the best block lengths depend on the system's costs for
+    those as much as on the CPU and its caches. */
+static void tune(void)
+{
+    /* path: Name of the wisdom file */
+    /* tmp_name: Name of the temporary recording */
+    /* src: Noise to fill the recording with */
+    /* buf: Block buffer, large enough for the longest block */
+    /* read_ns, write_ns: Shortest time taken with each block length */
+    /* seed: State of the noise generator */
+    char *path = wisdom_file_path();
+    char *tmp_name;
+    int max_len = tune_block_lens[TUNE_BLOCK_LEN_CNT - 1];
+    double *src = counted_malloc(sizeof(double) * TUNE_CHANNELS * max_len);
+    double *buf = counted_malloc(sizeof(double) * TUNE_CHANNELS * max_len);
+    int64_t read_ns[TUNE_BLOCK_LEN_CNT];
+    int64_t write_ns[TUNE_BLOCK_LEN_CNT];
+    int64_t ns;
+    uint32_t seed = 1;
+    int read_len;
+    int write_len;
+    int i;
+    int r;
+    FILE *file;
+
+    if(!path)
     {
-        char s[MAX_CHANNELS * 16];
-        char *s_end;
-        int c;
-        
-        s_end = s + sprintf(s, "%+f", -dc_offset[0]);
-        for(c = 1; c < state.numchannels; c++)
+        error(EXIT_FAILURE, 0, "Nowhere to write wisdom: HOME isn't set, and `--wisdom' wasn't given");
+    }
+    if(!src || !buf)
+    {
+        error(EXIT_FAILURE, errno, "Unable to allocate memory for tuning");
+    }
+    close(create_temp_file("trackcutter-tune-", &tmp_name));
+    for(i = 0; i < TUNE_CHANNELS * max_len; i++)
+    {
+        /* Uniform noise at about -15dBFS RMS */
+        seed = seed * 1664525 + 1013904223;
+        src[i] = ((double)seed / 4294967296.0 - 0.5) * 0.6;
+    }
+
+    printf("Timing %d seconds of %d-channel audio read and written in blocks of each length:\n",
+        TUNE_PERIOD, TUNE_CHANNELS);
+    for(i = 0; i < TUNE_BLOCK_LEN_CNT; i++)
+    {
+        read_ns[i] = INT64_MAX;
+        write_ns[i] = INT64_MAX;
+    }
+    for(r = 0; r < TUNE_REPEAT; r++)
+    {
+        /* Take turns, so that anything else going on affects each length alike */
+        for(i = 0; i < TUNE_BLOCK_LEN_CNT; i++)
         {
-            s_end += sprintf(s_end, ",%+f", -dc_offset[c]);
+            ns = tune_write(tmp_name, src, buf, tune_block_lens[i]);
+            write_ns[i] = (ns < write_ns[i]) ? ns : write_ns[i];
+            ns = tune_read(tmp_name, buf, tune_block_lens[i]);
+            read_ns[i] = (ns < read_ns[i]) ? ns : read_ns[i];
         }
-        printf("%20s  --dc-offset=%s\n", "fix_dc_offset_arg", s);
     }
-}
+    unlink(tmp_name);
 
-/** Main analyser loop */
-static void analyser_loop(void)
-{
-    do
+    read_len = tune_choose(read_ns);
+    write_len = tune_choose(write_ns);
+    printf("%-14s%16s%16s\n", "block_frames", "read_frames/s", "write_frames/s");
+    for(i = 0; i < TUNE_BLOCK_LEN_CNT; i++)
     {
-        analyse_new_frame();
+        printf("%-14d%16.0f%16.0f\n", tune_block_lens[i],
+            (double)TUNE_PERIOD * TUNE_SAMPLERATE * 1e9 / (double)read_ns[i],
+            (double)TUNE_PERIOD * TUNE_SAMPLERATE * 1e9 / (double)write_ns[i]);
     }
-    while(fetch_next_frame());
-    
-    print_analysis();
+    printf("Chose blocks of %d frames for reading and %d frames for writing\n", read_len, write_len);
+
+    file = fopen(path, "w");
+    if(!file)
+    {
+        error(EXIT_FAILURE, errno, "Unable to create wisdom file `%s'", path);
+    }
+    fprintf(file, "# Block lengths (in frames) chosen by `%s --tune' for this machine\n",
+        program_invocation_short_name);
+    fprintf(file, "version %d\n", WISDOM_FILE_VERSION);
+    fprintf(file, "read_block_frames %d\n", read_len);
+    fprintf(file, "write_block_frames %d\n", write_len);
+    if(fclose(file) != 0)
+    {
+        error(EXIT_FAILURE, errno, "Unable to write wisdom file `%s'", path);
+    }
+    printf("Wrote wisdom to `%s'\n", path);
+    free(tmp_name);
+    free(buf);
+    free(src);
+    free(path);
 }
 
 /** This is the main function.
@@ -2241,15 +8659,62 @@ int main(int argc, char **argv)
         dump_options();
     }
 
+    if(options.tune)
+    {
+        tune();
+        return EXIT_SUCCESS;
+    }
+    load_wisdom();
+    install_progress_handler();
+
+    if(options.task == TCT_MERGE)
+    {
+        init_merge_state();
+        merge_loop();
+        return EXIT_SUCCESS;
+    }
+
     init_state();
-    if(options.task == TCT_CUTTING)
+    if(options.shard_cnt)
     {
-        cutter_loop();
+        shard_loop();
+    }
+    else if(options.batch)
+    {
+        batch_loop();
+    }
+    else if(options.task == TCT_CUTTING)
+    {
+        cutter_loop(fetch_next_frame);
+        if(options.tar_output)
+        {
+            tar_write_trailer();
+        }
     }
     else if(options.task == TCT_ANALYSIS)
     {
         analyser_loop();
     }
+    if(options.profile_report)
+    {
+        print_profile();
+    }
+    if(options.metrics_file_name)
+    {
+        write_metrics_file();
+    }
+    if(options.energy_map_file_name)
+    {
+        finish_energy_map();
+    }
+    if(options.decision_trace_file_name)
+    {
+        finish_decision_trace();
+    }
+    if(options.trace_file_name)
+    {
+        write_trace_file();
+    }
     
     /* Return success exit status */
     return EXIT_SUCCESS;
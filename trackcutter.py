@@ -0,0 +1,355 @@
+# trackcutter.py: Python binding to trackcutter's detection engine
+# Copyright (C) 2026 agent <agent@local>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or (at
+# your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+"""Runs trackcutter's track detection and analysis over NumPy arrays.
+
+Loads libtrackcutter.so (built with `make python') through cffi, and
+hands the array to the engine in place, so parameter studies can be run
+in-process at native speed:
+
+    import soundfile, trackcutter
+    audio, rate = soundfile.read("side-a.flac")
+    res = trackcutter.detect(audio, rate, noise_floor=-54, hop=441)
+    res.cuts        # (tracks, 2) int64 array of start and end frames
+    res.envelope    # (hops, channels) RMS levels, one row every 441 frames
+    res.stats       # dict of per-channel --analyse statistics
+
+The library is looked for alongside this file, then wherever the
+TRACKCUTTER_LIB environment variable points, then on the system library
+path. The engine keeps its state in globals, so calls are serialised.
+
+EnergyMap reads the per-hop levels written by `trackcutter --energy-map',
+and answers questions about the level over any span of the recording
+without scanning it:
+
+    emap = trackcutter.EnergyMap.load("side-a.energy")
+    emap.max_level(start, end)          # loudest point in [start, end)
+    emap.find_gap(start, 88200, -54)    # first 2s below -54dBFS after start
+"""
+
+import os
+import threading
+
+import cffi
+import numpy as np
+
+__all__ = ["detect", "Result", "EnergyMap", "MAX_CHANNELS"]
+
+# Declarations from libtrackcutter.h, which must be kept in step
+_CDEF = """
+#define TC_MAX_CHANNELS 8
+
+typedef struct {
+    double noise_floor_dbfs;
+    int min_silence_period;
+    int min_signal_period;
+    int min_track_length;
+    int high_pass_filter;
+    double dc_offset[TC_MAX_CHANNELS];
+    int hop_len;
+    double adaptive_floor_margin;
+    int floor_window;
+} tc_params_t;
+
+typedef struct {
+    int64_t start;
+    int64_t end;
+} tc_cut_t;
+
+typedef struct {
+    double positive_peak[TC_MAX_CHANNELS];
+    double negative_peak[TC_MAX_CHANNELS];
+    double min_rms[TC_MAX_CHANNELS];
+    double max_rms[TC_MAX_CHANNELS];
+    double avg_rms[TC_MAX_CHANNELS];
+    double dc_offset[TC_MAX_CHANNELS];
+} tc_stats_t;
+
+typedef struct {
+    tc_cut_t *cuts;
+    int cut_cnt;
+    tc_stats_t stats;
+} tc_result_t;
+
+void tc_default_params(tc_params_t *params);
+int64_t tc_envelope_len(int64_t frame_cnt, int hop_len);
+int tc_run(const tc_params_t *params, const double *frames, int64_t frame_cnt,
+    int channels, int samplerate, double *envelope, tc_result_t *result);
+void tc_free_result(tc_result_t *result);
+const char *tc_last_error(void);
+"""
+
+_ffi = cffi.FFI()
+_ffi.cdef(_CDEF)
+
+_STATS = ("positive_peak", "negative_peak", "min_rms", "max_rms", "avg_rms", "dc_offset")
+
+_lock = threading.Lock()
+_lib = None
+
+MAX_CHANNELS = 8
+
+
+def _load():
+    """Loads the shared library on first use."""
+    global _lib
+    if _lib is None:
+        here = os.path.join(os.path.dirname(os.path.abspath(__file__)), "libtrackcutter.so")
+        for name in (here, os.environ.get("TRACKCUTTER_LIB"), "libtrackcutter.so"):
+            if name:
+                try:
+                    _lib = _ffi.dlopen(name)
+                    break
+                except OSError:
+                    pass
+        else:
+            raise OSError("libtrackcutter.so not found; build it with `make python'"
+                          " or set TRACKCUTTER_LIB")
+    return _lib
+
+
+class Result:
+    """Outcome of detect().
+
+    cuts: (tracks, 2) int64 array of the first frame of each track and
+        the frame just past its end, as --cuts-file gives them
+    envelope: (hops, channels) array of RMS levels, one row every `hop'
+        frames from the first; empty if no hop was given
+    hop: Frames between rows of `envelope'
+    stats: dict of per-channel arrays of --analyse statistics, as
+        linear levels: positive_peak, negative_peak, min_rms, max_rms,
+        avg_rms and dc_offset
+    """
+
+    def __init__(self, cuts, envelope, hop, stats):
+        self.cuts = cuts
+        self.envelope = envelope
+        self.hop = hop
+        self.stats = stats
+
+    def __repr__(self):
+        return "Result(%d tracks, %d envelope points)" % (len(self.cuts), len(self.envelope))
+
+
+def detect(frames, samplerate, noise_floor=None, min_silence=None, min_signal=None,
+           min_track_length=None, high_pass=False, dc_offset=None, hop=0,
+           adaptive_floor=None, floor_window=None):
+    """Searches a recording for tracks delimited by silence, and gathers
+    its analysis statistics, in one pass.
+
+    frames is a (frames,) or (frames, channels) array of samples in the
+    range -1 to 1. A C-contiguous float64 array is read in place; any
+    other is converted first. The remaining arguments are as the
+    like-named trackcutter options (noise_floor in dBFS, min_silence and
+    min_signal in ms, min_track_length in seconds, dc_offset a value per
+    channel, adaptive_floor in dB and floor_window in seconds), taking
+    the program's defaults if not given. hop asks for an RMS envelope
+    point every that many frames.
+
+    Returns a Result. Raises ValueError if the engine rejects the input.
+    """
+    lib = _load()
+    x = np.ascontiguousarray(frames, dtype=np.float64)
+    if x.ndim == 1:
+        x = x.reshape(-1, 1)
+    if x.ndim != 2:
+        raise ValueError("frames must be a 1- or 2-dimensional array")
+    frame_cnt, channels = x.shape
+
+    params = _ffi.new("tc_params_t *")
+    res = _ffi.new("tc_result_t *")
+    with _lock:
+        lib.tc_default_params(params)
+        if noise_floor is not None:
+            params.noise_floor_dbfs = noise_floor
+        if min_silence is not None:
+            params.min_silence_period = int(min_silence)
+        if min_signal is not None:
+            params.min_signal_period = int(min_signal)
+        if min_track_length is not None:
+            params.min_track_length = int(min_track_length)
+        params.high_pass_filter = bool(high_pass)
+        if dc_offset is not None:
+            for c, v in enumerate(np.broadcast_to(dc_offset, (channels,))):
+                params.dc_offset[c] = v
+        params.hop_len = int(hop)
+        if adaptive_floor is not None:
+            params.adaptive_floor_margin = adaptive_floor
+        if floor_window is not None:
+            params.floor_window = int(floor_window)
+
+        envelope = np.zeros((lib.tc_envelope_len(frame_cnt, params.hop_len), channels))
+        env_ptr = _ffi.from_buffer("double[]", envelope) if envelope.size else _ffi.NULL
+        if lib.tc_run(params, _ffi.from_buffer("double[]", x), frame_cnt, channels,
+                      int(samplerate), env_ptr, res) < 0:
+            raise ValueError(_ffi.string(lib.tc_last_error()).decode())
+        try:
+            cuts = np.empty((0, 2), dtype=np.int64)
+            if res.cut_cnt:
+                cuts = np.frombuffer(_ffi.buffer(res.cuts, res.cut_cnt * _ffi.sizeof("tc_cut_t")),
+                                     dtype=np.int64).reshape(-1, 2).copy()
+            stats = {name: np.array(list(getattr(res.stats, name))[:channels]) for name in _STATS}
+        finally:
+            lib.tc_free_result(res)
+    return Result(cuts, envelope, params.hop_len, stats)
+
+
+class EnergyMap:
+    """Least and greatest RMS levels (dBFS) of each hop of a recording,
+    as written by --energy-map, held as a pyramid: each level above the
+    first gives the least or greatest of pairs of entries of the one
+    below. The level over any span, or the next point above or below a
+    given level, is then found in O(log n) steps for n hops.
+
+    Frames are numbered as in the recording. Hop i covers the `hop'
+    frames from start_frame + i * hop; spans are widened to whole hops.
+
+    samplerate, channels, hop, start_frame: As in the file header
+    lo, hi: Least and greatest level within each hop
+    """
+
+    def __init__(self, lo, hi, samplerate, hop, start_frame=0, channels=0):
+        self.lo = np.asarray(lo, dtype=np.float64)
+        self.hi = np.asarray(hi, dtype=np.float64)
+        if self.lo.shape != self.hi.shape or self.lo.ndim != 1:
+            raise ValueError("lo and hi must be 1-dimensional arrays of the same length")
+        self.samplerate = samplerate
+        self.channels = channels
+        self.hop = hop
+        self.start_frame = start_frame
+        self._lo_min = self._pyramid(self.lo, np.minimum, np.inf)
+        self._hi_max = self._pyramid(self.hi, np.maximum, -np.inf)
+        self._hi_min = self._pyramid(self.hi, np.minimum, np.inf)
+
+    @classmethod
+    def load(cls, path):
+        """Reads an energy map file written by --energy-map."""
+        header = {}
+        with open(path) as f:
+            first = f.readline().split()
+            if len(first) != 2 or first[0] != "trackcutter-energy" or first[1] != "1":
+                raise ValueError("%s is not a trackcutter energy map" % path)
+            for key in ("samplerate", "channels", "hop", "start_frame"):
+                line = f.readline().split()
+                if len(line) != 2 or line[0] != key:
+                    raise ValueError("%s: expected `%s' in header" % (path, key))
+                header[key] = int(line[1])
+            levels = np.loadtxt(f, comments="#", ndmin=2).reshape(-1, 2)
+        return cls(levels[:, 0], levels[:, 1], **header)
+
+    @staticmethod
+    def _pyramid(base, combine, neutral):
+        """Builds the levels of the pyramid over base, each padded to an
+        even length with the neutral value."""
+        levels = [base]
+        while len(levels[-1]) > 1:
+            cur = levels[-1]
+            if len(cur) % 2:
+                cur = levels[-1] = np.append(cur, neutral)
+            levels.append(combine(cur[0::2], cur[1::2]))
+        return levels
+
+    def __len__(self):
+        return len(self.lo)
+
+    def _hops(self, start, end):
+        """Range of hops covering frames [start, end)."""
+        i = max((start - self.start_frame) // self.hop, 0)
+        j = min(-(-(end - self.start_frame) // self.hop), len(self.lo))
+        return int(i), int(max(j, i))
+
+    def _frame(self, i):
+        return self.start_frame + i * self.hop
+
+    @staticmethod
+    def _fold(levels, i, j, combine, neutral):
+        """Combines the entries for hops [i, j) in O(log n) steps."""
+        res = neutral
+        k = 0
+        while i < j:
+            if i & 1:
+                res = combine(res, levels[k][i])
+                i += 1
+            if j & 1:
+                j -= 1
+                res = combine(res, levels[k][j])
+            i >>= 1
+            j >>= 1
+            k += 1
+        return float(res)
+
+    def _find(self, levels, i, ok):
+        """First hop at or after i whose entry satisfies ok, or None. ok
+        must hold for a pyramid entry if it holds for any entry beneath."""
+        n = len(self.lo)
+        if i >= n:
+            return None
+        k = 0
+        while not ok(levels[k][i]):
+            while i & 1 and k + 1 < len(levels):
+                i >>= 1
+                k += 1
+            i += 1
+            if i >= len(levels[k]):
+                return None
+        while k > 0:
+            k -= 1
+            i <<= 1
+            if not ok(levels[k][i]):
+                i += 1
+        return i if i < n else None
+
+    def max_level(self, start, end):
+        """Greatest level within frames [start, end); -inf if empty."""
+        i, j = self._hops(start, end)
+        return self._fold(self._hi_max, i, j, max, -np.inf)
+
+    def min_level(self, start, end):
+        """Least level within frames [start, end); inf if empty."""
+        i, j = self._hops(start, end)
+        return self._fold(self._lo_min, i, j, min, np.inf)
+
+    def is_silent(self, start, end, floor):
+        """Whether frames [start, end) are all below floor (dBFS), as the
+        detector would judge them with that noise floor."""
+        return self.max_level(start, end) < floor
+
+    def find_gap(self, start, length, floor):
+        """Finds the first stretch of at least length frames, from frame
+        start on, that is below floor (dBFS) throughout. Returns its
+        (start, end) frames, or None if there is none."""
+        need = max(-(-length // self.hop), 1)
+        i, _ = self._hops(start, start)
+        while True:
+            q = self._find(self._hi_min, i, lambda v: v < floor)
+            if q is None:
+                return None
+            loud = self._find(self._hi_max, q, lambda v: v >= floor)
+            end = len(self.lo) if loud is None else loud
+            if end - q >= need:
+                return self._frame(q), self._frame(end)
+            i = end
+
+    def gaps(self, length, floor):
+        """Yields the (start, end) frames of every stretch of at least
+        length frames below floor (dBFS), in order."""
+        pos = self.start_frame
+        while True:
+            gap = self.find_gap(pos, length, floor)
+            if gap is None:
+                return
+            yield gap
+            pos = gap[1]